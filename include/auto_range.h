@@ -0,0 +1,57 @@
+// Closed-loop LED amplitude / ADC range control.
+//
+// The calibration (mapIRToAgtron and the calibration table) was taken at
+// one sensor configuration: ledBrightness and the 16384 nA ADC range. Dark
+// roasts reflect little and use only a small part of the ADC scale, so
+// fixed converter noise is a large share of the reading and the filter
+// needs many samples to settle; light roasts can run into full scale.
+// While a sample is loaded the measurement side therefore moves through a
+// small ladder of gain steps to keep the raw count inside a target band,
+// and every sample is scaled back to the calibration configuration before
+// it is filtered, so all downstream values keep one common scale.
+//
+// Steps double the gain: the lowest halves the LED amplitude, the others
+// narrow the ADC range. The scale factor is the exact ratio of the
+// programmed register values; the LED driver is linear in its amplitude.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+// -- Auto range constants --
+
+#ifndef AUTO_RANGE_ENABLED
+#define AUTO_RANGE_ENABLED 1
+#endif
+#define AUTO_RANGE_STEPS 5
+#define AUTO_RANGE_BASELINE 1          // ledBrightness, 16384 nA: the calibration configuration
+#define AUTO_RANGE_BASE_ADC 16384
+#define AUTO_RANGE_FULL_SCALE 262143   // 18-bit ADC at pulseWidth 411
+#ifndef AUTO_RANGE_LOW_PERCENT
+#define AUTO_RANGE_LOW_PERCENT 30      // Step up below this share of full scale...
+#endif
+#ifndef AUTO_RANGE_HIGH_PERCENT
+#define AUTO_RANGE_HIGH_PERCENT 75     // ...and down above this one
+#endif
+
+// A doubled low reading must land below the high threshold, or the
+// controller would step back and forth
+#if 2 * AUTO_RANGE_LOW_PERCENT >= AUTO_RANGE_HIGH_PERCENT
+#error "AUTO_RANGE_HIGH_PERCENT must exceed twice AUTO_RANGE_LOW_PERCENT"
+#endif
+
+// -- End Auto range constants --
+
+struct AutoRange {
+    uint8_t step;      // Requested gain step, AUTO_RANGE_BASELINE after reset
+};
+
+void autoRangeReset(AutoRange *range);
+// Judge the mean raw count of the batch samples taken at range->step;
+// saturated: one of them hit full scale. True if the step changed.
+bool autoRangeUpdate(AutoRange *range, uint32_t rawMean, bool saturated);
+
+uint8_t autoRangeLedAmplitude(uint8_t step, uint8_t ledBrightness);
+int autoRangeAdcRange(uint8_t step);
+// Raw count taken at step, scaled to the calibration configuration
+uint32_t autoRangeNormalize(uint32_t raw, uint8_t step, uint8_t ledBrightness);
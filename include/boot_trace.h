@@ -0,0 +1,33 @@
+// Boot phase timing, printed by the BOOT TIMES command.
+//
+// Every init stage records when it started and when it ended, in
+// microseconds since the chip started. The stages run in different tasks
+// and overlap, so each phase keeps its own start and end, written by
+// that stage alone.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+enum BootPhase {
+    BOOT_PHASE_SETUP,          // setup() entry until the tasks are started
+    BOOT_PHASE_DISPLAY,        // Panel init and start-up screen
+    BOOT_PHASE_SETTINGS,       // NVS load, or the retained state after a wake
+    BOOT_PHASE_LOG,            // Partition mount and log recovery
+    BOOT_PHASE_SENSOR,         // Probe and configuration
+    BOOT_PHASE_WARMUP,
+    BOOT_PHASE_FIRST_READING,  // Measuring started until the first batch result
+    BOOT_PHASE_COUNT
+};
+
+struct BootTrace {
+    uint32_t startUs[BOOT_PHASE_COUNT];
+    uint32_t endUs[BOOT_PHASE_COUNT];
+    bool started[BOOT_PHASE_COUNT];
+    bool ended[BOOT_PHASE_COUNT];
+};
+
+void bootTraceReset(BootTrace *trace);
+void bootPhaseStart(BootTrace *trace, BootPhase phase, uint32_t nowUs);
+void bootPhaseEnd(BootTrace *trace, BootPhase phase, uint32_t nowUs);
+const char *bootPhaseName(BootPhase phase);
@@ -0,0 +1,60 @@
+// Multi-point IR -> Agtron calibration, one per measurement mode.
+//
+// Up to CAL_MAX_POINTS reference points (scaled IR level, Agtron) are kept
+// sorted by level, and a dense table holds the Agtron value of every scaled
+// level 0..SCALED_LEVEL_MAX, so mapping a reading is one array read: no
+// float math and no search per sample. Between two points the table follows
+// the straight line through them; below the first and above the last point
+// the outermost segment is extended. With fewer than two points the table
+// is filled from the mode's formula (mapIRToAgtron, mapRatioToAgtron), so
+// a meter without calibration points reads exactly as before.
+//
+// Adding a point only rewrites the levels between its neighbours. Each
+// entry is a single 16-bit store, so a reader running while a point is
+// added sees every level either before or after the change.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+#include "measurement.h"
+
+// -- Calibration constants --
+
+#ifndef CAL_MAX_POINTS
+#define CAL_MAX_POINTS 8
+#endif
+#define CAL_TABLE_SIZE (SCALED_LEVEL_MAX + 1)
+
+// -- End Calibration constants --
+
+struct CalPoint {
+    uint16_t level;   // rLevel / 1000
+    int16_t agtron;
+};
+
+struct Calibration {
+    CalPoint points[CAL_MAX_POINTS];  // Ascending level, first count entries valid
+    uint8_t count;
+    int16_t table[CAL_TABLE_SIZE];
+    int (*formula)(uint32_t level);   // Table source below two points; NULL: mapIRToAgtron
+};
+
+extern Calibration calibration;       // !Preferences setup
+extern Calibration ratioCalibration;  // !Preferences setup, indexed by ratio level / 1000
+
+inline Calibration *calibrationFor(MeasureMode mode) {
+    return mode == MEASURE_MODE_RATIO ? &ratioCalibration : &calibration;
+}
+
+// Drop every point and fill the table from the formula
+void calibrationReset(Calibration *cal);
+// Rebuild the whole table, e.g. after intersectionPoint or deviation changed
+void calibrationRebuild(Calibration *cal);
+// Add a point, replacing one at the same level; false when the level is
+// out of range or all CAL_MAX_POINTS are used
+bool calibrationAddPoint(Calibration *cal, uint16_t level, int16_t agtron);
+
+inline int calibrationLookup(const Calibration *cal, uint32_t level) {
+    return cal->table[level];  // level <= SCALED_LEVEL_MAX, checked by the caller
+}
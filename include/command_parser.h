@@ -0,0 +1,63 @@
+// Serial console: incremental line assembly and table-driven dispatch.
+//
+// Bytes are fed one at a time as they arrive, so the console never waits
+// for the rest of a line. A complete line is split into words in place
+// (no allocation) and matched against a static table of commands; an
+// entry's name may span several words ("LOG DUMP BIN"), the longest match
+// wins and the remaining words are its arguments. New commands are new
+// table rows.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+// -- Command parser constants --
+
+#ifndef COMMAND_LINE_SIZE
+#define COMMAND_LINE_SIZE 64      // Longest accepted line, terminator included
+#endif
+#define COMMAND_MAX_WORDS 8
+
+// -- End Command parser constants --
+
+struct CommandLine {
+    char buffer[COMMAND_LINE_SIZE];
+    uint8_t length;
+    bool overflow;                // Line outgrew buffer; dropped at its end
+};
+
+struct CommandArgs {
+    uint8_t count;
+    char *values[COMMAND_MAX_WORDS];
+};
+
+typedef void (*CommandHandler)(const CommandArgs &args);
+
+struct CommandEntry {
+    const char *name;             // Upper case words separated by single spaces
+    const char *usage;            // Arguments, for HELP
+    CommandHandler handler;
+};
+
+enum CommandFeedResult {
+    COMMAND_PENDING,              // Line not complete yet
+    COMMAND_READY,                // buffer holds a line, upper case, without the line end
+    COMMAND_TOO_LONG              // A line was dropped for overflowing buffer
+};
+
+enum CommandDispatchResult {
+    COMMAND_DISPATCHED,
+    COMMAND_EMPTY,
+    COMMAND_UNKNOWN
+};
+
+void commandLineReset(CommandLine *line);
+// Add one received byte; \r and \n end a line, empty lines are skipped
+CommandFeedResult commandLineFeed(CommandLine *line, char c);
+
+// Split line in place and run the matching table entry
+CommandDispatchResult dispatchCommand(const CommandEntry *table, uint8_t tableSize, char *line);
+
+// Whole-word numeric arguments; false if index is missing or not a number
+bool commandArgInt(const CommandArgs &args, uint8_t index, int32_t *value);
+bool commandArgUInt(const CommandArgs &args, uint8_t index, uint32_t *value);
@@ -0,0 +1,90 @@
+// Compile-time configuration shared by the firmware and the native host build.
+// Every value can be overridden from build_flags in platformio.ini.
+#pragma once
+
+// -- Debug Logging Configuration --
+#ifndef DEBUG_LOGGING_ENABLED
+#define DEBUG_LOGGING_ENABLED 1
+#endif
+#ifndef DEBUG_SERIAL_COMMANDS
+#define DEBUG_SERIAL_COMMANDS 1
+#endif
+// Stage timings and result counters behind PERF STATUS / PERF RESET
+#ifndef PERF_COUNTERS_ENABLED
+#define PERF_COUNTERS_ENABLED DEBUG_SERIAL_COMMANDS
+#endif
+
+// -- Board Configuration (override via build_flags) --
+#ifndef I2C_SDA
+#define I2C_SDA -1
+#endif
+#ifndef I2C_SCL
+#define I2C_SCL -1
+#endif
+
+// -- Display Configuration (override via build_flags) --
+#ifndef SCREEN_WIDTH
+#define SCREEN_WIDTH 128
+#endif
+#ifndef SCREEN_HEIGHT
+#define SCREEN_HEIGHT 64
+#endif
+#ifndef I2C_ADDRESS_OLED
+#define I2C_ADDRESS_OLED 0x3C
+#endif
+// Y offset for displays where visible area is shifted (e.g., some 64x48 OLEDs)
+#ifndef DISPLAY_Y_OFFSET
+#define DISPLAY_Y_OFFSET 0
+#endif
+// First SSD1306 column of the visible area (64x48 panels sit at column 32)
+#ifndef DISPLAY_COLUMN_OFFSET
+#if SCREEN_WIDTH == 64 && SCREEN_HEIGHT == 48
+#define DISPLAY_COLUMN_OFFSET 32
+#else
+#define DISPLAY_COLUMN_OFFSET 0
+#endif
+#endif
+
+// -- Sensor Interrupt (override via build_flags) --
+// GPIO wired to the MAX30105 INT pin. When set, acquisition waits for the
+// interrupt instead of polling and the MCU light-sleeps between samples.
+#ifndef SENSOR_INT_PIN
+#define SENSOR_INT_PIN -1
+#endif
+// Samples per interrupt: 1 (new-data interrupt, no added latency) or
+// 17..32 (FIFO almost-full; fewer wake-ups, up to that many samples late)
+#ifndef SENSOR_INT_SAMPLES
+#define SENSOR_INT_SAMPLES 1
+#endif
+#if SENSOR_INT_SAMPLES != 1 && (SENSOR_INT_SAMPLES < 17 || SENSOR_INT_SAMPLES > 32)
+#error "SENSOR_INT_SAMPLES must be 1 or 17..32"
+#endif
+
+// -- Ambient Light (override via build_flags) --
+// Sample a dark slot (Red LED at zero current) next to every IR slot and
+// subtract it, so light leaking past the cup cancels out of each sample.
+// Off by default: the intersection / deviation settings and stored CAL
+// points were taken without the subtraction, and turning it on lowers
+// every raw IR level by the ambient share, so recalibrate after enabling.
+#ifndef SENSOR_AMBIENT_SLOT
+#define SENSOR_AMBIENT_SLOT 0
+#endif
+
+// -- Idle Sleep (override via build_flags) --
+// Seconds without a cup before the meter deep-sleeps with the sensor in
+// proximity mode; placing a cup wakes it. 0 disables. Needs SENSOR_INT_PIN
+// on a GPIO that can wake the chip from deep sleep (an RTC GPIO on the S2,
+// GPIO0-5 on the C3).
+#ifndef IDLE_SLEEP_SECONDS
+#define IDLE_SLEEP_SECONDS 120
+#endif
+#define IDLE_SLEEP_ENABLED (SENSOR_INT_PIN >= 0 && IDLE_SLEEP_SECONDS > 0)
+
+// -- Constant Values --
+#ifndef FIRMWARE_REVISION_STRING
+#define FIRMWARE_REVISION_STRING "v0.2"
+#endif
+
+#define WARMUP_TIME 60  // seconds
+
+// -- End Constant Values --
@@ -0,0 +1,12 @@
+// CRC-32 (IEEE 802.3, same as zlib.crc32) for on-flash and wire framing
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Continue a running CRC; start with crc = 0
+uint32_t crc32Update(uint32_t crc, const void *data, size_t len);
+
+inline uint32_t crc32(const void *data, size_t len) {
+    return crc32Update(0, data, len);
+}
@@ -0,0 +1,114 @@
+// Debug log of every accepted measurement, appended to the raw logdata
+// partition as a ring of CRC-checked pages (see log_format.h)
+#pragma once
+
+#include "config.h"
+
+#if DEBUG_LOGGING_ENABLED
+#include "hal.h"
+#include "log_format.h"
+
+// Entries held in RAM between flash writes; each flush appends one block
+// (two where it crosses into a new page). Larger trades RAM for fewer
+// flash ops.
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 10
+#endif
+#define LOG_FLUSH_IDLE_MS 2000
+
+// A full buffer must encode into one block on a fresh page even when every
+// entry takes its v2 worst case (a settings record, then an escaped sample)
+// behind a session record, after the 32-byte page header and the 4-byte
+// block header
+#if LOG_BUFFER_SIZE < 1 || \
+    LOG_BUFFER_SIZE * 2 * LOG_MAX_RECORD_BYTES + LOG_SESSION_RECORD_BYTES + 4 > LOG_PAGE_SIZE - 32
+#error "LOG_BUFFER_SIZE must fit one log page"
+#endif
+
+enum LogOpenStatus {
+    LOG_OPEN_LOADED,         // Existing log found, appending after its newest block
+    LOG_OPEN_CREATED,        // No valid page found, fresh log started
+    LOG_OPEN_RECOVERED,      // Torn block after power loss skipped, continuing on a new page
+    LOG_OPEN_MOUNT_FAILED,   // No logdata partition
+    LOG_OPEN_CREATE_FAILED   // Partition too small or flash write failed
+};
+
+struct LogStatus {
+    uint32_t entryCount;     // Entries logged since the last reset
+    uint32_t storedEntries;  // Entries still on flash (older pages get recycled)
+    uint16_t pageCount;      // Pages in the partition
+    uint16_t pagesUsed;      // Pages holding live entries
+    uint16_t currentPage;    // Page being appended to
+    uint32_t pageSequence;   // Its sequence number
+    uint32_t oldestSequence; // Sequence number of the oldest live page
+    uint32_t session;        // Session of this boot
+    bool wrapped;            // Oldest entries have been overwritten
+};
+
+// One boot session still (partly) on flash. Entry numbers count from the
+// last reset, like LogStatus.entryCount.
+struct LogSessionInfo {
+    uint32_t session;        // 0 for pages from before sessions existed
+    uint32_t firstEntry;     // Oldest of its entries still stored
+    uint32_t entries;
+    uint32_t firstSequence;  // Page holding firstEntry
+    uint16_t pages;          // Pages holding its entries
+};
+
+// Append position of the open log, enough to continue it without the
+// header scan of setupDebugLog()
+struct LogPosition {
+    uint16_t pageCount;
+    uint16_t currentPage;
+    uint16_t pageOffset;
+    uint16_t oldestPage;
+    uint16_t pagesUsed;
+    uint32_t currentSequence;
+    uint32_t currentFirstEntry;
+    uint32_t oldestFirstEntry;
+    uint32_t entryCount;
+    uint32_t session;
+    uint32_t pageSession;    // Session of the newest records on currentPage
+};
+
+// Debug logging state
+extern uint16_t logBufferCount;
+extern bool logReady;
+
+LogOpenStatus setupDebugLog(LogStorage &storage);
+// Continue at a position taken by getLogPosition() before deep sleep, in
+// the same session; falls back to setupDebugLog() (a new session) if the
+// position does not match the storage
+LogOpenStatus resumeDebugLog(LogStorage &storage, const LogPosition &position);
+// Position after the last flush; false if the log is not open
+bool getLogPosition(LogPosition *position);
+// Buffer one entry; flags from logMeasurementFlags(). False if it had to be dropped.
+bool logMeasurement(uint32_t timestamp, uint32_t rawIR, int16_t agtron, uint16_t flags);
+// Buffer a LOG_FLAG_WARMUP event; reason is LOG_WARMUP_*
+bool logWarmup(uint32_t timestamp, uint32_t durationMs, uint8_t reason);
+bool flushLogBuffer();
+// True when buffered entries have waited LOG_FLUSH_IDLE_MS without a new one
+bool logFlushDue(uint32_t now);
+// Start over on a fresh page; older pages are left in place but ignored
+void resetLog();
+
+LogStatus getLogStatus();
+// Walk every stored entry oldest-first
+bool forEachLogEntry(void (*visit)(const LogEntry &entry, uint32_t index));
+// Walk entries first .. first + count - 1 (entry numbers, passed as index),
+// starting at the page that holds first; false if none is stored
+bool forEachLogEntryInRange(uint32_t first, uint32_t count,
+                            void (*visit)(const LogEntry &entry, uint32_t index));
+// Sessions oldest-first, from the page headers and the pages where the
+// session changes
+bool forEachLogSession(void (*visit)(const LogSessionInfo &info));
+// Entry range of one session, by binary search over the page headers and
+// a decode of at most its first and last page; false if none of its
+// entries is stored
+bool findLogSession(uint32_t session, LogSessionInfo *info);
+// Session of the newest stored entries (this boot or, before it logs, the last one)
+uint32_t lastLogSession();
+// Copy the live page with the given sequence number into buffer
+// (LOG_PAGE_SIZE bytes); *used is the length up to its last block
+bool readLogPage(uint32_t sequence, uint8_t *buffer, uint16_t *used);
+#endif
@@ -0,0 +1,46 @@
+// Binary framing for LOG DUMP BIN (decoded by tools/capture_log.py) and
+// the TELEMETRY BIN sample stream (tools/telemetry.py)
+//
+// Every frame is a DumpFrameHeader, length payload bytes and the CRC-32 of
+// header + payload (little endian). A dump is one DUMP_FRAME_BEGIN, one
+// DUMP_FRAME_PAGE per live log page (sequence = page sequence number,
+// payload = raw page bytes up to its last block) and one DUMP_FRAME_END.
+// "LOG DUMP BIN <sequence>" resends a single page frame.
+// The telemetry stream sends one DUMP_FRAME_TELEMETRY per measured batch
+// (sequence = running frame count, payload = TelemetrySample array).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DUMP_FRAME_SYNC0 0xA5
+#define DUMP_FRAME_SYNC1 0x5A
+
+#define DUMP_FRAME_BEGIN 1
+#define DUMP_FRAME_PAGE 2
+#define DUMP_FRAME_END 3
+#define DUMP_FRAME_MISSING 4   // Requested page is no longer on flash
+#define DUMP_FRAME_TELEMETRY 5
+
+struct __attribute__((packed)) DumpFrameHeader {
+    uint8_t  sync[2];          // DUMP_FRAME_SYNC0, DUMP_FRAME_SYNC1
+    uint8_t  type;             // DUMP_FRAME_*
+    uint8_t  reserved;
+    uint32_t sequence;         // Page sequence number (PAGE / MISSING), frame count (TELEMETRY)
+    uint16_t length;           // Payload bytes
+};
+
+// DUMP_FRAME_BEGIN payload
+struct __attribute__((packed)) DumpBeginInfo {
+    uint32_t firstSequence;    // Oldest live page
+    uint16_t pageCount;        // PAGE frames that follow
+    uint16_t pageSize;
+    uint32_t storedEntries;
+    uint8_t  wrapped;
+};
+
+typedef void (*DumpWriter)(const uint8_t *data, size_t len);
+
+// Emit one frame through write (header, payload and CRC as three writes)
+void writeDumpFrame(DumpWriter write, uint8_t type, uint32_t sequence,
+                    const void *payload, uint16_t length);
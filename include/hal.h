@@ -0,0 +1,113 @@
+// Hardware abstraction layer.
+//
+// The firmware talks to the sensor, display, key-value store and log storage
+// only through these interfaces. hal_arduino.h provides the ESP32
+// implementations; src/native provides host fakes for the native env.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SensorSample {
+    uint32_t timestamp;  // millis() when the sample was drained from the FIFO
+    uint32_t ir;         // Raw IR ADC count
+    uint32_t ambient;    // Dark slot ADC count, 0 without the ambient slot
+    uint32_t red;        // Red slot ADC count of the same FIFO sample, 0 without the Red slot
+    uint8_t range;       // Auto range step it was taken at (auto_range.h)
+    uint8_t mode;        // MeasureMode the sensor was configured for (measurement.h)
+};
+
+#define SENSOR_FIFO_DEPTH 32  // Samples the MAX30105 FIFO holds before it overwrites the oldest
+
+// Samples lost because the FIFO was full when readSamples() drained it
+struct SensorFifoStats {
+    uint32_t overflows;    // Drains that found samples lost
+    uint32_t samplesLost;
+};
+
+// Register-level settings passed to MAX30105::setup()
+struct SensorConfig {
+    uint8_t ledBrightness;
+    uint8_t sampleAverage;  // Options: 1, 2, 4, 8, 16, --32--
+    uint8_t ledMode;        // Options: 1 = Red only, --2 = Red + IR--, 3 = Red + IR + Green
+    int sampleRate;         // Options: 50, 100, 200, 400, 800, 1000, 1600, --3200--
+    int pulseWidth;         // Options: 69, 118, 215, --411--
+    int adcRange;           // Options: 2048, 4096, 8192, --16384--
+    bool ambientSlot;       // Also sample with the LEDs off, into SensorSample.ambient
+    bool redSlot;           // Also sample with the Red LED lit, into SensorSample.red
+};
+
+class SensorPort {
+public:
+    virtual ~SensorPort() {}
+
+    // Probe the sensor on the bus; false if it does not answer
+    virtual bool begin() = 0;
+    virtual void configure(const SensorConfig &config) = 0;
+    // Change LED amplitude (of every lit LED) and ADC range of a configured
+    // sensor; drops the FIFO so every later sample is taken with the new values
+    virtual void setRange(uint8_t ledAmplitude, int adcRange) = 0;
+    // Move every sample pending in the sensor FIFO into out (at most
+    // maxCount), stamping them with now. Returns the number of samples.
+    virtual uint8_t readSamples(SensorSample *out, uint8_t maxCount, uint32_t now) = 0;
+    virtual void clearFifo() = 0;
+    // Die temperature in Celsius (blocks for one conversion, ~30 ms)
+    virtual float readTemperature() = 0;
+    // Assert the INT pin once samplesPerInterrupt new samples are in the
+    // FIFO; readSamples() then also acknowledges the interrupt
+    virtual void enableInterrupt(uint8_t samplesPerInterrupt) = 0;
+    // Leave the sensor in proximity mode: IR pilot pulses at pilotAmplitude
+    // and INT asserted only once the IR count reaches threshold (its 8
+    // MSBs, PROX_INT_THRESH). configure() returns it to normal operation.
+    virtual void armProximityWake(uint8_t pilotAmplitude, uint8_t threshold) = 0;
+    // FIFO overflows readSamples() has seen since the sensor was created
+    virtual SensorFifoStats fifoStats() const = 0;
+};
+
+class DisplayPort {
+public:
+    virtual ~DisplayPort() {}
+
+    // False when no panel answers; the screens then fall back to Serial
+    virtual bool begin() = 0;
+    // Up to two short lines of plain status text (init and error screens)
+    virtual void showStatus(const char *line1, const char *line2) = 0;
+    virtual void showStartUp(const char *revision) = 0;
+    virtual void showWarmUp(int secondsLeft) = 0;
+    virtual void showReady() = 0;
+    virtual void showPleaseLoadSample() = 0;
+    // locked: the reading is stable and agtronLevel will not change
+    virtual void showMeasurement(int agtronLevel, bool locked) = 0;
+    // Panel off (SSD1306 sleep mode) until the next begin()
+    virtual void powerDown() = 0;
+};
+
+class KeyValueStore {
+public:
+    virtual ~KeyValueStore() {}
+
+    virtual bool begin(const char *name) = 0;
+    virtual uint8_t getUChar(const char *key, uint8_t defaultValue) = 0;
+    virtual bool putUChar(const char *key, uint8_t value) = 0;
+    virtual int32_t getInt(const char *key, int32_t defaultValue) = 0;
+    virtual bool putInt(const char *key, int32_t value) = 0;
+    virtual float getFloat(const char *key, float defaultValue) = 0;
+    virtual bool putFloat(const char *key, float value) = 0;
+};
+
+#define LOG_STORAGE_SECTOR_SIZE 4096  // SPI flash erase unit
+
+// Raw flash region holding the debug log. Behaves like NOR flash: write()
+// can only clear bits, eraseSector() sets a whole sector back to 0xFF.
+class LogStorage {
+public:
+    virtual ~LogStorage() {}
+
+    // Locate the region; false if it does not exist
+    virtual bool mount() = 0;
+    virtual uint32_t size() = 0;
+    virtual bool read(uint32_t offset, void *data, size_t len) = 0;
+    virtual bool write(uint32_t offset, const void *data, size_t len) = 0;
+    // Erase the sector starting at offset (a multiple of the sector size)
+    virtual bool eraseSector(uint32_t offset) = 0;
+};
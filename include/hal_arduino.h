@@ -0,0 +1,139 @@
+// ESP32 / Arduino implementations of the hardware abstraction layer
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+
+#include "MAX30105.h"
+#include <esp_partition.h>
+
+#include "config.h"
+#include "hal.h"
+#include "oled_diff.h"
+#include "perf_counters.h"
+
+#define OLED_RESET -1
+
+// Owner of the shared Wire bus. The sensor takes it for a whole logical
+// transaction (a FIFO drain, a configuration), the display for one page
+// span at a time, so a frame never holds the bus for more than a page.
+// Sensor reads go first: the acquisition task outranks the UI task, and a
+// FreeRTOS mutex hands the bus to its highest priority waiter and lends
+// that priority to the holder. A FIFO read therefore waits for at most the
+// page in flight, never for the rest of the frame.
+class I2cBus {
+public:
+    I2cBus();
+
+    // Create the lock; before either device touches the bus
+    void begin();
+    void lockSensor();
+    void lockDisplay();
+    void unlock();
+
+    uint32_t sensorLocks;      // Sensor transactions
+    uint32_t sensorWaits;      // ... that found the bus taken
+    uint32_t sensorWaitMaxUs;  // Longest a sensor transaction waited
+    uint32_t displayLocks;     // Page spans and panel commands
+
+private:
+    SemaphoreHandle_t mutex;
+};
+
+// Holds the bus for one scope
+class I2cBusLock {
+public:
+    I2cBusLock(I2cBus &bus, bool sensor) : bus(bus) {
+        if (sensor) bus.lockSensor();
+        else bus.lockDisplay();
+    }
+    ~I2cBusLock() { bus.unlock(); }
+
+private:
+    I2cBus &bus;
+};
+
+// MAX30105 on the shared Wire bus
+class Max30105Sensor : public SensorPort {
+public:
+    explicit Max30105Sensor(I2cBus &bus);
+
+    bool begin() override;
+    void configure(const SensorConfig &config) override;
+    void setRange(uint8_t ledAmplitude, int adcRange) override;
+    uint8_t readSamples(SensorSample *out, uint8_t maxCount, uint32_t now) override;
+    void clearFifo() override;
+    float readTemperature() override;
+    void enableInterrupt(uint8_t samplesPerInterrupt) override;
+    void armProximityWake(uint8_t pilotAmplitude, uint8_t threshold) override;
+    SensorFifoStats fifoStats() const override;
+
+private:
+    I2cBus &bus;
+    MAX30105 particleSensor;
+    SensorFifoStats fifo;
+    bool interruptEnabled;  // readSamples() acknowledges INT
+    bool ambientSlot;       // FIFO carries a dark slot with each IR slot
+    bool redSlot;           // FIFO carries a lit Red slot before each IR slot
+};
+
+// SSD1306 OLED; every screen falls back to Serial when no panel answered
+class Ssd1306Display : public DisplayPort {
+public:
+    explicit Ssd1306Display(I2cBus &bus);
+
+    bool begin() override;
+    void showStatus(const char *line1, const char *line2) override;
+    void showStartUp(const char *revision) override;
+    void showWarmUp(int secondsLeft) override;
+    void showReady() override;
+    void showPleaseLoadSample() override;
+    void showMeasurement(int agtronLevel, bool locked) override;
+    void powerDown() override;
+
+    // I2C bytes sent to the panel since boot
+    uint32_t bytesSent() const;
+
+private:
+    void drawCenterString(const char *text);
+    void pushFrame();
+
+    I2cBus &bus;
+    Adafruit_SSD1306 oled;
+    bool oledAvailable;  // OLED status tracking
+    OledShadow shadow;   // What the panel currently shows
+};
+
+// NVS-backed Preferences
+class PreferencesStore : public KeyValueStore {
+public:
+    bool begin(const char *name) override;
+    uint8_t getUChar(const char *key, uint8_t defaultValue) override;
+    bool putUChar(const char *key, uint8_t value) override;
+    int32_t getInt(const char *key, int32_t defaultValue) override;
+    bool putInt(const char *key, int32_t value) override;
+    float getFloat(const char *key, float defaultValue) override;
+    bool putFloat(const char *key, float value) override;
+
+private:
+    Preferences preferences;
+};
+
+// Raw data partition, located by label
+class PartitionLogStorage : public LogStorage {
+public:
+    explicit PartitionLogStorage(const char *label);
+
+    bool mount() override;
+    uint32_t size() override;
+    bool read(uint32_t offset, void *data, size_t len) override;
+    bool write(uint32_t offset, const void *data, size_t len) override;
+    bool eraseSector(uint32_t offset) override;
+
+private:
+    const char *label;
+    const esp_partition_t *partition;
+};
@@ -0,0 +1,75 @@
+// Idle deep sleep: when the meter may sleep and what it keeps across it.
+//
+// With no cup loaded for IDLE_SLEEP_SECONDS the MAX30105 is left in its
+// proximity mode, pulsing the IR LED at ledBrightness until the count
+// crosses a threshold just above the bare window, and the ESP32 deep-sleeps
+// until that proximity interrupt pulls INT low. Deep sleep loses RAM, so
+// the settings, both calibrations, unblockedValue, the log append position
+// and the warm-up outcome are kept in RTC memory as a RetainedState. A
+// wake restores them instead of reading NVS, scanning the log headers and
+// warming up again, and goes straight to measuring the cup.
+//
+// A wake is not a boot: the log carries on in the same session and on the
+// same page, though millis() and so the logged timestamps start over.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+#include "calibration.h"
+#include "config.h"
+#include "debug_log.h"
+#include "measurement.h"
+#include "warmup.h"
+
+// -- Idle sleep constants --
+
+#ifndef PROXIMITY_WAKE_MARGIN
+#define PROXIMITY_WAKE_MARGIN 4096  // IR counts over unblockedValue that wake the meter
+#endif
+#define PROXIMITY_THRESHOLD_SHIFT 10  // PROX_INT_THRESH holds the 8 MSBs of the 18-bit IR count
+#define RETAINED_STATE_MAGIC 0x52544E31  // "RTN1"
+
+// -- End Idle sleep constants --
+
+struct IdleTimer {
+    uint32_t idleSince;  // Time of the first MEASURE_NO_SAMPLE of the idle run
+    bool idle;           // The latest batch found no cup
+};
+
+// What a wake needs to measure right away
+struct RetainedState {
+    uint32_t magic;
+    uint8_t ledBrightness;
+    uint8_t measureMode;
+    int16_t intersectionPoint;
+    float deviation;
+    uint32_t unblockedValue;
+    CalPoint points[CAL_MAX_POINTS];       // calibration
+    CalPoint ratioPoints[CAL_MAX_POINTS];  // ratioCalibration
+    uint8_t pointCount;
+    uint8_t ratioPointCount;
+    uint8_t warmup;                        // WarmupStatus the last cold boot ended its warm-up with
+    uint32_t wakes;                        // Warm resumes since that cold boot
+#if DEBUG_LOGGING_ENABLED
+    LogPosition log;
+#endif
+    uint32_t crc;                          // Over everything before it
+};
+
+void idleTimerReset(IdleTimer *timer);
+// Feed the status of every evaluated batch; true once no cup has been
+// seen for IDLE_SLEEP_SECONDS
+bool idleTimerUpdate(IdleTimer *timer, MeasureStatus status, uint32_t now);
+
+// PROX_INT_THRESH for the bare-window level unblocked: the first 8-bit
+// step at least PROXIMITY_WAKE_MARGIN counts above it
+uint8_t proximityThreshold(uint32_t unblocked);
+
+// Capture the settings, calibrations and log position before deep sleep;
+// state->wakes carries over
+void retainState(RetainedState *state, WarmupStatus warmup);
+// Restore them after a wake, rebuilding the calibration tables, and use
+// the capture up so a later reset boots cold; false (nothing changed)
+// when state does not hold a valid capture
+bool resumeState(RetainedState *state);
@@ -0,0 +1,36 @@
+// Encoder / decoder for log block payloads (LOG_VERSION_FIXED and
+// LOG_VERSION_DELTA), shared by the firmware and host tools
+#pragma once
+
+#include <stdint.h>
+
+#include "log_format.h"
+
+struct LogEncoder {
+    LogEntry previous;     // Delta base and last written settings
+    bool settingsPending;  // Next entry starts with a settings record
+};
+
+struct LogDecoder {
+    LogEntry current;      // Settings and delta base carried between records
+    uint32_t session;      // Session of the entries decoded last
+};
+
+typedef void (*LogEntryVisitor)(const LogEntry &entry, void *context);
+
+// Start a fresh delta chain (new page or new boot)
+void logEncoderReset(LogEncoder *encoder);
+// Encode entry as v2 records into out (2 * LOG_MAX_RECORD_BYTES at most);
+// returns the bytes used
+uint8_t logEncodeEntry(LogEncoder *encoder, const LogEntry &entry, uint8_t *out);
+// Encode a session record into out (LOG_SESSION_RECORD_BYTES at most);
+// returns the bytes used
+uint8_t logEncodeSession(uint32_t session, uint8_t *out);
+
+// Start decoding a page; session is the one in its header
+void logDecoderReset(LogDecoder *decoder, uint32_t session);
+// Decode one block payload of the given page version, calling visit for
+// every entry; a visitor that needs the session of an entry reads
+// decoder->session. Returns false on a malformed payload.
+bool logDecodeBlock(LogDecoder *decoder, uint16_t version, const uint8_t *payload,
+                    uint16_t length, LogEntryVisitor visit, void *context);
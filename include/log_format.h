@@ -0,0 +1,136 @@
+// On-flash debug log format, shared by the firmware and host tools
+#pragma once
+
+#include <stdint.h>
+
+// -- Debug Log constants --
+
+#define LOG_VERSION_FIXED 1   // Block payload is an array of LogEntry
+#define LOG_VERSION_DELTA 2   // Block payload is a stream of v2 records (below)
+#define LOG_VERSION LOG_VERSION_DELTA  // Written by this firmware
+
+// Log entry structure (16 bytes)
+struct __attribute__((packed)) LogEntry {
+    uint32_t timestamp;       // millis() value
+    uint32_t rawIR;           // Raw IR sensor value
+    int16_t  agtron;          // Calculated Agtron level
+    uint8_t  ledBrightness;   // LED brightness setting
+    uint8_t  intersectPt;     // Intersection point setting
+    uint16_t deviationX1000;  // Deviation * 1000
+    uint16_t flags;           // LOG_FLAG_*
+};
+
+// An entry with LOG_FLAG_WARMUP is an event, not a measurement: warm-up
+// finished at timestamp after rawIR milliseconds, agtron holds the
+// LOG_WARMUP_* reason
+#define LOG_FLAG_WARMUP 0x8000
+#define LOG_WARMUP_STABLE 0       // IR and die temperature stopped drifting
+#define LOG_WARMUP_TIMEOUT 1      // WARMUP_TIME reached first
+
+// A measurement with LOG_FLAG_RANGED was taken at auto range step
+// flags & LOG_FLAG_RANGE_MASK (auto_range.h); rawIR is scaled to the
+// calibration configuration either way. Older entries are unranged.
+// With LOG_FLAG_RATIO, rawIR holds the Red / IR ratio level instead.
+#define LOG_FLAG_RANGED 0x0008
+#define LOG_FLAG_RANGE_MASK 0x0007
+#define LOG_FLAG_RATIO 0x0010
+
+inline uint16_t logMeasurementFlags(uint8_t range, bool ratio) {
+    return (uint16_t)(LOG_FLAG_RANGED | (range & LOG_FLAG_RANGE_MASK) | (ratio ? LOG_FLAG_RATIO : 0));
+}
+
+// -- End Debug Log constants --
+
+// -- Page log (raw logdata partition) --
+//
+// The partition is a ring of LOG_PAGE_SIZE pages, one per flash sector.
+// Each page starts with a LogPageHeader and is followed by append-only
+// blocks (LogBlockHeader + payload) up to the first erased header.
+// Pages are reused strictly in order, so every sector is erased once per
+// trip around the ring.
+//
+// Every boot that logs something is a session. A boot keeps appending to
+// the page the previous one left off, so no sector is erased just for
+// booting; its first block starts with a LOG_TAG_SESSION record instead.
+// Each page header carries the session open when the page was started,
+// so the page headers double as a sparse index: a session or an entry
+// number is found by a binary search over the headers of the live pages,
+// and only the page where a session begins or ends is decoded.
+
+#define LOG_PARTITION_LABEL "logdata"
+#define LOG_PAGE_SIZE 4096            // One flash sector
+#define LOG_PAGE_MAGIC 0x50474F4C     // "LOGP"
+#define LOG_PAGE_FLAG_RESET 0x0001    // LOG CLEAR: pages with a lower sequence are dead
+#define LOG_BLOCK_ERASED 0xFFFF       // Block length of never-written flash
+#define LOG_SESSION_UNKNOWN 0xFFFFFFFF // Page written before sessions existed
+
+// Page header (32 bytes)
+struct __attribute__((packed)) LogPageHeader {
+    uint32_t magic;           // LOG_PAGE_MAGIC
+    uint32_t sequence;        // Increments for every page started; newest is highest
+    uint32_t firstEntry;      // Entries logged since the last reset before this page
+    uint16_t version;         // Block payload encoding (LOG_VERSION_*)
+    uint16_t flags;           // LOG_PAGE_FLAG_*
+    uint32_t session;         // Boot session open when the page was started
+    uint8_t  reserved[8];     // 0xFF
+    uint32_t crc;             // CRC-32 of the bytes above
+};
+
+// Block header (4 bytes), written in the same flash write as its payload
+struct __attribute__((packed)) LogBlockHeader {
+    uint16_t length;          // Payload bytes
+    uint16_t crc;             // Low 16 bits of the payload CRC-32
+};
+
+// -- v2 records --
+//
+// A record starts with a tag byte. Tags below 0x80 are samples; the tag
+// itself holds zigzag(agtron delta) when it is below LOG_TAG_SAMPLE_ESCAPE,
+// otherwise a varint zigzag(agtron delta) follows. A sample then carries
+// varint(timestamp delta) and varint zigzag(rawIR delta); deltas are taken
+// modulo 2^32 against the previous sample.
+//
+// LOG_TAG_SETTINGS carries ledBrightness (u8), intersectPt (u8),
+// varint deviationX1000 and varint flags. It is written at the start of
+// every page, after every boot and whenever a setting changes, and resets
+// the sample deltas to zero so the next sample is absolute.
+//
+// LOG_TAG_WARMUP carries varint timestamp (absolute), varint warm-up
+// duration in ms and the reason (u8) of a LOG_FLAG_WARMUP entry. It
+// leaves the settings and the sample deltas untouched.
+//
+// LOG_TAG_SESSION carries the varint session number of the entries that
+// follow it, up to the next session record; before the first one on a
+// page, entries belong to the session in the page header. It is written
+// at the first flush of a boot that continues a page opened by an
+// earlier session, in the same block as the entries, and leaves the
+// settings and the sample deltas untouched.
+
+#define LOG_TAG_SAMPLE_ESCAPE 0x7F
+#define LOG_TAG_SETTINGS 0x80
+#define LOG_TAG_WARMUP 0x81
+#define LOG_TAG_SESSION 0x82
+#define LOG_MAX_RECORD_BYTES 14       // Escaped sample: 1 + 3 + 5 + 5 (settings is 9, warm-up 12)
+#define LOG_SESSION_RECORD_BYTES 6    // Tag and a 5-byte varint at most
+
+// -- End v2 records --
+
+// -- End Page log --
+
+// -- Legacy LittleFS log (/log.bin, firmware before the page log) --
+
+#define LOG_MAGIC 0x524F5354  // "ROST"
+#define LOG_MAX_ENTRIES 65000
+
+// Log header structure (32 bytes), followed by LOG_MAX_ENTRIES LogEntry slots
+struct __attribute__((packed)) LogHeader {
+    uint32_t magic;           // 0x524F5354 "ROST"
+    uint16_t version;         // Log format version
+    uint16_t reserved1;       // Padding
+    uint32_t writePosition;   // Next write index (0 to LOG_MAX_ENTRIES-1)
+    uint32_t entryCount;      // Total entries written (can exceed MAX if wrapped)
+    uint8_t  wrapped;         // 1 if buffer has wrapped
+    uint8_t  reserved2[15];   // Padding to 32 bytes
+};
+
+// -- End Legacy LittleFS log --
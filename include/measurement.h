@@ -0,0 +1,112 @@
+// Measurement pipeline: acquisition ring, batch validation and IR -> Agtron
+// mapping.
+//
+// In ratio mode the Red and IR slots of each FIFO sample are paired and
+// the filter is fed Red / IR instead of the IR level. LED output, sample
+// distance and packing change both slots alike, so most of their
+// variation cancels; the ratio has its own calibration (calibration.h).
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+#include "auto_range.h"
+#include "hal.h"
+#include "reading_filter.h"
+#include "spsc_queue.h"
+
+// -- Acquisition constants --
+
+#define SAMPLE_QUEUE_SIZE 32      // Power of two; matches the 32-sample sensor FIFO
+#define MEASURE_INTERVAL_MS 100   // Batch processing / display update period
+
+// -- End Acquisition constants --
+
+// -- Measurement constants --
+
+#define IR_READING_MAX 1000000    // Raw IR above this is a sensor fault
+#define SCALED_LEVEL_MAX 1000     // Upper bound of rLevel / 1000
+#define AGTRON_MIN 0              // Typical Agtron range 0-350
+#define AGTRON_MAX 350
+#define SAMPLE_PRESENT_DELTA 100  // IR rise over unblockedValue that means a cup is loaded
+#ifndef RATIO_SCALE
+#define RATIO_SCALE 1000000       // Ratio level = Red / IR * RATIO_SCALE; the table covers 0..1.0
+#endif
+
+// -- End Measurement constants --
+
+enum MeasureStatus {
+    MEASURE_OK,
+    MEASURE_NO_SAMPLE,            // Sensor unblocked, nothing loaded
+    MEASURE_INVALID_READING,      // Every sample of the batch was out of range
+    MEASURE_SCALED_TOO_HIGH,      // rLevel / 1000 above SCALED_LEVEL_MAX
+    MEASURE_AGTRON_OUT_OF_RANGE   // Mapped value outside AGTRON_MIN..AGTRON_MAX
+};
+
+enum MeasureMode {
+    MEASURE_MODE_IR,              // IR level, scaled to the calibration configuration
+    MEASURE_MODE_RATIO            // Red / IR ratio level of paired slots
+};
+
+struct MeasureResult {
+    MeasureStatus status;
+    uint32_t rLevel;     // Filtered IR or ratio level (offending value on MEASURE_INVALID_READING)
+    uint32_t rawLevel;   // Plain mean of the batch's valid samples, as logged; IR
+                         // levels are scaled to the calibration configuration
+    uint32_t timestamp;  // Timestamp of the newest sample in the batch
+    int agtron;          // Valid for MEASURE_OK and MEASURE_AGTRON_OUT_OF_RANGE
+    bool stable;         // Reading settled; rLevel and agtron are locked
+    uint8_t range;       // Auto range step of the newest sample
+    MeasureMode mode;
+};
+
+// -- Global Setting --
+
+extern uint8_t ledBrightness;   // !Preferences setup
+extern int intersectionPoint;   // !Preferences setup
+extern float deviation;         // !Preferences setup
+extern uint16_t deviationX1000; // deviation * 1000, derived once so logging needs no float
+extern uint32_t unblockedValue; // Average IR at power up
+extern volatile MeasureMode measureMode; // !Preferences setup, switched at run time
+
+// -- End Global Setting --
+
+// Acquisition -> measurement hand-off; its dropped count is the number of
+// samples that arrived while the queue was full
+typedef SpscQueue<SensorSample, SAMPLE_QUEUE_SIZE> SampleQueue;
+extern SampleQueue sampleQueue;
+
+// Gain step control, owned by the measurement side. The acquisition task
+// applies autoRange.step to the sensor before its next read.
+extern AutoRange autoRange;
+
+// IR count with the dark slot taken out; 0 (an invalid reading) when
+// ambient light swamps it. Both slots share the ADC range.
+inline uint32_t ambientCorrectedIR(const SensorSample &sample) {
+    return sample.ir > sample.ambient ? sample.ir - sample.ambient : 0;
+}
+
+// What the filter is fed for one sample: the IR level scaled to the
+// calibration configuration or, for a ratio mode sample, the ratio level;
+// 0 for an invalid sample
+uint32_t sampleLevel(const SensorSample &sample);
+
+// Producer side (acquisition task)
+void acquireSamples(SensorPort &sensor, uint32_t now);
+// The sensor was just configured for mode, at the calibration configuration
+void sensorConfigured(MeasureMode mode);
+// measureMode was switched since the sensor was configured
+bool sensorModeStale();
+// Consumer side (measurement); takes up to maxCount samples, oldest first
+uint8_t drainSampleQueue(SensorSample *batch, uint8_t maxCount);
+void resetSampleQueue();
+
+// Push the level (sampleLevel) of every valid sample of the batch through
+// filter and map the filtered level through the calibration table of
+// measureMode; the filter restarts whenever the sample is taken out, the
+// gain step changes or the mode is switched
+MeasureResult evaluateSampleBatch(ReadingFilter *filter, const SensorSample *batch, uint8_t count);
+// Two-parameter formula, used for the calibration table below two points
+int mapIRToAgtron(uint32_t x);
+// Ratio level / 1000 -> Agtron without calibration points
+int mapRatioToAgtron(uint32_t x);
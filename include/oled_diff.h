@@ -0,0 +1,33 @@
+// Change tracking for SSD1306 framebuffers
+//
+// The shadow holds the frame last sent to the panel. oledSyncFrame()
+// compares a freshly drawn frame against it one SSD1306 page (8 rows) at
+// a time and hands only the changed column span of each page to the
+// writer, so an unchanged screen costs no bus traffic at all.
+#pragma once
+
+#include <stdint.h>
+
+#include "config.h"
+
+#define OLED_PAGE_COUNT ((SCREEN_HEIGHT + 7) / 8)
+#define OLED_BUFFER_SIZE (SCREEN_WIDTH * OLED_PAGE_COUNT)
+
+struct OledShadow {
+    uint8_t frame[OLED_BUFFER_SIZE];  // Panel RAM contents as last sent
+    bool valid;                       // False until the first full push
+    uint32_t bytesSent;               // Bus bytes reported by the writer
+    uint32_t framesPushed;
+    uint32_t framesSkipped;           // Identical frames that sent nothing
+};
+
+// Send length bytes of one page starting at firstColumn (both relative to
+// the framebuffer); returns the bytes put on the bus including commands
+typedef uint16_t (*OledSpanWriter)(uint8_t page, uint8_t firstColumn,
+                                   const uint8_t *data, uint8_t length, void *context);
+
+// Forget the panel contents; the next sync sends the whole frame
+void oledShadowReset(OledShadow *shadow);
+// Send the parts of frame that differ from the shadow; returns the spans sent
+uint8_t oledSyncFrame(OledShadow *shadow, const uint8_t *frame,
+                      OledSpanWriter write, void *context);
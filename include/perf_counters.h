@@ -0,0 +1,71 @@
+// Hot-path instrumentation for the PERF console commands.
+//
+// Stages are timed with the CPU cycle counter (perfCycles(), provided by
+// the platform: CCOUNT / mcycle on the device, a nanosecond clock on the
+// host) and kept as min / max / mean plus a fixed-bucket histogram, in
+// microseconds. Task loops record the interval between their iterations
+// instead, from a microsecond clock that keeps running through light
+// sleep; its spread is the loop's jitter. Recording is a few adds and no
+// locks: each stage is recorded by one task only, and a PERF STATUS
+// printed in the middle of a record can show that one sample half counted.
+//
+// With PERF_COUNTERS_ENABLED=0 (the *_release environments) the recording
+// calls expand to nothing and no counter storage exists.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+#include "config.h"
+#include "measurement.h"
+
+enum PerfStage {
+    PERF_STAGE_SENSOR_READ,   // acquireSamples(): FIFO burst over I2C
+    PERF_STAGE_MEASURE,       // evaluateSampleBatch(): filter and calibration lookup
+    PERF_STAGE_DISPLAY,       // One screen pushed to the panel
+    PERF_STAGE_LOG_FLUSH,     // flushLogBuffer(): encoding and flash writes
+    PERF_STAGE_TELEMETRY,     // One text line or binary frame written to Serial
+    PERF_LOOP_ACQUISITION,    // Interval between acquisition task iterations
+    PERF_LOOP_UI,             // Interval between UI task iterations
+    PERF_STAGE_COUNT
+};
+
+#define PERF_MEASURE_STATUS_COUNT 5  // MeasureStatus values
+#define PERF_HISTOGRAM_BUCKETS 11    // Limits in perfBucketLimitUs(), the last one open
+
+struct PerfStats {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t histogram[PERF_HISTOGRAM_BUCKETS];
+};
+
+#if PERF_COUNTERS_ENABLED
+// Platform cycle counter, free running, wraps
+uint32_t perfCycles();
+
+// Drop everything recorded; cyclesPerUs converts perfCycles() counts
+void perfReset(uint32_t cyclesPerUs);
+
+inline uint32_t perfStart() { return perfCycles(); }
+// Record the time since start, a perfStart() value
+void perfEnd(PerfStage stage, uint32_t start);
+// Record the interval since the loop's previous mark
+void perfLoopMark(PerfStage loop, uint32_t nowUs);
+// Count one evaluated batch by its status
+void perfCountResult(MeasureStatus status);
+
+const PerfStats *perfStats(PerfStage stage);
+uint32_t perfResultCount(MeasureStatus status);
+const char *perfStageName(PerfStage stage);
+// Upper limit (exclusive) of histogram bucket, 0 for the open last one
+uint32_t perfBucketLimitUs(uint8_t bucket);
+#else
+// Macros rather than empty inlines, so arguments such as micros() are not
+// evaluated either
+#define perfStart() 0u
+#define perfEnd(stage, start) ((void)(start))
+#define perfLoopMark(loop, nowUs) ((void)0)
+#define perfCountResult(status) ((void)0)
+#endif
@@ -0,0 +1,53 @@
+// Streaming filter over the last READING_SAMPLES raw IR samples.
+//
+// The window is kept twice: in arrival order (to know which sample
+// leaves) and sorted (for the median and the trim). Each new sample
+// replaces the oldest one in the sorted copy with a single shift, so the
+// window is never re-sorted, and running sums make the trimmed mean and
+// variance cost only the 2 * READING_TRIM samples at the ends. No
+// allocation; integer-only, so it is cheap on the FPU-less C3.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+// -- Reading filter constants --
+
+#ifndef READING_SAMPLES
+#define READING_SAMPLES 10            // Window length, in sensor samples
+#endif
+#ifndef READING_TRIM
+#define READING_TRIM 2                // Samples dropped at each end for the trimmed stats
+#endif
+#ifndef READING_TOLERANCE_PERMILLE
+#define READING_TOLERANCE_PERMILLE 20 // Stable: trimmed std deviation within 2% of the trimmed mean
+#endif
+
+#if READING_SAMPLES < 1 || READING_SAMPLES > 255 || 2 * READING_TRIM >= READING_SAMPLES
+#error "READING_TRIM must leave samples in the READING_SAMPLES window"
+#endif
+
+// -- End Reading filter constants --
+
+struct ReadingFilter {
+    uint32_t arrival[READING_SAMPLES];  // Ring, oldest at next once full
+    uint32_t sorted[READING_SAMPLES];   // Ascending, first count entries valid
+    uint8_t count;
+    uint8_t next;
+    uint64_t sum;                       // Over the whole window
+    uint64_t sumSquares;
+    bool locked;                        // Stable since lockedMean was taken
+    uint32_t lockedMean;
+};
+
+struct ReadingStats {
+    uint32_t median;
+    uint32_t trimmedMean;
+    uint64_t trimmedVariance;
+    bool stable;       // Window full and trimmed spread within tolerance
+    uint32_t value;    // What to show: lockedMean while stable, else trimmedMean
+};
+
+void readingFilterReset(ReadingFilter *filter);
+// Add one raw sample and return the statistics of the updated window
+ReadingStats readingFilterAdd(ReadingFilter *filter, uint32_t sample);
@@ -0,0 +1,39 @@
+// Persistent user settings (LED brightness, measurement mode and the
+// calibration of each mode)
+#pragma once
+
+#include "hal.h"
+#include "measurement.h"
+
+// -- Preferences constants --
+
+#define PREF_NAMESPACE "roast_meter"
+#define PREF_VALID_KEY "valid"
+#define PREF_VALID_CODE (0xAA)
+#define PREF_LED_BRIGHTNESS_KEY "led_brightness"
+#define PREF_LED_BRIGHTNESS_DEFAULT 95
+#define PREF_INTERSECTION_POINT_KEY "intersection_point"
+#define PREF_INTERSECTION_POINT_DEFAULT 117
+#define PREF_DEVIATION_KEY "deviation"
+#define PREF_DEVIATION_DEFAULT 0.165f
+#define PREF_CAL_COUNT_KEY "cal_count"
+#define PREF_CAL_POINT_KEY "cal_pt"        // cal_pt0.. hold (level << 16) | (uint16_t)agtron
+#define PREF_RATIO_CAL_COUNT_KEY "rcal_count"
+#define PREF_RATIO_CAL_POINT_KEY "rcal_pt"  // Same packing, level is ratio level / 1000
+#define PREF_USE_RATIO_KEY "use_ratio"      // 1: MEASURE_MODE_RATIO
+
+// -- End Preferences constants
+
+enum SettingsStatus {
+    SETTINGS_LOADED,       // Valid store, values read
+    SETTINGS_INITIALIZED,  // Store was invalid, defaults written and read back
+    SETTINGS_DEFAULTS      // Store cannot be initialized, running on defaults
+};
+
+// Load ledBrightness, intersectionPoint, deviation, the measurement mode
+// and the calibration points of both modes from the store, and build the
+// calibration tables
+SettingsStatus loadSettings(KeyValueStore &store);
+// Write the points of the calibration of mode back to the store
+bool saveCalibration(KeyValueStore &store, MeasureMode mode);
+bool saveMeasureMode(KeyValueStore &store);
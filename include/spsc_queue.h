@@ -0,0 +1,70 @@
+// Lock-free single-producer / single-consumer ring queue
+//
+// Exactly one task pushes and exactly one other task pops; neither side
+// ever blocks or allocates. The producer publishes an item by releasing
+// head after writing the slot, the consumer frees a slot by releasing tail
+// after reading it. Only std::atomic is used, so the same code runs
+// between FreeRTOS tasks on the ESP32 and between std::threads in the
+// native env (see the stress mode in src/native/main.cpp).
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T, uint16_t N>
+class SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0), dropped(0), highWater(0) {}
+
+    // Producer: append item; a full queue drops it and counts the drop
+    bool push(const T &item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t used = h - tail.load(std::memory_order_acquire);
+        if (used >= N) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+
+        if (used + 1 > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(used + 1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer: take the oldest item
+    bool pop(T *item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+
+        *item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: discard everything queued so far
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Statistics, safe to read from any task
+    uint16_t depth() const {
+        uint32_t t = tail.load(std::memory_order_acquire);  // Tail first: head can only be ahead of it
+        return (uint16_t)(head.load(std::memory_order_acquire) - t);
+    }
+    uint16_t capacity() const { return N; }
+    uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    uint16_t highWaterMark() const { return (uint16_t)highWater.load(std::memory_order_relaxed); }
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head;       // Written by the producer only
+    std::atomic<uint32_t> tail;       // Written by the consumer only
+    std::atomic<uint32_t> dropped;    // Producer-side counters
+    std::atomic<uint32_t> highWater;
+};
@@ -0,0 +1,50 @@
+// Serial telemetry of the measurement results, without heap allocation.
+//
+// Text mode prints the familiar "real:" / "agtron:" blocks and warnings,
+// assembled in a caller-owned buffer instead of temporary Strings; the
+// Serial Plotter and existing parsers read it, so it carries no new
+// series. Binary mode streams every FIFO sample of a batch in one
+// DUMP_FRAME_TELEMETRY frame (see dump_frame.h), decoded live by
+// tools/telemetry.py; its TELEMETRY_FLAG_LOCKED marks stable readings.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+#include "hal.h"
+#include "measurement.h"
+
+// -- Telemetry constants --
+
+#define TELEMETRY_TEXT_SIZE 96    // Longest text block, with room to spare
+
+#define TELEMETRY_FLAG_VALID 0x01    // Raw IR in range; agtron is its table value
+#define TELEMETRY_FLAG_PRESENT 0x02  // Batch saw a sample loaded
+#define TELEMETRY_FLAG_LOCKED 0x04   // Batch ended with a locked reading
+#define TELEMETRY_FLAG_RATIO 0x08    // ir holds the Red / IR ratio level
+#define TELEMETRY_RANGE_SHIFT 4      // Bits 4-6: auto range step of the sample
+
+// -- End Telemetry constants --
+
+enum TelemetryMode {
+    TELEMETRY_TEXT,
+    TELEMETRY_BINARY,
+    TELEMETRY_OFF
+};
+
+// One sample of a DUMP_FRAME_TELEMETRY payload
+struct __attribute__((packed)) TelemetrySample {
+    uint32_t timestamp;
+    uint32_t ir;       // sampleLevel(): scaled IR without ambient light, or the ratio level
+    int16_t agtron;    // Mapped from this sample alone, 0 unless TELEMETRY_FLAG_VALID
+    uint8_t flags;     // TELEMETRY_FLAG_*
+};
+
+// Text block for result, as "\r\n"-terminated lines; returns its length
+// (0 when there is nothing to print), truncated to size - 1 characters
+uint16_t formatMeasurementText(char *out, uint16_t size, const MeasureResult &result);
+
+// Fill out (room for count entries) with the samples of a batch and the
+// batch result they produced; returns the payload length in bytes
+uint16_t buildTelemetrySamples(TelemetrySample *out, const SensorSample *batch, uint8_t count,
+                               const MeasureResult &result);
@@ -0,0 +1,52 @@
+// Adaptive LED warm-up: finished once the IR level and the MAX30105 die
+// temperature stop drifting, or after WARMUP_TIME at the latest.
+// Free of Arduino dependencies so it also builds in the native env.
+#pragma once
+
+#include <stdint.h>
+
+#include "config.h"
+
+// -- Warm-up constants --
+
+#ifndef WARMUP_BUCKET_MS
+#define WARMUP_BUCKET_MS 1000       // One IR mean and one die temperature per bucket
+#endif
+#ifndef WARMUP_WINDOW_BUCKETS
+#define WARMUP_WINDOW_BUCKETS 5     // Sliding window the drift is measured over
+#endif
+#ifndef WARMUP_IR_DRIFT_PPM
+#define WARMUP_IR_DRIFT_PPM 2000    // Max IR spread over the window, ppm of its mean
+#endif
+#ifndef WARMUP_TEMP_DRIFT_C
+#define WARMUP_TEMP_DRIFT_C 0.25f   // Max die temperature spread over the window
+#endif
+
+// -- End Warm-up constants --
+
+enum WarmupStatus {
+    WARMUP_RUNNING,
+    WARMUP_STABLE,    // Drift below both thresholds over the whole window
+    WARMUP_TIMEOUT    // WARMUP_TIME elapsed first
+};
+
+struct WarmupTracker {
+    uint32_t startTime;
+    uint32_t bucketStart;
+    uint64_t irSum;                            // Current bucket
+    uint16_t irCount;
+    float temperature;                         // Latest die temperature reading
+    bool temperatureValid;                     // At least one reading so far
+    uint32_t irMeans[WARMUP_WINDOW_BUCKETS];   // Closed buckets, ring
+    float temperatures[WARMUP_WINDOW_BUCKETS];
+    uint8_t buckets;                           // Closed buckets in the ring (saturates)
+    uint8_t next;                              // Ring slot for the next bucket
+};
+
+void warmupBegin(WarmupTracker *tracker, uint32_t now);
+// Feed every raw IR sample and every die temperature reading
+void warmupAddSample(WarmupTracker *tracker, uint32_t ir);
+void warmupAddTemperature(WarmupTracker *tracker, float celsius);
+// Close the bucket when due and decide whether warm-up is over
+WarmupStatus warmupUpdate(WarmupTracker *tracker, uint32_t now);
+uint32_t warmupElapsed(const WarmupTracker *tracker, uint32_t now);
@@ -0,0 +1,47 @@
+#include "auto_range.h"
+
+#define AUTO_RANGE_LOW ((uint32_t)((uint64_t)AUTO_RANGE_FULL_SCALE * AUTO_RANGE_LOW_PERCENT / 100))
+#define AUTO_RANGE_HIGH ((uint32_t)((uint64_t)AUTO_RANGE_FULL_SCALE * AUTO_RANGE_HIGH_PERCENT / 100))
+
+void autoRangeReset(AutoRange *range) {
+    range->step = AUTO_RANGE_BASELINE;
+}
+
+bool autoRangeUpdate(AutoRange *range, uint32_t rawMean, bool saturated) {
+#if AUTO_RANGE_ENABLED
+    if ((saturated || rawMean > AUTO_RANGE_HIGH) && range->step > 0) {
+        range->step--;
+        return true;
+    }
+    if (!saturated && rawMean < AUTO_RANGE_LOW && range->step < AUTO_RANGE_STEPS - 1) {
+        range->step++;
+        return true;
+    }
+#else
+    (void)range;
+    (void)rawMean;
+    (void)saturated;
+#endif
+    return false;
+}
+
+uint8_t autoRangeLedAmplitude(uint8_t step, uint8_t ledBrightness) {
+    if (step > 0) return ledBrightness;
+    return ledBrightness > 1 ? ledBrightness / 2 : ledBrightness;
+}
+
+int autoRangeAdcRange(uint8_t step) {
+    return step <= AUTO_RANGE_BASELINE ? AUTO_RANGE_BASE_ADC
+                                       : AUTO_RANGE_BASE_ADC >> (step - AUTO_RANGE_BASELINE);
+}
+
+uint32_t autoRangeNormalize(uint32_t raw, uint8_t step, uint8_t ledBrightness) {
+    uint8_t ledAmplitude = autoRangeLedAmplitude(step, ledBrightness);
+    if (step == AUTO_RANGE_BASELINE || ledAmplitude == 0) return raw;
+
+    // Counts per unit of reflected light scale with the LED amplitude and
+    // inversely with the ADC range
+    uint64_t numerator = (uint64_t)raw * (uint32_t)autoRangeAdcRange(step) * ledBrightness;
+    uint64_t denominator = (uint64_t)AUTO_RANGE_BASE_ADC * ledAmplitude;
+    return (uint32_t)((numerator + denominator / 2) / denominator);
+}
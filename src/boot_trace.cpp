@@ -0,0 +1,31 @@
+#include "boot_trace.h"
+
+#include <string.h>
+
+static const char *const phaseNames[BOOT_PHASE_COUNT] = {
+    "setup",
+    "display",
+    "settings",
+    "log",
+    "sensor",
+    "warmup",
+    "first_reading",
+};
+
+void bootTraceReset(BootTrace *trace) {
+    memset(trace, 0, sizeof(BootTrace));
+}
+
+void bootPhaseStart(BootTrace *trace, BootPhase phase, uint32_t nowUs) {
+    trace->startUs[phase] = nowUs;
+    trace->started[phase] = true;
+}
+
+void bootPhaseEnd(BootTrace *trace, BootPhase phase, uint32_t nowUs) {
+    trace->endUs[phase] = nowUs;
+    trace->ended[phase] = true;
+}
+
+const char *bootPhaseName(BootPhase phase) {
+    return phase < BOOT_PHASE_COUNT ? phaseNames[phase] : "?";
+}
@@ -0,0 +1,79 @@
+#include "calibration.h"
+
+Calibration calibration;
+Calibration ratioCalibration = { {}, 0, {}, mapRatioToAgtron };
+
+// Value at level on the line through a and b, rounded half away from zero
+// like mapIRToAgtron, and clamped to the table's range
+static int16_t interpolate(const CalPoint &a, const CalPoint &b, int32_t level) {
+    int32_t span = (int32_t)b.level - a.level;
+    int32_t numerator = (level - a.level) * ((int32_t)b.agtron - a.agtron);
+    int32_t offset = numerator >= 0 ? (numerator + span / 2) / span : (numerator - span / 2) / span;
+    int32_t value = a.agtron + offset;
+
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return (int16_t)value;
+}
+
+// Rewrite table[first..last] from the points or, below two points, the formula
+static void fillTable(Calibration *cal, uint16_t first, uint16_t last) {
+    if (cal->count < 2) {
+        int (*formula)(uint32_t) = cal->formula ? cal->formula : mapIRToAgtron;
+        for (uint32_t level = first; level <= last; level++) {
+            cal->table[level] = (int16_t)formula(level);
+        }
+        return;
+    }
+
+    // Segment s joins points s and s + 1; the first and last segments
+    // also cover the levels outside the points
+    uint8_t segment = 0;
+    for (uint32_t level = first; level <= last; level++) {
+        while (segment < cal->count - 2 && level > cal->points[segment + 1].level) {
+            segment++;
+        }
+        cal->table[level] = interpolate(cal->points[segment], cal->points[segment + 1], level);
+    }
+}
+
+void calibrationReset(Calibration *cal) {
+    cal->count = 0;
+    calibrationRebuild(cal);
+}
+
+void calibrationRebuild(Calibration *cal) {
+    fillTable(cal, 0, SCALED_LEVEL_MAX);
+}
+
+bool calibrationAddPoint(Calibration *cal, uint16_t level, int16_t agtron) {
+    if (level > SCALED_LEVEL_MAX) return false;
+
+    uint8_t index = 0;
+    while (index < cal->count && cal->points[index].level < level) {
+        index++;
+    }
+
+    if (index == cal->count || cal->points[index].level != level) {
+        if (cal->count == CAL_MAX_POINTS) return false;
+        for (uint8_t i = cal->count; i > index; i--) {
+            cal->points[i] = cal->points[i - 1];
+        }
+        cal->count++;
+    }
+    cal->points[index].level = level;
+    cal->points[index].agtron = agtron;
+
+    if (cal->count < 2) return true;  // Still on the formula
+    if (cal->count == 2) {
+        calibrationRebuild(cal);       // Formula -> points
+        return true;
+    }
+
+    // Only the segments on either side of the point changed, plus the
+    // extended ends when the point is or neighbours an outermost one
+    uint16_t first = index <= 1 ? 0 : cal->points[index - 1].level;
+    uint16_t last = index + 2 >= cal->count ? SCALED_LEVEL_MAX : cal->points[index + 1].level;
+    fillTable(cal, first, last);
+    return true;
+}
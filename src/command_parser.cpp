@@ -0,0 +1,121 @@
+#include "command_parser.h"
+
+#include <stdlib.h>
+
+// -- Line Assembly --
+
+void commandLineReset(CommandLine *line) {
+    line->length = 0;
+    line->overflow = false;
+    line->buffer[0] = '\0';
+}
+
+CommandFeedResult commandLineFeed(CommandLine *line, char c) {
+    if (c == '\r' || c == '\n') {
+        bool overflow = line->overflow;
+        bool empty = line->length == 0;
+        line->buffer[line->length] = '\0';
+        line->length = 0;
+        line->overflow = false;
+
+        if (overflow) return COMMAND_TOO_LONG;
+        return empty ? COMMAND_PENDING : COMMAND_READY;
+    }
+
+    if (line->overflow) return COMMAND_PENDING;
+    if (line->length >= COMMAND_LINE_SIZE - 1) {
+        line->overflow = true;
+        return COMMAND_PENDING;
+    }
+
+    if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+    line->buffer[line->length++] = c;
+    return COMMAND_PENDING;
+}
+
+// -- End Line Assembly --
+
+// -- Dispatch --
+
+static uint8_t splitWords(char *line, char **words) {
+    uint8_t count = 0;
+    char *p = line;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t') *p++ = '\0';
+        if (!*p) break;
+        if (count == COMMAND_MAX_WORDS) break;  // Extra words are ignored
+        words[count++] = p;
+        while (*p && *p != ' ' && *p != '\t') p++;
+    }
+    return count;
+}
+
+// Number of words of name matched by the first words, 0 if it does not match
+static uint8_t matchName(const char *name, char *const *words, uint8_t wordCount) {
+    uint8_t matched = 0;
+
+    while (*name) {
+        if (matched == wordCount) return 0;
+        const char *word = words[matched];
+        while (*name && *name != ' ' && *name == *word) {
+            name++;
+            word++;
+        }
+        if (*word || (*name && *name != ' ')) return 0;
+        if (*name == ' ') name++;
+        matched++;
+    }
+    return matched;
+}
+
+CommandDispatchResult dispatchCommand(const CommandEntry *table, uint8_t tableSize, char *line) {
+    char *words[COMMAND_MAX_WORDS];
+    uint8_t wordCount = splitWords(line, words);
+    if (wordCount == 0) return COMMAND_EMPTY;
+
+    const CommandEntry *best = NULL;
+    uint8_t bestWords = 0;
+    for (uint8_t i = 0; i < tableSize; i++) {
+        uint8_t matched = matchName(table[i].name, words, wordCount);
+        if (matched > bestWords) {
+            best = &table[i];
+            bestWords = matched;
+        }
+    }
+    if (best == NULL) return COMMAND_UNKNOWN;
+
+    CommandArgs args;
+    args.count = wordCount - bestWords;
+    for (uint8_t i = 0; i < args.count; i++) {
+        args.values[i] = words[bestWords + i];
+    }
+    best->handler(args);
+    return COMMAND_DISPATCHED;
+}
+
+// -- End Dispatch --
+
+// -- Arguments --
+
+bool commandArgInt(const CommandArgs &args, uint8_t index, int32_t *value) {
+    if (index >= args.count) return false;
+
+    char *end;
+    long parsed = strtol(args.values[index], &end, 10);
+    if (end == args.values[index] || *end) return false;
+    *value = (int32_t)parsed;
+    return true;
+}
+
+bool commandArgUInt(const CommandArgs &args, uint8_t index, uint32_t *value) {
+    if (index >= args.count || args.values[index][0] == '-') return false;
+
+    char *end;
+    unsigned long parsed = strtoul(args.values[index], &end, 10);
+    if (end == args.values[index] || *end) return false;
+    *value = (uint32_t)parsed;
+    return true;
+}
+
+// -- End Arguments --
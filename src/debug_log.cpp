@@ -0,0 +1,728 @@
+#include "debug_log.h"
+
+#if DEBUG_LOGGING_ENABLED
+#include <stddef.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "log_codec.h"
+#include "measurement.h"
+
+#define LOG_PAGE_DATA_START ((uint16_t)sizeof(LogPageHeader))
+
+// Debug logging state
+LogEntry logBuffer[LOG_BUFFER_SIZE];
+uint16_t logBufferCount = 0;
+unsigned long lastMeasurementTime = 0;
+bool logReady = false;
+
+static LogStorage *logStorage = NULL;
+static uint16_t pageCount = 0;
+
+// Live pages form an arc of the ring from oldestPage to currentPage
+static uint16_t currentPage = 0;       // Page being appended to
+static uint32_t currentSequence = 0;   // Its sequence number
+static uint16_t pageOffset = 0;        // Next free byte in currentPage
+static uint16_t oldestPage = 0;
+static uint16_t pagesUsed = 0;
+static uint32_t currentFirstEntry = 0; // firstEntry of currentPage
+static uint32_t oldestFirstEntry = 0;  // firstEntry of oldestPage
+static uint32_t entryCount = 0;        // Entries on flash since the last reset
+static uint32_t currentSession = 0;    // Session of this boot
+static uint32_t pageSession = 0;       // Session of the newest records on currentPage
+
+// Delta chain of the page being appended to
+static LogEncoder logEncoder;
+
+// Block header and payload go out in a single flash write; an entry takes
+// at most a settings record plus a sample record, and the first block of
+// a session may open with a session record
+static uint8_t blockBuffer[sizeof(LogBlockHeader) + LOG_SESSION_RECORD_BYTES +
+                           LOG_BUFFER_SIZE * 2 * LOG_MAX_RECORD_BYTES];
+
+static uint32_t pageAddress(uint16_t page) {
+    return (uint32_t)page * LOG_PAGE_SIZE;
+}
+
+static uint16_t livePage(uint16_t index) {
+    return (oldestPage + index) % pageCount;
+}
+
+static uint32_t headerSession(const LogPageHeader &header) {
+    return header.session == LOG_SESSION_UNKNOWN ? 0 : header.session;
+}
+
+static bool readPageHeader(uint16_t page, LogPageHeader *header) {
+    if (!logStorage->read(pageAddress(page), header, sizeof(LogPageHeader))) return false;
+    return header->magic == LOG_PAGE_MAGIC &&
+           (header->version == LOG_VERSION_FIXED || header->version == LOG_VERSION_DELTA) &&
+           header->crc == crc32(header, offsetof(LogPageHeader, crc));
+}
+
+// Erase page and write its header; it becomes the append target
+static bool startPage(uint16_t page, uint32_t sequence, uint16_t flags) {
+    if (!logStorage->eraseSector(pageAddress(page))) return false;
+
+    LogPageHeader header;
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = LOG_PAGE_MAGIC;
+    header.sequence = sequence;
+    header.firstEntry = entryCount;
+    header.version = LOG_VERSION;
+    header.flags = flags;
+    header.session = currentSession;
+    header.crc = crc32(&header, offsetof(LogPageHeader, crc));
+
+    if (!logStorage->write(pageAddress(page), &header, sizeof(header))) return false;
+
+    currentPage = page;
+    currentSequence = sequence;
+    currentFirstEntry = entryCount;
+    pageOffset = LOG_PAGE_DATA_START;
+    pageSession = currentSession;
+    logEncoderReset(&logEncoder);
+    return true;
+}
+
+// Move on to the next page of the ring, evicting the oldest one when full
+static bool advancePage() {
+    uint16_t next = (currentPage + 1) % pageCount;
+
+    if (pagesUsed == pageCount) {
+        // next is the oldest live page; its successor takes over
+        oldestPage = (next + 1) % pageCount;
+        LogPageHeader header;
+        if (readPageHeader(oldestPage, &header)) {
+            oldestFirstEntry = header.firstEntry;
+        }
+    } else {
+        pagesUsed++;
+    }
+
+    return startPage(next, currentSequence + 1, 0);
+}
+
+// Walk the blocks of page (with the given header) and decode their entries
+// into visit through decoder. Returns the offset just past the last valid
+// block; *torn is set when the walk ended on a damaged block rather than
+// on erased flash.
+static uint16_t walkPage(uint16_t page, const LogPageHeader &header, LogDecoder *decoder, bool *torn,
+                         LogEntryVisitor visit, void *context) {
+    static uint8_t payload[LOG_PAGE_SIZE - sizeof(LogPageHeader) - sizeof(LogBlockHeader)];
+    uint16_t offset = LOG_PAGE_DATA_START;
+
+    logDecoderReset(decoder, headerSession(header));
+    *torn = false;
+    while (offset + sizeof(LogBlockHeader) <= LOG_PAGE_SIZE) {
+        LogBlockHeader block;
+        if (!logStorage->read(pageAddress(page) + offset, &block, sizeof(block))) {
+            *torn = true;
+            break;
+        }
+        if (block.length == LOG_BLOCK_ERASED && block.crc == 0xFFFF) {
+            break;  // End of written data
+        }
+
+        uint16_t space = LOG_PAGE_SIZE - offset - sizeof(LogBlockHeader);
+        if (block.length == 0 || block.length > space ||
+            !logStorage->read(pageAddress(page) + offset + sizeof(block), payload, block.length) ||
+            (uint16_t)crc32(payload, block.length) != block.crc ||
+            !logDecodeBlock(decoder, header.version, payload, block.length, visit, context)) {
+            *torn = true;
+            break;
+        }
+
+        offset += sizeof(LogBlockHeader) + block.length;
+    }
+    return offset;
+}
+
+static void countEntries(const LogEntry &entry, void *context) {
+    (void)entry;
+    (*(uint32_t*)context)++;
+}
+
+LogOpenStatus setupDebugLog(LogStorage &storage) {
+    logStorage = &storage;
+    logReady = false;
+    logBufferCount = 0;
+
+    if (!storage.mount()) {
+        return LOG_OPEN_MOUNT_FAILED;
+    }
+    pageCount = storage.size() / LOG_PAGE_SIZE;
+    if (pageCount < 2) {
+        return LOG_OPEN_CREATE_FAILED;
+    }
+
+    // Fast scan: only the page headers are read
+    bool found = false;
+    bool haveReset = false;
+    uint32_t newestSequence = 0;
+    uint32_t resetSequence = 0;
+    uint32_t lowestSequence = 0xFFFFFFFF;
+    uint16_t newestPage = 0;
+    LogPageHeader header;
+
+    for (uint16_t page = 0; page < pageCount; page++) {
+        if (!readPageHeader(page, &header)) continue;
+
+        if (!found || header.sequence > newestSequence) {
+            newestSequence = header.sequence;
+            newestPage = page;
+        }
+        if (header.sequence < lowestSequence) {
+            lowestSequence = header.sequence;
+        }
+        if ((header.flags & LOG_PAGE_FLAG_RESET) && (!haveReset || header.sequence > resetSequence)) {
+            resetSequence = header.sequence;
+            haveReset = true;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        currentSession = 1;
+        entryCount = 0;
+        oldestFirstEntry = 0;
+        oldestPage = 0;
+        pagesUsed = 1;
+        if (!startPage(0, 1, LOG_PAGE_FLAG_RESET)) {
+            return LOG_OPEN_CREATE_FAILED;
+        }
+        logReady = true;
+        return LOG_OPEN_CREATED;
+    }
+
+    // Live arc: everything from the latest reset (or the oldest page) on
+    uint32_t liveSequence = haveReset ? resetSequence : lowestSequence;
+    pagesUsed = newestSequence - liveSequence + 1;
+    if (pagesUsed > pageCount) {
+        pagesUsed = pageCount;
+    }
+    oldestPage = (newestPage + pageCount - (pagesUsed - 1)) % pageCount;
+    oldestFirstEntry = readPageHeader(oldestPage, &header) ? header.firstEntry : 0;
+
+    // Find the append position in the newest page
+    readPageHeader(newestPage, &header);
+    currentPage = newestPage;
+    currentSequence = newestSequence;
+    currentFirstEntry = header.firstEntry;
+
+    bool torn = false;
+    uint32_t pageEntries = 0;
+    LogDecoder decoder;
+    pageOffset = walkPage(newestPage, header, &decoder, &torn, countEntries, &pageEntries);
+    entryCount = currentFirstEntry + pageEntries;
+
+    // The newest page ends with the highest session; this boot is the next
+    // one and carries on on the same page, its first flush opening with a
+    // session record
+    pageSession = decoder.session;
+    currentSession = pageSession + 1;
+
+    // Appending continues on the same page after a reboot with a new delta chain
+    logEncoderReset(&logEncoder);
+
+    LogOpenStatus status = torn ? LOG_OPEN_RECOVERED : LOG_OPEN_LOADED;
+
+    // Bytes after a damaged block cannot be reprogrammed, and a page keeps
+    // one encoding: continue on a new page in either case
+    if (torn || header.version != LOG_VERSION) {
+        if (!advancePage()) {
+            return LOG_OPEN_CREATE_FAILED;
+        }
+    }
+
+    logReady = true;
+    return status;
+}
+
+// Flash cannot change during deep sleep; one header read confirms the
+// position still belongs to this partition
+LogOpenStatus resumeDebugLog(LogStorage &storage, const LogPosition &position) {
+    logStorage = &storage;
+    logReady = false;
+    logBufferCount = 0;
+
+    if (!storage.mount()) {
+        return LOG_OPEN_MOUNT_FAILED;
+    }
+
+    LogPageHeader header;
+    if (storage.size() / LOG_PAGE_SIZE != position.pageCount || position.currentPage >= position.pageCount ||
+        !readPageHeader(position.currentPage, &header) || header.sequence != position.currentSequence ||
+        header.version != LOG_VERSION) {
+        return setupDebugLog(storage);
+    }
+
+    pageCount = position.pageCount;
+    currentPage = position.currentPage;
+    currentSequence = position.currentSequence;
+    pageOffset = position.pageOffset;
+    oldestPage = position.oldestPage;
+    pagesUsed = position.pagesUsed;
+    currentFirstEntry = position.currentFirstEntry;
+    oldestFirstEntry = position.oldestFirstEntry;
+    entryCount = position.entryCount;
+
+    // A wake is no new session: the one that went to sleep carries on, on
+    // the same page; only the delta chain in RAM is lost
+    currentSession = position.session;
+    pageSession = position.pageSession;
+    logEncoderReset(&logEncoder);
+
+    logReady = true;
+    return LOG_OPEN_LOADED;
+}
+
+bool getLogPosition(LogPosition *position) {
+    memset(position, 0, sizeof(LogPosition));
+    if (!logReady) return false;
+
+    position->pageCount = pageCount;
+    position->currentPage = currentPage;
+    position->pageOffset = pageOffset;
+    position->oldestPage = oldestPage;
+    position->pagesUsed = pagesUsed;
+    position->currentSequence = currentSequence;
+    position->currentFirstEntry = currentFirstEntry;
+    position->oldestFirstEntry = oldestFirstEntry;
+    position->entryCount = entryCount;
+    position->session = currentSession;
+    position->pageSession = pageSession;
+    return true;
+}
+
+static bool bufferEntry(uint32_t timestamp, uint32_t rawIR, int16_t agtron, uint16_t flags) {
+    if (!logReady) return true;
+
+    // Flush first if buffer is full (ensures space for new entry)
+    if (logBufferCount >= LOG_BUFFER_SIZE) {
+        flushLogBuffer();
+    }
+
+    // Only add if there's space (handles case where flush failed)
+    if (logBufferCount >= LOG_BUFFER_SIZE) {
+        return false;
+    }
+
+    // Create entry
+    LogEntry entry;
+    entry.timestamp = timestamp;
+    entry.rawIR = rawIR;
+    entry.agtron = agtron;
+    entry.ledBrightness = ledBrightness;
+    entry.intersectPt = (uint8_t)intersectionPoint;
+    entry.deviationX1000 = deviationX1000;
+    entry.flags = flags;
+
+    // Add to buffer
+    logBuffer[logBufferCount++] = entry;
+    lastMeasurementTime = timestamp;
+    return true;
+}
+
+bool logMeasurement(uint32_t timestamp, uint32_t rawIR, int16_t agtron, uint16_t flags) {
+    return bufferEntry(timestamp, rawIR, agtron, flags & ~LOG_FLAG_WARMUP);
+}
+
+bool logWarmup(uint32_t timestamp, uint32_t durationMs, uint8_t reason) {
+    return bufferEntry(timestamp, durationMs, reason, LOG_FLAG_WARMUP);
+}
+
+// Write the encoded block sitting in blockBuffer; entries is its entry count
+static bool appendBlock(uint16_t length, uint16_t entries) {
+    LogBlockHeader block;
+    block.length = length;
+    block.crc = (uint16_t)crc32(blockBuffer + sizeof(block), length);
+    memcpy(blockBuffer, &block, sizeof(block));
+
+    uint16_t total = sizeof(block) + length;
+    if (!logStorage->write(pageAddress(currentPage) + pageOffset, blockBuffer, total)) {
+        return false;
+    }
+    pageOffset += total;
+    entryCount += entries;
+    return true;
+}
+
+bool flushLogBuffer() {
+    if (!logReady || logBufferCount == 0) return true;
+
+    uint16_t written = 0;
+    while (written < logBufferCount) {
+        uint16_t space = LOG_PAGE_SIZE - pageOffset;
+        space = space > sizeof(LogBlockHeader) ? space - sizeof(LogBlockHeader) : 0;
+
+        // A boot's first entries on a page an earlier session started
+        uint16_t length = 0;
+        uint16_t count = 0;
+        uint8_t *payload = blockBuffer + sizeof(LogBlockHeader);
+        if (pageSession != currentSession) {
+            length = logEncodeSession(currentSession, payload);
+        }
+
+        // Encode as many entries as the rest of the page holds
+        while (written + count < logBufferCount) {
+            LogEncoder saved = logEncoder;
+            uint8_t record[2 * LOG_MAX_RECORD_BYTES];
+            uint8_t n = logEncodeEntry(&logEncoder, logBuffer[written + count], record);
+            if (length + n > space) {
+                logEncoder = saved;
+                break;
+            }
+            memcpy(payload + length, record, n);
+            length += n;
+            count++;
+        }
+
+        if (count == 0) {
+            if (!advancePage()) return false;
+            continue;
+        }
+
+        if (!appendBlock(length, count)) {
+            // Whatever reached flash of this block fails its CRC; skip the rest of the page
+            pageOffset = LOG_PAGE_SIZE;
+            memmove(logBuffer, &logBuffer[written], (logBufferCount - written) * sizeof(LogEntry));
+            logBufferCount -= written;
+            return false;
+        }
+        pageSession = currentSession;
+        written += count;
+    }
+
+    logBufferCount = 0;
+    return true;
+}
+
+bool logFlushDue(uint32_t now) {
+    return logBufferCount > 0 && (now - lastMeasurementTime > LOG_FLUSH_IDLE_MS);
+}
+
+void resetLog() {
+    if (!logReady) return;
+
+    // Clear buffer
+    logBufferCount = 0;
+
+    entryCount = 0;
+    oldestFirstEntry = 0;
+    oldestPage = (currentPage + 1) % pageCount;
+    pagesUsed = 1;
+    startPage(oldestPage, currentSequence + 1, LOG_PAGE_FLAG_RESET);
+}
+
+LogStatus getLogStatus() {
+    LogStatus status;
+    status.entryCount = entryCount;
+    status.storedEntries = entryCount - oldestFirstEntry;
+    status.pageCount = pageCount;
+    status.pagesUsed = pagesUsed;
+    status.currentPage = currentPage;
+    status.pageSequence = currentSequence;
+    status.oldestSequence = currentSequence - (pagesUsed - 1);
+    status.session = currentSession;
+    status.wrapped = oldestFirstEntry > 0;
+    return status;
+}
+
+struct EntryWalk {
+    void (*visit)(const LogEntry &entry, uint32_t index);
+    uint32_t index;
+};
+
+static void visitEntry(const LogEntry &entry, void *context) {
+    EntryWalk *walk = (EntryWalk*)context;
+    walk->visit(entry, walk->index++);
+}
+
+bool forEachLogEntry(void (*visit)(const LogEntry &entry, uint32_t index)) {
+    if (!logReady) return false;
+
+    EntryWalk walk;
+    walk.visit = visit;
+    walk.index = 0;
+
+    for (uint16_t i = 0; i < pagesUsed; i++) {
+        uint16_t page = (oldestPage + i) % pageCount;
+        LogPageHeader header;
+        LogDecoder decoder;
+        bool torn;
+        if (!readPageHeader(page, &header)) continue;
+        walkPage(page, header, &decoder, &torn, visitEntry, &walk);
+    }
+    return true;
+}
+
+bool readLogPage(uint32_t sequence, uint8_t *buffer, uint16_t *used) {
+    uint32_t oldestSequence = currentSequence - (pagesUsed - 1);
+    if (!logReady || sequence < oldestSequence || sequence > currentSequence) return false;
+
+    uint16_t page = (oldestPage + (sequence - oldestSequence)) % pageCount;
+    if (!logStorage->read(pageAddress(page), buffer, LOG_PAGE_SIZE)) return false;
+
+    // Follow the block lengths only; the reader checks the CRCs
+    uint16_t offset = LOG_PAGE_DATA_START;
+    while (offset + sizeof(LogBlockHeader) <= LOG_PAGE_SIZE) {
+        LogBlockHeader block;
+        memcpy(&block, buffer + offset, sizeof(block));
+        if (block.length == LOG_BLOCK_ERASED ||
+            block.length > LOG_PAGE_SIZE - offset - sizeof(LogBlockHeader)) {
+            break;
+        }
+        offset += sizeof(LogBlockHeader) + block.length;
+    }
+    *used = offset;
+    return true;
+}
+
+// -- Sessions and ranges --
+//
+// Session numbers and firstEntry only grow along the live arc, so both
+// are found by binary search over page headers. A header holds the
+// session open when its page was started; sessions that began later on
+// the page are in its session records, so a page is only decoded where
+// the next page's header (or, for the current page, pageSession) shows
+// the session changing on it.
+
+static bool sessionAtLeast(const LogPageHeader &header, uint32_t session) {
+    return headerSession(header) >= session;
+}
+
+static bool sessionAbove(const LogPageHeader &header, uint32_t session) {
+    return headerSession(header) > session;
+}
+
+static bool firstEntryAbove(const LogPageHeader &header, uint32_t entry) {
+    return header.firstEntry > entry;
+}
+
+// Index (0 = oldest) of the first live page matching the predicate,
+// pagesUsed if none does
+static uint16_t searchLivePages(bool (*matches)(const LogPageHeader &header, uint32_t key), uint32_t key) {
+    uint16_t low = 0;
+    uint16_t high = pagesUsed;
+    while (low < high) {
+        uint16_t mid = (low + high) / 2;
+        LogPageHeader header;
+        if (readPageHeader(livePage(mid), &header) && matches(header, key)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+struct RangeWalk {
+    void (*visit)(const LogEntry &entry, uint32_t index);
+    uint32_t index;          // Entry number of the next decoded entry
+    uint32_t first;
+    uint32_t end;
+};
+
+static void visitRangeEntry(const LogEntry &entry, void *context) {
+    RangeWalk *walk = (RangeWalk*)context;
+    if (walk->index >= walk->first && walk->index < walk->end) {
+        walk->visit(entry, walk->index);
+    }
+    walk->index++;
+}
+
+bool forEachLogEntryInRange(uint32_t first, uint32_t count,
+                            void (*visit)(const LogEntry &entry, uint32_t index)) {
+    if (!logReady || count == 0 || first >= entryCount) return false;
+
+    // Last page starting at or before first; empty pages share the
+    // firstEntry of their successor and are passed over
+    uint16_t start = searchLivePages(firstEntryAbove, first);
+    if (start > 0) start--;
+
+    RangeWalk walk;
+    walk.visit = visit;
+    walk.first = first;
+    walk.end = count > entryCount - first ? entryCount : first + count;
+    if (walk.end <= oldestFirstEntry) return false;
+
+    for (uint16_t i = start; i < pagesUsed; i++) {
+        uint16_t page = livePage(i);
+        LogPageHeader header;
+        LogDecoder decoder;
+        bool torn;
+        if (!readPageHeader(page, &header)) continue;
+        if (header.firstEntry >= walk.end) break;
+
+        walk.index = header.firstEntry;
+        walkPage(page, header, &decoder, &torn, visitRangeEntry, &walk);
+    }
+    return true;
+}
+
+// Whether live page index holds session records
+static bool pageHasSessionRecords(uint16_t index, const LogPageHeader &header) {
+    if (index + 1 == pagesUsed) return pageSession != headerSession(header);
+    LogPageHeader next;
+    return !readPageHeader(livePage(index + 1), &next) || headerSession(next) != headerSession(header);
+}
+
+typedef void (*SessionVisitor)(uint32_t session, uint32_t firstEntry, void *context);
+
+struct SessionWalk {
+    const LogDecoder *decoder;
+    uint32_t session;        // Of the entries visited so far
+    uint32_t index;          // Entry number of the next decoded entry
+    SessionVisitor visit;
+    void *context;
+};
+
+static void visitSessionEntry(const LogEntry &entry, void *context) {
+    (void)entry;
+    SessionWalk *walk = (SessionWalk*)context;
+    if (walk->decoder->session != walk->session) {
+        walk->session = walk->decoder->session;
+        walk->visit(walk->session, walk->index, walk->context);
+    }
+    walk->index++;
+}
+
+// Visit the session and first entry number of every session record on
+// live page index
+static void walkPageSessions(uint16_t index, const LogPageHeader &header, SessionVisitor visit, void *context) {
+    LogDecoder decoder;
+    SessionWalk walk;
+    walk.decoder = &decoder;
+    walk.session = headerSession(header);
+    walk.index = header.firstEntry;
+    walk.visit = visit;
+    walk.context = context;
+
+    bool torn;
+    walkPage(livePage(index), header, &decoder, &torn, visitSessionEntry, &walk);
+}
+
+struct SessionList {
+    void (*visit)(const LogSessionInfo &info);
+    LogSessionInfo info;
+    bool open;
+    uint32_t sequence;       // Of the page being walked
+};
+
+// A session starts at firstEntry on the page being walked, or the open
+// one carries on onto it
+static void listSession(uint32_t session, uint32_t firstEntry, void *context) {
+    SessionList *list = (SessionList*)context;
+    if (list->open && session == list->info.session) {
+        list->info.pages++;
+        return;
+    }
+    if (list->open) {
+        list->info.entries = firstEntry - list->info.firstEntry;
+        list->visit(list->info);
+    }
+    list->info.session = session;
+    list->info.firstEntry = firstEntry;
+    list->info.firstSequence = list->sequence;
+    list->info.pages = 1;
+    list->open = true;
+}
+
+bool forEachLogSession(void (*visit)(const LogSessionInfo &info)) {
+    if (!logReady) return false;
+
+    uint32_t oldestSequence = currentSequence - (pagesUsed - 1);
+    SessionList list;
+    list.visit = visit;
+    list.open = false;
+
+    for (uint16_t i = 0; i < pagesUsed; i++) {
+        LogPageHeader header;
+        if (!readPageHeader(livePage(i), &header)) continue;
+
+        list.sequence = oldestSequence + i;
+        listSession(headerSession(header), header.firstEntry, &list);
+        if (pageHasSessionRecords(i, header)) {
+            walkPageSessions(i, header, listSession, &list);
+        }
+    }
+
+    if (list.open) {
+        list.info.entries = entryCount - list.info.firstEntry;
+        visit(list.info);
+    }
+    return true;
+}
+
+struct SessionRecordSearch {
+    uint32_t atLeast;
+    uint32_t session;        // Of the first record found
+    uint32_t firstEntry;
+    bool found;
+};
+
+static void matchSessionRecord(uint32_t session, uint32_t firstEntry, void *context) {
+    SessionRecordSearch *search = (SessionRecordSearch*)context;
+    if (search->found || session < search->atLeast) return;
+    search->session = session;
+    search->firstEntry = firstEntry;
+    search->found = true;
+}
+
+// First session record on live page index for a session of at least
+// atLeast; false if there is none
+static bool findSessionRecord(uint16_t index, uint32_t atLeast, SessionRecordSearch *search) {
+    LogPageHeader header;
+    search->atLeast = atLeast;
+    search->found = false;
+    if (!readPageHeader(livePage(index), &header) || !pageHasSessionRecords(index, header)) return false;
+    walkPageSessions(index, header, matchSessionRecord, search);
+    return search->found;
+}
+
+bool findLogSession(uint32_t session, LogSessionInfo *info) {
+    if (!logReady) return false;
+
+    // The session begins with a record on the last page started before
+    // it, or else the first page started in it begins with the session
+    uint16_t start = searchLivePages(sessionAtLeast, session);
+    uint16_t first = start;
+    uint32_t firstEntry;
+    SessionRecordSearch search;
+    if (start > 0 && findSessionRecord(start - 1, session, &search) && search.session == session) {
+        first = start - 1;
+        firstEntry = search.firstEntry;
+    } else {
+        LogPageHeader header;
+        if (start == pagesUsed || !readPageHeader(livePage(start), &header) ||
+            headerSession(header) != session) {
+            return false;
+        }
+        firstEntry = header.firstEntry;
+    }
+
+    // It ends at a later session's record on its last page, or where the
+    // next page starts
+    uint16_t end = searchLivePages(sessionAbove, session);
+    uint32_t endEntry = entryCount;
+    LogPageHeader next;
+    if (findSessionRecord(end - 1, session + 1, &search)) {
+        endEntry = search.firstEntry;
+    } else if (end < pagesUsed && readPageHeader(livePage(end), &next)) {
+        endEntry = next.firstEntry;
+    }
+
+    info->session = session;
+    info->firstEntry = firstEntry;
+    info->entries = endEntry - firstEntry;
+    info->firstSequence = currentSequence - (pagesUsed - 1) + first;
+    info->pages = end - first;
+    return info->entries > 0;
+}
+
+uint32_t lastLogSession() {
+    return logReady ? pageSession : currentSession;
+}
+
+// -- End Sessions and ranges --
+#endif
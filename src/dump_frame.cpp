@@ -0,0 +1,23 @@
+#include "dump_frame.h"
+
+#include "crc32.h"
+
+void writeDumpFrame(DumpWriter write, uint8_t type, uint32_t sequence,
+                    const void *payload, uint16_t length) {
+    DumpFrameHeader header;
+    header.sync[0] = DUMP_FRAME_SYNC0;
+    header.sync[1] = DUMP_FRAME_SYNC1;
+    header.type = type;
+    header.reserved = 0;
+    header.sequence = sequence;
+    header.length = length;
+
+    uint32_t crc = crc32Update(0, &header, sizeof(header));
+    crc = crc32Update(crc, payload, length);
+
+    write((const uint8_t*)&header, sizeof(header));
+    if (length > 0) {
+        write((const uint8_t*)payload, length);
+    }
+    write((const uint8_t*)&crc, sizeof(crc));
+}
@@ -0,0 +1,494 @@
+#include "hal_arduino.h"
+
+// -- I2C Bus --
+
+I2cBus::I2cBus()
+    : sensorLocks(0), sensorWaits(0), sensorWaitMaxUs(0), displayLocks(0), mutex(NULL) {}
+
+void I2cBus::begin() {
+    if (mutex == NULL) mutex = xSemaphoreCreateMutex();
+}
+
+void I2cBus::lockSensor() {
+    sensorLocks++;
+    if (xSemaphoreTake(mutex, 0) == pdTRUE) return;
+
+    uint32_t start = micros();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t waited = micros() - start;
+    sensorWaits++;
+    if (waited > sensorWaitMaxUs) sensorWaitMaxUs = waited;
+}
+
+void I2cBus::lockDisplay() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    displayLocks++;
+}
+
+void I2cBus::unlock() {
+    xSemaphoreGive(mutex);
+}
+
+// -- End I2C Bus --
+
+// -- Sensor --
+
+Max30105Sensor::Max30105Sensor(I2cBus &bus) : bus(bus), interruptEnabled(false), ambientSlot(false), redSlot(false) {
+    memset(&fifo, 0, sizeof(fifo));
+}
+
+bool Max30105Sensor::begin() {
+    I2cBusLock lock(bus, true);
+    return particleSensor.begin(Wire, 400000);  // Use default I2C port, 400kHz speed
+}
+
+void Max30105Sensor::configure(const SensorConfig &config) {
+    I2cBusLock lock(bus, true);
+    // The library reads ledMode words per FIFO sample, one per slot in slot
+    // order, and only ever whole samples per I2C burst. With as many words
+    // as enabled slots, Red, IR and the dark slot of one sample stay
+    // together however the FIFO is split into bursts.
+    uint8_t ledMode = config.ledMode;
+    if (config.redSlot) ledMode = config.ambientSlot ? 3 : 2;
+
+    particleSensor.setup(config.ledBrightness, config.sampleAverage, ledMode,
+                         config.sampleRate, config.pulseWidth, config.adcRange);  // Configure sensor with these settings
+
+    particleSensor.setPulseAmplitudeRed(config.redSlot ? config.ledBrightness : 0);
+    particleSensor.setPulseAmplitudeGreen(0);
+
+    particleSensor.disableSlots();
+    if (config.redSlot) {
+        particleSensor.enableSlot(1, 0x01);  // SLOT_RED_LED = 0x01
+        particleSensor.enableSlot(2, 0x02);  // SLOT_IR_LED = 0x02
+        if (config.ambientSlot) {
+            particleSensor.enableSlot(3, 0x03);  // SLOT_GREEN_LED = 0x03, at zero current: dark
+        }
+    } else {
+        if (config.ambientSlot) {
+            // The Red LED at zero current converts ambient light only. Two
+            // slots also match the two words per sample the library reads
+            // in ledMode 2, Red (here: dark) first.
+            particleSensor.enableSlot(1, 0x01);  // SLOT_RED_LED = 0x01
+        }
+        particleSensor.enableSlot(2, 0x02);  // SLOT_IR_LED = 0x02
+    }
+    ambientSlot = config.ambientSlot;
+    redSlot = config.redSlot;
+}
+
+void Max30105Sensor::setRange(uint8_t ledAmplitude, int adcRange) {
+    I2cBusLock lock(bus, true);
+    // ADC_RGE bits of SPO2_CONFIG; the library keeps its constants private
+    uint8_t adcBits = 0x60;
+    if (adcRange < 4096) adcBits = 0x00;
+    else if (adcRange < 8192) adcBits = 0x20;
+    else if (adcRange < 16384) adcBits = 0x40;
+
+    particleSensor.setPulseAmplitudeIR(ledAmplitude);
+    if (redSlot) particleSensor.setPulseAmplitudeRed(ledAmplitude);
+    particleSensor.setADCRange(adcBits);
+    particleSensor.clearFIFO();
+}
+
+// check() pulls every new FIFO sample in one I2C burst; the library then
+// hands them out one by one through available()/nextSample()
+uint8_t Max30105Sensor::readSamples(SensorSample *out, uint8_t maxCount, uint32_t now) {
+    I2cBusLock lock(bus, true);
+    if (interruptEnabled) {
+        particleSensor.getINT1();  // Reading the status releases INT before the FIFO is drained
+    }
+
+    // OVF_COUNTER: samples the full FIFO overwrote since the read pointer
+    // last moved (saturates at 31); the drain below resets it
+    const uint8_t overflowCounter = 0x05;
+    uint8_t lost = particleSensor.readRegister8(MAX30105_ADDRESS, overflowCounter) & 0x1F;
+    if (lost > 0) {
+        fifo.overflows++;
+        fifo.samplesLost += lost;
+    }
+    if (particleSensor.check() == 0) return 0;
+
+    uint8_t count = 0;
+    while (particleSensor.available()) {
+        if (count < maxCount) {
+            out[count].timestamp = now;
+            out[count].ir = particleSensor.getFIFOIR();
+            out[count].red = redSlot ? particleSensor.getFIFORed() : 0;
+            out[count].ambient = 0;
+            if (ambientSlot) {
+                out[count].ambient = redSlot ? particleSensor.getFIFOGreen() : particleSensor.getFIFORed();
+            }
+            count++;
+        }
+        particleSensor.nextSample();
+    }
+    return count;
+}
+
+void Max30105Sensor::clearFifo() {
+    I2cBusLock lock(bus, true);
+    particleSensor.clearFIFO();
+}
+
+// Polls the conversion with the bus held; only the warm-up screen, which
+// changes once a second, waits behind it
+float Max30105Sensor::readTemperature() {
+    I2cBusLock lock(bus, true);
+    return particleSensor.readTemperature();
+}
+
+void Max30105Sensor::enableInterrupt(uint8_t samplesPerInterrupt) {
+    I2cBusLock lock(bus, true);
+    if (samplesPerInterrupt <= 1) {
+        particleSensor.enableDATARDY();
+    } else {
+        // FIFO_A_FULL counts the free slots left when INT fires (0..15)
+        particleSensor.setFIFOAlmostFull(32 - samplesPerInterrupt);
+        particleSensor.enableAFULL();
+    }
+    interruptEnabled = true;
+}
+
+// In proximity mode the part pulses only the IR LED, at the pilot
+// amplitude, and starts its configured slots once PROX_INT fires
+void Max30105Sensor::armProximityWake(uint8_t pilotAmplitude, uint8_t threshold) {
+    I2cBusLock lock(bus, true);
+    particleSensor.disableDATARDY();
+    particleSensor.disableAFULL();
+    particleSensor.setPulseAmplitudeProximity(pilotAmplitude);
+    particleSensor.setProximityThreshold(threshold);
+    particleSensor.enablePROXINT();
+    particleSensor.getINT1();  // Release INT from an earlier data interrupt
+    // Writing MODE_CONFIG, even unchanged, (re)enters proximity mode; the
+    // library keeps its register map private
+    const uint8_t modeConfig = 0x09;
+    particleSensor.writeRegister8(MAX30105_ADDRESS, modeConfig,
+                                  particleSensor.readRegister8(MAX30105_ADDRESS, modeConfig));
+    interruptEnabled = false;
+}
+
+SensorFifoStats Max30105Sensor::fifoStats() const {
+    return fifo;
+}
+
+// -- End Sensor --
+
+// -- Display --
+
+static const char* getWarmupFace(int secondsLeft) {
+    if (secondsLeft > 45) return "(-.-)zzZ";  // sleeping
+    if (secondsLeft > 30) return "(-.-)z";    // drowsy
+    if (secondsLeft > 15) return "(o.o)";     // waking
+    if (secondsLeft > 5)  return "(^.^)";     // alert
+    return "(^o^)/";                           // ready!
+}
+
+// Data bytes per I2C transaction after the 0x40 control byte
+#ifdef I2C_BUFFER_LENGTH
+#define OLED_WIRE_CHUNK (I2C_BUFFER_LENGTH - 1)
+#else
+#define OLED_WIRE_CHUNK 31
+#endif
+
+// Point the SSD1306 at one page / column window and stream the span into
+// it; context is the I2cBus, held for this one page
+static uint16_t writeOledSpan(uint8_t page, uint8_t firstColumn,
+                              const uint8_t *data, uint8_t length, void *context) {
+    I2cBusLock lock(*(I2cBus *)context, false);
+    uint8_t column = firstColumn + DISPLAY_COLUMN_OFFSET;
+
+    Wire.beginTransmission(I2C_ADDRESS_OLED);
+    Wire.write((uint8_t)0x00);  // Command stream
+    Wire.write((uint8_t)SSD1306_PAGEADDR);
+    Wire.write(page);
+    Wire.write(page);
+    Wire.write((uint8_t)SSD1306_COLUMNADDR);
+    Wire.write(column);
+    Wire.write((uint8_t)(column + length - 1));
+    Wire.endTransmission();
+    uint16_t sent = 7;
+
+    while (length > 0) {
+        uint8_t chunk = length < OLED_WIRE_CHUNK ? length : OLED_WIRE_CHUNK;
+        Wire.beginTransmission(I2C_ADDRESS_OLED);
+        Wire.write((uint8_t)0x40);  // Data stream
+        Wire.write(data, chunk);
+        Wire.endTransmission();
+        sent += 1 + chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return sent;
+}
+
+Ssd1306Display::Ssd1306Display(I2cBus &bus)
+    : bus(bus), oled(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET), oledAvailable(false) {
+    memset(&shadow, 0, sizeof(shadow));
+}
+
+bool Ssd1306Display::begin() {
+    {
+        I2cBusLock lock(bus, false);
+        oledAvailable = oled.begin(SSD1306_SWITCHCAPVCC, I2C_ADDRESS_OLED);
+    }
+    if (oledAvailable) {
+        oled.clearDisplay();
+        oled.setTextSize(1);
+        oled.setTextColor(WHITE);
+    }
+    oledShadowReset(&shadow);  // Panel RAM is unknown after init
+    return oledAvailable;
+}
+
+// Replaces oled.display(): only changed page spans go over the bus, each
+// under its own bus lock so sensor reads fit between them
+void Ssd1306Display::pushFrame() {
+    oledSyncFrame(&shadow, oled.getBuffer(), writeOledSpan, &bus);
+}
+
+uint32_t Ssd1306Display::bytesSent() const {
+    return shadow.bytesSent;
+}
+
+void Ssd1306Display::showStatus(const char *line1, const char *line2) {
+    if (!oledAvailable) return;
+
+    oled.clearDisplay();
+    oled.setTextSize(1);
+    oled.setCursor(0, 0);
+    oled.println(line1);
+    if (line2) {
+        oled.println(line2);
+    }
+    pushFrame();
+}
+
+void Ssd1306Display::showStartUp(const char *revision) {
+    if (!oledAvailable) {
+        Serial.println("Display: Roast Meter " + String(revision));
+        return;
+    }
+
+    oled.clearDisplay();
+#if SCREEN_HEIGHT <= 48
+    oled.setCursor(4, 12 + DISPLAY_Y_OFFSET);
+    oled.print("Roast Meter");
+    oled.setCursor(20, 22 + DISPLAY_Y_OFFSET);
+    oled.print(revision);
+#else
+    oled.setCursor(0, 0);
+    oled.print("Roast  ");
+    oled.print("Meter  ");
+    oled.print(revision);
+#endif
+    pushFrame();
+}
+
+void Ssd1306Display::showWarmUp(int secondsLeft) {
+    if (!oledAvailable) {
+        Serial.printf("Warm Up %ds %s\n", secondsLeft, getWarmupFace(secondsLeft));
+        return;
+    }
+
+    oled.clearDisplay();
+
+#if SCREEN_HEIGHT <= 48
+    // 64x48 display
+    oled.setTextSize(1);
+    oled.setCursor(8, 8 + DISPLAY_Y_OFFSET);
+    oled.println(getWarmupFace(secondsLeft));
+    oled.println();
+    oled.printf(" Warm %ds", secondsLeft);
+#else
+    // 128x64 display
+    oled.setCursor(0, 8);
+    oled.setTextSize(2);
+    oled.println(getWarmupFace(secondsLeft));
+    oled.setTextSize(1);
+    oled.println();
+    oled.printf("  Warming up %ds", secondsLeft);
+#endif
+    pushFrame();
+}
+
+void Ssd1306Display::showReady() {
+    // Ready celebration screen
+    if (!oledAvailable) {
+        Serial.println("(^o^)/ Ready!");
+        return;
+    }
+
+    oled.clearDisplay();
+#if SCREEN_HEIGHT <= 48
+    oled.setTextSize(1);
+    oled.setCursor(12, 8 + DISPLAY_Y_OFFSET);
+    oled.println("(^o^)/");
+    oled.println();
+    oled.println(" Ready!");
+#else
+    oled.setTextSize(2);
+    oled.setCursor(20, 10);
+    oled.println("(^o^)/");
+    oled.setCursor(28, 35);
+    oled.println("Ready!");
+#endif
+    pushFrame();
+}
+
+void Ssd1306Display::showPleaseLoadSample() {
+    if (!oledAvailable) {
+        Serial.println("Display: Please load sample!");
+        return;
+    }
+
+    oled.clearDisplay();
+
+#if SCREEN_HEIGHT <= 48
+    // 64x48 (0.66" OLED)
+    // Text size 1 = 8px tall, 3 lines = 24px + spacing ~30px
+    // Center in 48px visible area, apply Y offset
+    oled.setTextSize(1);
+    oled.setCursor(4, 8 + DISPLAY_Y_OFFSET);
+    oled.println("Load");
+    oled.println("sample!");
+#else
+    // 128x64 (0.96" OLED)
+    oled.setCursor(0, 0);
+    oled.setTextSize(2);
+    oled.println("Please ");
+    oled.println("load ");
+    oled.println("sample! ");
+#endif
+
+    pushFrame();
+}
+
+void Ssd1306Display::drawCenterString(const char *text) {
+    int16_t x1, y1;
+    uint16_t w, h;
+    oled.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+    // Center horizontally and vertically
+    // y1 is negative offset from cursor to top of text
+    int x = (SCREEN_WIDTH - w) / 2 - x1;
+    int y = (SCREEN_HEIGHT - h) / 2 - y1;
+    oled.setCursor(x, y);
+    oled.print(text);
+}
+
+void Ssd1306Display::showMeasurement(int agtronLevel, bool locked) {
+    if (!oledAvailable) {
+        Serial.printf("Display: Agtron Level = %d%s\n", agtronLevel, locked ? " (locked)" : "");
+        return;
+    }
+
+    oled.clearDisplay();
+
+    // Runs for every measurement, so no String temporaries
+    char agtronLevelText[12];
+    snprintf(agtronLevelText, sizeof(agtronLevelText), "%d", agtronLevel);
+#if SCREEN_HEIGHT <= 48
+    // 64x48 (0.66" OLED)
+    oled.setTextSize(2);
+    // Size 2: 12px wide per char, 16px tall
+    int charWidth = 12;
+    int textWidth = strlen(agtronLevelText) * charWidth;
+    int xPos = (SCREEN_WIDTH - textWidth) / 2;
+    int yPos = (SCREEN_HEIGHT - 16) / 2 + DISPLAY_Y_OFFSET;
+    oled.setCursor(xPos > 0 ? xPos : 0, yPos);
+    oled.print(agtronLevelText);
+#elif SCREEN_WIDTH <= 64
+    // 64x64 - use size 2
+    oled.setTextSize(2);
+    drawCenterString(agtronLevelText);
+#else
+    // 128x64 (0.96" OLED)
+    oled.setTextSize(3);
+    drawCenterString(agtronLevelText);
+#endif
+
+    // Lock marker: small square in the top right corner of the visible area
+    if (locked) {
+        oled.fillRect(SCREEN_WIDTH - 5, 1 + DISPLAY_Y_OFFSET, 4, 4, WHITE);
+    }
+
+    pushFrame();
+}
+
+void Ssd1306Display::powerDown() {
+    if (!oledAvailable) return;
+    I2cBusLock lock(bus, false);
+    oled.ssd1306_command(SSD1306_DISPLAYOFF);
+}
+
+// -- End Display --
+
+// -- Preferences --
+
+bool PreferencesStore::begin(const char *name) {
+    return preferences.begin(name, false);
+}
+
+uint8_t PreferencesStore::getUChar(const char *key, uint8_t defaultValue) {
+    return preferences.getUChar(key, defaultValue);
+}
+
+bool PreferencesStore::putUChar(const char *key, uint8_t value) {
+    return preferences.putUChar(key, value) == sizeof(value);
+}
+
+int32_t PreferencesStore::getInt(const char *key, int32_t defaultValue) {
+    return preferences.getInt(key, defaultValue);
+}
+
+bool PreferencesStore::putInt(const char *key, int32_t value) {
+    return preferences.putInt(key, value) == sizeof(value);
+}
+
+float PreferencesStore::getFloat(const char *key, float defaultValue) {
+    return preferences.getFloat(key, defaultValue);
+}
+
+bool PreferencesStore::putFloat(const char *key, float value) {
+    return preferences.putFloat(key, value) == sizeof(value);
+}
+
+// -- End Preferences --
+
+// -- Log Storage --
+
+PartitionLogStorage::PartitionLogStorage(const char *label) : label(label), partition(NULL) {}
+
+bool PartitionLogStorage::mount() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return partition != NULL;
+}
+
+uint32_t PartitionLogStorage::size() {
+    return partition ? partition->size : 0;
+}
+
+bool PartitionLogStorage::read(uint32_t offset, void *data, size_t len) {
+    return esp_partition_read(partition, offset, data, len) == ESP_OK;
+}
+
+bool PartitionLogStorage::write(uint32_t offset, const void *data, size_t len) {
+    return esp_partition_write(partition, offset, data, len) == ESP_OK;
+}
+
+bool PartitionLogStorage::eraseSector(uint32_t offset) {
+    return esp_partition_erase_range(partition, offset, LOG_STORAGE_SECTOR_SIZE) == ESP_OK;
+}
+
+// -- End Log Storage --
+
+// -- Perf Counters --
+
+#if PERF_COUNTERS_ENABLED
+// CCOUNT on the S2, mcycle on the C3; counts CPU clocks, stops in light sleep
+uint32_t perfCycles() {
+    return ESP.getCycleCount();
+}
+#endif
+
+// -- End Perf Counters --
@@ -0,0 +1,89 @@
+#include "idle_sleep.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "crc32.h"
+
+// -- Idle timer --
+
+void idleTimerReset(IdleTimer *timer) {
+    timer->idleSince = 0;
+    timer->idle = false;
+}
+
+bool idleTimerUpdate(IdleTimer *timer, MeasureStatus status, uint32_t now) {
+    if (status != MEASURE_NO_SAMPLE) {
+        timer->idle = false;
+        return false;
+    }
+    if (!timer->idle) {
+        timer->idle = true;
+        timer->idleSince = now;
+    }
+    return now - timer->idleSince >= (uint32_t)IDLE_SLEEP_SECONDS * 1000;
+}
+
+uint8_t proximityThreshold(uint32_t unblocked) {
+    const uint32_t step = 1UL << PROXIMITY_THRESHOLD_SHIFT;
+    uint32_t threshold = (unblocked + PROXIMITY_WAKE_MARGIN + step - 1) >> PROXIMITY_THRESHOLD_SHIFT;
+    return threshold > 0xFF ? 0xFF : (uint8_t)threshold;
+}
+
+// -- End Idle timer --
+
+// -- Retained state --
+
+static uint32_t stateCrc(const RetainedState *state) {
+    return crc32(state, offsetof(RetainedState, crc));
+}
+
+void retainState(RetainedState *state, WarmupStatus warmup) {
+    uint32_t wakes = state->wakes;
+
+    // Padding too, so the CRC covers defined bytes only
+    memset(state, 0, sizeof(RetainedState));
+    state->magic = RETAINED_STATE_MAGIC;
+    state->ledBrightness = ledBrightness;
+    state->measureMode = (uint8_t)measureMode;
+    state->intersectionPoint = (int16_t)intersectionPoint;
+    state->deviation = deviation;
+    state->unblockedValue = unblockedValue;
+    memcpy(state->points, calibration.points, sizeof(state->points));
+    memcpy(state->ratioPoints, ratioCalibration.points, sizeof(state->ratioPoints));
+    state->pointCount = calibration.count;
+    state->ratioPointCount = ratioCalibration.count;
+    state->warmup = (uint8_t)warmup;
+    state->wakes = wakes;
+#if DEBUG_LOGGING_ENABLED
+    getLogPosition(&state->log);
+#endif
+    state->crc = stateCrc(state);
+}
+
+static void restoreCalibration(Calibration *cal, const CalPoint *points, uint8_t count) {
+    calibrationReset(cal);
+    for (uint8_t i = 0; i < count && i < CAL_MAX_POINTS; i++) {
+        calibrationAddPoint(cal, points[i].level, points[i].agtron);
+    }
+}
+
+bool resumeState(RetainedState *state) {
+    if (state->magic != RETAINED_STATE_MAGIC || state->crc != stateCrc(state)) return false;
+
+    ledBrightness = state->ledBrightness;
+    measureMode = state->measureMode == MEASURE_MODE_RATIO ? MEASURE_MODE_RATIO : MEASURE_MODE_IR;
+    intersectionPoint = state->intersectionPoint;
+    deviation = state->deviation;
+    deviationX1000 = (uint16_t)(deviation * 1000);
+    unblockedValue = state->unblockedValue;
+    // After the formula parameters, for a table without points
+    restoreCalibration(&calibration, state->points, state->pointCount);
+    restoreCalibration(&ratioCalibration, state->ratioPoints, state->ratioPointCount);
+
+    state->magic = 0;
+    state->wakes++;
+    return true;
+}
+
+// -- End Retained state --
@@ -0,0 +1,182 @@
+#include "log_codec.h"
+
+#include <string.h>
+
+// -- Varint helpers --
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t putVarint(uint8_t *out, uint32_t value) {
+    uint8_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool getVarint(const uint8_t *data, uint16_t length, uint16_t *pos, uint32_t *value) {
+    uint32_t result = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (*pos >= length) return false;
+        uint8_t byte = data[(*pos)++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -- End Varint helpers --
+
+// -- Encoder --
+
+void logEncoderReset(LogEncoder *encoder) {
+    memset(&encoder->previous, 0, sizeof(LogEntry));
+    encoder->settingsPending = true;
+}
+
+static bool settingsDiffer(const LogEntry &a, const LogEntry &b) {
+    return a.ledBrightness != b.ledBrightness ||
+           a.intersectPt != b.intersectPt ||
+           a.deviationX1000 != b.deviationX1000 ||
+           a.flags != b.flags;
+}
+
+uint8_t logEncodeEntry(LogEncoder *encoder, const LogEntry &entry, uint8_t *out) {
+    LogEntry &previous = encoder->previous;
+    uint8_t n = 0;
+
+    if (entry.flags & LOG_FLAG_WARMUP) {
+        out[n++] = LOG_TAG_WARMUP;
+        n += putVarint(out + n, entry.timestamp);
+        n += putVarint(out + n, entry.rawIR);
+        out[n++] = (uint8_t)entry.agtron;
+        return n;
+    }
+
+    if (encoder->settingsPending || settingsDiffer(entry, previous)) {
+        out[n++] = LOG_TAG_SETTINGS;
+        out[n++] = entry.ledBrightness;
+        out[n++] = entry.intersectPt;
+        n += putVarint(out + n, entry.deviationX1000);
+        n += putVarint(out + n, entry.flags);
+
+        memset(&previous, 0, sizeof(LogEntry));
+        previous.ledBrightness = entry.ledBrightness;
+        previous.intersectPt = entry.intersectPt;
+        previous.deviationX1000 = entry.deviationX1000;
+        previous.flags = entry.flags;
+        encoder->settingsPending = false;
+    }
+
+    uint32_t agtronDelta = zigzag((int32_t)entry.agtron - (int32_t)previous.agtron);
+    if (agtronDelta < LOG_TAG_SAMPLE_ESCAPE) {
+        out[n++] = (uint8_t)agtronDelta;
+    } else {
+        out[n++] = LOG_TAG_SAMPLE_ESCAPE;
+        n += putVarint(out + n, agtronDelta);
+    }
+    n += putVarint(out + n, entry.timestamp - previous.timestamp);
+    n += putVarint(out + n, zigzag((int32_t)(entry.rawIR - previous.rawIR)));
+
+    previous.timestamp = entry.timestamp;
+    previous.rawIR = entry.rawIR;
+    previous.agtron = entry.agtron;
+    return n;
+}
+
+uint8_t logEncodeSession(uint32_t session, uint8_t *out) {
+    out[0] = LOG_TAG_SESSION;
+    return 1 + putVarint(out + 1, session);
+}
+
+// -- End Encoder --
+
+// -- Decoder --
+
+void logDecoderReset(LogDecoder *decoder, uint32_t session) {
+    memset(&decoder->current, 0, sizeof(LogEntry));
+    decoder->session = session;
+}
+
+bool logDecodeBlock(LogDecoder *decoder, uint16_t version, const uint8_t *payload,
+                    uint16_t length, LogEntryVisitor visit, void *context) {
+    LogEntry &current = decoder->current;
+
+    if (version == LOG_VERSION_FIXED) {
+        if (length % sizeof(LogEntry) != 0) return false;
+        for (uint16_t pos = 0; pos < length; pos += sizeof(LogEntry)) {
+            memcpy(&current, payload + pos, sizeof(LogEntry));
+            visit(current, context);
+        }
+        return true;
+    }
+
+    if (version != LOG_VERSION_DELTA) return false;
+
+    uint16_t pos = 0;
+    while (pos < length) {
+        uint8_t tag = payload[pos++];
+        uint32_t value;
+
+        if (tag == LOG_TAG_SETTINGS) {
+            if (pos + 2 > length) return false;
+            LogEntry settings;
+            memset(&settings, 0, sizeof(LogEntry));
+            settings.ledBrightness = payload[pos++];
+            settings.intersectPt = payload[pos++];
+            if (!getVarint(payload, length, &pos, &value)) return false;
+            settings.deviationX1000 = (uint16_t)value;
+            if (!getVarint(payload, length, &pos, &value)) return false;
+            settings.flags = (uint16_t)value;
+            current = settings;
+            continue;
+        }
+        if (tag == LOG_TAG_WARMUP) {
+            LogEntry event = current;
+            if (!getVarint(payload, length, &pos, &value)) return false;
+            event.timestamp = value;
+            if (!getVarint(payload, length, &pos, &value)) return false;
+            event.rawIR = value;
+            if (pos >= length) return false;
+            event.agtron = payload[pos++];
+            event.flags = LOG_FLAG_WARMUP;
+            visit(event, context);
+            continue;
+        }
+        if (tag == LOG_TAG_SESSION) {
+            if (!getVarint(payload, length, &pos, &value)) return false;
+            decoder->session = value;
+            continue;
+        }
+        if (tag > LOG_TAG_SAMPLE_ESCAPE) {
+            return false;  // Unknown record type
+        }
+
+        uint32_t agtronDelta = tag;
+        if (tag == LOG_TAG_SAMPLE_ESCAPE && !getVarint(payload, length, &pos, &agtronDelta)) {
+            return false;
+        }
+        current.agtron = (int16_t)(current.agtron + unzigzag(agtronDelta));
+
+        if (!getVarint(payload, length, &pos, &value)) return false;
+        current.timestamp += value;
+        if (!getVarint(payload, length, &pos, &value)) return false;
+        current.rawIR += (uint32_t)unzigzag(value);
+
+        visit(current, context);
+    }
+    return true;
+}
+
+// -- End Decoder --
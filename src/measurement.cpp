@@ -0,0 +1,203 @@
+#include "measurement.h"
+
+#include "calibration.h"
+
+#include <math.h>
+
+// -- Global Setting --
+
+uint8_t ledBrightness = 95;
+int intersectionPoint = 117;
+float deviation = 0.165;
+uint16_t deviationX1000 = 165;
+uint32_t unblockedValue = 30000;
+volatile MeasureMode measureMode = MEASURE_MODE_IR;
+
+// -- End Global Setting --
+
+SampleQueue sampleQueue;
+AutoRange autoRange = { AUTO_RANGE_BASELINE };
+
+// Step and mode the sensor is set to; only touched by the acquisition task
+static uint8_t appliedRange = AUTO_RANGE_BASELINE;
+static MeasureMode sensorMode = MEASURE_MODE_IR;
+
+// Mode the filter holds samples of; only touched by the measurement side
+static MeasureMode filterMode = MEASURE_MODE_IR;
+
+// -- Acquisition --
+
+// Move every sample pending in the sensor FIFO into the sample queue.
+// The sensor port reads all new FIFO samples in one I2C burst, but the
+// library only stages a few of them, so the acquisition task calls this
+// far more often than the measurement tick. A new gain step is applied
+// right after a read, so hardly any sample is lost to the FIFO reset.
+void acquireSamples(SensorPort &sensor, uint32_t now) {
+    SensorSample fresh[SAMPLE_QUEUE_SIZE];
+    uint8_t count = sensor.readSamples(fresh, SAMPLE_QUEUE_SIZE, now);
+
+    for (uint8_t i = 0; i < count; i++) {
+        fresh[i].range = appliedRange;
+        fresh[i].mode = sensorMode;
+        sampleQueue.push(fresh[i]);  // Counts a drop when measurement fell behind
+    }
+
+    uint8_t requested = autoRange.step;  // Single byte written by the measurement side
+    if (requested != appliedRange) {
+        sensor.setRange(autoRangeLedAmplitude(requested, ledBrightness), autoRangeAdcRange(requested));
+        appliedRange = requested;
+    }
+}
+
+void sensorConfigured(MeasureMode mode) {
+    sensorMode = mode;
+    appliedRange = AUTO_RANGE_BASELINE;
+}
+
+bool sensorModeStale() {
+    return measureMode != sensorMode;
+}
+
+uint8_t drainSampleQueue(SensorSample *batch, uint8_t maxCount) {
+    uint8_t count = 0;
+    while (count < maxCount && sampleQueue.pop(&batch[count])) {
+        count++;
+    }
+    return count;
+}
+
+void resetSampleQueue() {
+    sampleQueue.clear();
+}
+
+// -- End Acquisition --
+
+// -- Measurement --
+
+#define RATIO_LEVEL_CEILING ((uint32_t)(SCALED_LEVEL_MAX + 1) * 1000)  // Maps to MEASURE_SCALED_TOO_HIGH
+
+uint32_t sampleLevel(const SensorSample &sample) {
+    uint32_t ir = ambientCorrectedIR(sample);
+    if (ir == 0 || ir > IR_READING_MAX) return 0;  // Check for invalid readings
+    if (sample.mode != MEASURE_MODE_RATIO) return autoRangeNormalize(ir, sample.range, ledBrightness);
+
+    // Both slots share LED amplitude and ADC range, so the ratio needs no scaling
+    uint32_t red = sample.red > sample.ambient ? sample.red - sample.ambient : 0;
+    uint64_t level = (uint64_t)red * RATIO_SCALE / ir;
+    return level < RATIO_LEVEL_CEILING ? (uint32_t)level : RATIO_LEVEL_CEILING;
+}
+
+MeasureResult evaluateSampleBatch(ReadingFilter *filter, const SensorSample *batch, uint8_t count) {
+    MeasureResult result;
+    result.status = MEASURE_INVALID_READING;
+    result.rLevel = 0;
+    result.rawLevel = 0;
+    result.timestamp = count > 0 ? batch[count - 1].timestamp : 0;
+    result.agtron = 0;
+    result.stable = false;
+    result.range = count > 0 ? batch[count - 1].range : autoRange.step;
+    result.mode = measureMode;
+
+    if (result.mode != filterMode) {
+        readingFilterReset(filter);  // IR and ratio levels do not mix
+        filterMode = result.mode;
+    }
+
+    ReadingStats stats = ReadingStats();
+    uint64_t levelSum = 0;
+    uint64_t irSum = 0;
+    uint8_t validCount = 0;
+    uint64_t stepSum = 0;      // Raw counts of the samples taken at the current step
+    uint8_t stepCount = 0;
+    bool saturated = false;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const SensorSample &sample = batch[i];
+        if (sample.mode != result.mode) continue;  // Taken before a mode switch
+
+        if (sample.range == autoRange.step) {
+            // The ADC range has to hold every lit slot, ambient light included
+            uint32_t peak = sample.red > sample.ir ? sample.red : sample.ir;
+            stepSum += peak;
+            stepCount++;
+            if (peak >= AUTO_RANGE_FULL_SCALE) saturated = true;
+        }
+
+        uint32_t level = sampleLevel(sample);
+        if (level == 0) {
+            result.rLevel = ambientCorrectedIR(sample);
+            continue;
+        }
+        stats = readingFilterAdd(filter, level);
+        levelSum += level;
+        irSum += result.mode == MEASURE_MODE_IR
+                     ? level
+                     : autoRangeNormalize(ambientCorrectedIR(sample), sample.range, ledBrightness);
+        validCount++;
+    }
+
+    if (validCount == 0) {
+        return result;
+    }
+
+    result.rawLevel = (uint32_t)(levelSum / validCount);
+
+    // Presence goes by the unfiltered batch so taking the sample out is
+    // seen at once, not after the window has caught up; in ratio mode too
+    // it is the IR level that rises when a cup is loaded
+    long currentDelta = (long)(irSum / validCount) - (long)unblockedValue;
+
+    if (currentDelta <= (long)SAMPLE_PRESENT_DELTA) {
+        readingFilterReset(filter);
+        autoRangeReset(&autoRange);  // The next cup starts at the calibration configuration
+        result.rLevel = result.rawLevel;
+        result.status = MEASURE_NO_SAMPLE;
+        return result;
+    }
+
+    result.rLevel = stats.value;
+    result.stable = stats.stable;
+
+    // Samples taken at the old step have a worse signal to noise ratio (or
+    // were clipped); let the window fill with ones from the new step
+    if (stepCount > 0 && autoRangeUpdate(&autoRange, (uint32_t)(stepSum / stepCount), saturated)) {
+        readingFilterReset(filter);
+        result.stable = false;
+    }
+
+    // Convert to the smaller scale the calibration table is indexed by
+    uint32_t scaledLevel = result.rLevel / 1000;
+    if (scaledLevel > SCALED_LEVEL_MAX) {  // Sanity check for scaled value
+        result.status = MEASURE_SCALED_TOO_HIGH;
+        return result;
+    }
+
+    result.agtron = calibrationLookup(calibrationFor(result.mode), scaledLevel);
+    if (result.agtron < AGTRON_MIN || result.agtron > AGTRON_MAX) {
+        result.status = MEASURE_AGTRON_OUT_OF_RANGE;
+        return result;
+    }
+
+    result.status = MEASURE_OK;
+    return result;
+}
+
+// Float, but only evaluated while the calibration table is built; the
+// per-sample path reads the table (see calibration.h)
+int mapIRToAgtron(uint32_t x) {
+    // Convert to int for calculation (x is already scaled down by /1000)
+    int scaledX = (int)x;
+    // Use float for intermediate calculations to avoid overflow
+    float result = scaledX - (intersectionPoint - scaledX) * deviation;
+    return round(result);
+    //return round(intersectionPoint - (x - intersectionPoint) * deviation);
+}
+
+// Straight line through the default ratio points of docs/dev-guide-v0.3.md
+// (ratio 0.45 -> 35 ... 0.85 -> 95); integer, rounded half away from zero
+int mapRatioToAgtron(uint32_t x) {
+    int32_t scaled = 3 * (int32_t)x - 650;  // Agtron * 20
+    return scaled >= 0 ? (scaled + 10) / 20 : (scaled - 10) / 20;
+}
+
+// -- End Measurement --
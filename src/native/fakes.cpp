@@ -0,0 +1,243 @@
+#include "fakes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "auto_range.h"
+#include "perf_counters.h"
+
+// -- ScriptedSensor --
+
+ScriptedSensor::ScriptedSensor(const std::vector<uint32_t> &script, uint32_t sampleIntervalMs)
+    : readCalls(0), interruptSamples(0), temperature(25.0f), adcNoise(0), rangeChanges(0), wakeThreshold(0), script(script),
+      sampleIntervalMs(sampleIntervalMs), next(0), ledAmplitude(0), adcRange(0), noiseState(1) {
+    memset(&config, 0, sizeof(config));
+    memset(&fifo, 0, sizeof(fifo));
+}
+
+void ScriptedSensor::configure(const SensorConfig &config) {
+    this->config = config;
+    ledAmplitude = config.ledBrightness;
+    adcRange = config.adcRange;
+    wakeThreshold = 0;
+}
+
+void ScriptedSensor::armProximityWake(uint8_t pilotAmplitude, uint8_t threshold) {
+    (void)pilotAmplitude;
+    interruptSamples = 0;
+    wakeThreshold = threshold;
+}
+
+void ScriptedSensor::setRange(uint8_t ledAmplitude, int adcRange) {
+    // Samples still pending were taken at the old values on real hardware;
+    // the acquisition side reads right before changing, so none are here
+    this->ledAmplitude = ledAmplitude;
+    this->adcRange = adcRange;
+    rangeChanges++;
+}
+
+uint8_t ScriptedSensor::readSamples(SensorSample *out, uint8_t maxCount, uint32_t now) {
+    readCalls++;
+
+    // The FIFO rolls over: only the newest SENSOR_FIFO_DEPTH samples survive
+    size_t produced = std::min<size_t>(script.size(), now / sampleIntervalMs + 1);
+    if (produced > next + SENSOR_FIFO_DEPTH) {
+        fifo.overflows++;
+        fifo.samplesLost += produced - SENSOR_FIFO_DEPTH - next;
+        next = produced - SENSOR_FIFO_DEPTH;
+    }
+
+    uint8_t count = 0;
+    while (next < script.size() && next * sampleIntervalMs <= now) {
+        if (count < maxCount) {
+            uint32_t leak = next < ambient.size() ? ambient[next] : 0;
+            out[count].timestamp = now;
+            out[count].ir = script[next] + leak;
+            out[count].ambient = 0;
+            out[count].red = 0;
+            if (config.ledBrightness != 0 && adcRange != 0) {
+                out[count].ir = convert(script[next], leak);
+                if (config.ambientSlot) out[count].ambient = convert(0, leak);
+                if (config.redSlot) out[count].red = convert(next < red.size() ? red[next] : 0, leak);
+            }
+            count++;
+        }
+        next++;
+    }
+    return count;
+}
+
+// What the converter reports for a script value plus ambient light leak
+// at the current range
+uint32_t ScriptedSensor::convert(uint32_t value, uint32_t leak) {
+    int64_t ir = (int64_t)value * ledAmplitude * config.adcRange / ((int64_t)config.ledBrightness * adcRange) +
+                 (int64_t)leak * config.adcRange / adcRange;
+    if (adcNoise != 0) {
+        noiseState = noiseState * 1103515245u + 12345u;
+        ir += (int64_t)((noiseState >> 8) % (2 * adcNoise + 1)) - adcNoise;
+    }
+    if (ir < 0) return 0;
+    return ir < AUTO_RANGE_FULL_SCALE ? (uint32_t)ir : AUTO_RANGE_FULL_SCALE;
+}
+
+void ScriptedSensor::clearFifo() {
+    // Drop everything "produced" so far; the script time base is absolute
+    next = script.size();
+}
+
+// -- FramebufferDisplay --
+
+FramebufferDisplay::FramebufferDisplay() : framesPushed(0), lastAgtron(-1), lastLocked(false), poweredDown(false) {
+    memset(lines, 0, sizeof(lines));
+}
+
+void FramebufferDisplay::push(const char *line1, const char *line2) {
+    memset(lines, 0, sizeof(lines));
+    snprintf(lines[0], COLS, "%s", line1);
+    if (line2) {
+        snprintf(lines[1], COLS, "%s", line2);
+    }
+    framesPushed++;
+}
+
+void FramebufferDisplay::showStatus(const char *line1, const char *line2) {
+    push(line1, line2);
+}
+
+void FramebufferDisplay::showStartUp(const char *revision) {
+    push("Roast Meter", revision);
+}
+
+void FramebufferDisplay::showWarmUp(int secondsLeft) {
+    char text[COLS];
+    snprintf(text, sizeof(text), "Warming up %ds", secondsLeft);
+    push(text, NULL);
+}
+
+void FramebufferDisplay::showReady() {
+    push("Ready!", NULL);
+}
+
+void FramebufferDisplay::showPleaseLoadSample() {
+    push("Please load sample!", NULL);
+}
+
+void FramebufferDisplay::showMeasurement(int agtronLevel, bool locked) {
+    char text[COLS];
+    snprintf(text, sizeof(text), "%d", agtronLevel);
+    push(text, locked ? "locked" : NULL);
+    lastAgtron = agtronLevel;
+    lastLocked = locked;
+}
+
+// -- MemoryStore --
+
+bool MemoryStore::begin(const char *name) {
+    prefix = std::string(name) + "/";
+    return true;
+}
+
+bool MemoryStore::get(const char *key, void *value, size_t len) {
+    std::map<std::string, std::vector<uint8_t> >::const_iterator it = values.find(prefix + key);
+    if (it == values.end() || it->second.size() != len) return false;
+    memcpy(value, it->second.data(), len);
+    return true;
+}
+
+bool MemoryStore::put(const char *key, const void *value, size_t len) {
+    const uint8_t *bytes = (const uint8_t*)value;
+    values[prefix + key].assign(bytes, bytes + len);
+    return true;
+}
+
+uint8_t MemoryStore::getUChar(const char *key, uint8_t defaultValue) {
+    uint8_t value;
+    return get(key, &value, sizeof(value)) ? value : defaultValue;
+}
+
+bool MemoryStore::putUChar(const char *key, uint8_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+int32_t MemoryStore::getInt(const char *key, int32_t defaultValue) {
+    int32_t value;
+    return get(key, &value, sizeof(value)) ? value : defaultValue;
+}
+
+bool MemoryStore::putInt(const char *key, int32_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+float MemoryStore::getFloat(const char *key, float defaultValue) {
+    float value;
+    return get(key, &value, sizeof(value)) ? value : defaultValue;
+}
+
+bool MemoryStore::putFloat(const char *key, float value) {
+    return put(key, &value, sizeof(value));
+}
+
+// -- RamFlashStorage --
+
+RamFlashStorage::RamFlashStorage(uint32_t capacity)
+    : data(capacity, 0xFF), sectorErases(capacity / LOG_STORAGE_SECTOR_SIZE, 0) {
+    resetCounters();
+}
+
+void RamFlashStorage::resetCounters() {
+    writeOps = 0;
+    bytesWritten = 0;
+    erases = 0;
+    readOps = 0;
+    bytesRead = 0;
+    programErrors = 0;
+    std::fill(sectorErases.begin(), sectorErases.end(), 0);
+}
+
+uint32_t RamFlashStorage::maxSectorErases() const {
+    return *std::max_element(sectorErases.begin(), sectorErases.end());
+}
+
+bool RamFlashStorage::read(uint32_t offset, void *out, size_t len) {
+    if (offset + len > data.size()) return false;
+    memcpy(out, &data[offset], len);
+    readOps++;
+    bytesRead += len;
+    return true;
+}
+
+bool RamFlashStorage::write(uint32_t offset, const void *in, size_t len) {
+    if (offset + len > data.size()) return false;
+
+    const uint8_t *bytes = (const uint8_t*)in;
+    for (size_t i = 0; i < len; i++) {
+        if (bytes[i] & ~data[offset + i]) programErrors++;
+        data[offset + i] &= bytes[i];
+    }
+    writeOps++;
+    bytesWritten += len;
+    return true;
+}
+
+bool RamFlashStorage::eraseSector(uint32_t offset) {
+    if (offset % LOG_STORAGE_SECTOR_SIZE != 0 || offset >= data.size()) return false;
+
+    memset(&data[offset], 0xFF, LOG_STORAGE_SECTOR_SIZE);
+    sectorErases[offset / LOG_STORAGE_SECTOR_SIZE]++;
+    erases++;
+    return true;
+}
+
+// -- Perf Counters --
+
+#if PERF_COUNTERS_ENABLED
+// Host stand-in for the cycle counter: one count per nanosecond, so
+// perfReset(1000) reports microseconds
+uint32_t perfCycles() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
@@ -0,0 +1,128 @@
+// Host-side fakes of the hardware abstraction layer (native env only)
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+
+// Replays a fixed IR sequence as if the sensor produced one FIFO sample
+// every sampleIntervalMs, starting at t = 0. Once configured, script
+// values are the readings at the configured LED brightness and ADC range:
+// setRange() scales them, then the ambient leak and converter noise of up
+// to adcNoise counts are added and the result clipped to full scale. The
+// Red slot, if configured, does the same with the red values, and the
+// dark slot sees the leak and noise alone. Like the part, it holds
+// SENSOR_FIFO_DEPTH samples: a read after longer than that loses the
+// oldest, counted exactly rather than saturating at 31.
+class ScriptedSensor : public SensorPort {
+public:
+    ScriptedSensor(const std::vector<uint32_t> &script, uint32_t sampleIntervalMs);
+
+    bool begin() override { return true; }
+    void configure(const SensorConfig &config) override;
+    void setRange(uint8_t ledAmplitude, int adcRange) override;
+    uint8_t readSamples(SensorSample *out, uint8_t maxCount, uint32_t now) override;
+    void clearFifo() override;
+    float readTemperature() override { return temperature; }
+    void enableInterrupt(uint8_t samplesPerInterrupt) override { interruptSamples = samplesPerInterrupt; }
+    void armProximityWake(uint8_t pilotAmplitude, uint8_t threshold) override;
+    SensorFifoStats fifoStats() const override { return fifo; }
+
+    bool finished() const { return next >= script.size(); }
+
+    SensorConfig config;
+    uint32_t readCalls;
+    uint8_t interruptSamples;  // 0 while polled
+    float temperature;         // Returned by readTemperature()
+    uint32_t adcNoise;         // Peak converter noise in counts, 0 by default
+    uint32_t rangeChanges;
+    uint8_t wakeThreshold;     // PROX_INT_THRESH while armed for the proximity wake, 0 otherwise
+    std::vector<uint32_t> ambient;  // Light leaking past the cup per script sample; empty: none
+    std::vector<uint32_t> red;      // Red slot reading per script sample
+
+private:
+    uint32_t convert(uint32_t value, uint32_t leak);
+
+    std::vector<uint32_t> script;
+    uint32_t sampleIntervalMs;
+    size_t next;
+    uint8_t ledAmplitude;
+    int adcRange;
+    uint32_t noiseState;
+    SensorFifoStats fifo;
+};
+
+// Text-mode framebuffer: keeps the lines of the last pushed screen
+class FramebufferDisplay : public DisplayPort {
+public:
+    static const int ROWS = 4;
+    static const int COLS = 22;
+
+    FramebufferDisplay();
+
+    bool begin() override { poweredDown = false; return true; }
+    void showStatus(const char *line1, const char *line2) override;
+    void showStartUp(const char *revision) override;
+    void showWarmUp(int secondsLeft) override;
+    void showReady() override;
+    void showPleaseLoadSample() override;
+    void showMeasurement(int agtronLevel, bool locked) override;
+    void powerDown() override { poweredDown = true; }
+
+    char lines[ROWS][COLS];
+    uint32_t framesPushed;
+    int lastAgtron;  // -1 until a measurement is shown
+    bool lastLocked;
+    bool poweredDown;
+
+private:
+    void push(const char *line1, const char *line2);
+};
+
+// In-memory key-value store standing in for NVS Preferences
+class MemoryStore : public KeyValueStore {
+public:
+    bool begin(const char *name) override;
+    uint8_t getUChar(const char *key, uint8_t defaultValue) override;
+    bool putUChar(const char *key, uint8_t value) override;
+    int32_t getInt(const char *key, int32_t defaultValue) override;
+    bool putInt(const char *key, int32_t value) override;
+    float getFloat(const char *key, float defaultValue) override;
+    bool putFloat(const char *key, float value) override;
+
+private:
+    bool get(const char *key, void *value, size_t len);
+    bool put(const char *key, const void *value, size_t len);
+
+    std::string prefix;
+    std::map<std::string, std::vector<uint8_t> > values;
+};
+
+// RAM-backed NOR flash that counts every operation reaching "flash"
+class RamFlashStorage : public LogStorage {
+public:
+    explicit RamFlashStorage(uint32_t capacity);
+
+    bool mount() override { return true; }
+    uint32_t size() override { return (uint32_t)data.size(); }
+    bool read(uint32_t offset, void *data, size_t len) override;
+    bool write(uint32_t offset, const void *data, size_t len) override;
+    bool eraseSector(uint32_t offset) override;
+
+    void resetCounters();
+    uint32_t maxSectorErases() const;
+
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> sectorErases;
+
+    uint32_t writeOps;
+    uint64_t bytesWritten;
+    uint32_t erases;
+    uint32_t readOps;
+    uint64_t bytesRead;
+    uint32_t programErrors;  // Writes that tried to turn a 0 bit back into 1
+};
@@ -0,0 +1,994 @@
+// Native host build of the measurement pipeline.
+//
+//   pio run -e native && .pio/build/native/program [sim|bench|stress|verify]
+//   .pio/build/native/program replay capture.csv...
+//
+// sim    - runs a scripted cup placement through acquisition, measurement,
+//          the display and the debug log, all backed by the fakes, after
+//          timing the adaptive warm-up on a cold and a warm device; then
+//          locks onto a noisy dark roast with and without auto ranging,
+//          measures under leaking room light with and without the dark slot,
+//          measures one coffee repacked in IR and in Red / IR ratio mode,
+//          reboots the log several times and looks sessions up, and lets
+//          the meter idle into deep sleep and wakes it with a cup
+// bench  - per-sample cost of the measurement pipeline, the reading filter
+//          and the calibration table, flash traffic per logged entry, and
+//          the overhead of one perf counter record
+// stress - hammers SpscQueue from a producer and a consumer std::thread
+//          and checks that nothing is reordered, torn or lost uncounted
+// verify - checks the integer measurement and log paths against the float
+//          expressions they replaced, over their whole input range, and
+//          the console parser against scripted input
+// replay - runs captures from tools/capture_log.py through the pipeline
+//          on their own clock and diffs the agtron values against the
+//          recorded ones (see replay.h)
+//
+// Left out of the unit test build (pio test -e native), whose runner in
+// test/ brings its own main().
+#ifndef PIO_UNIT_TESTING
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "calibration.h"
+#include "command_parser.h"
+#include "debug_log.h"
+#include "fakes.h"
+#include "idle_sleep.h"
+#include "measurement.h"
+#include "perf_counters.h"
+#include "replay.h"
+#include "settings.h"
+#include "sim.h"
+#include "spsc_queue.h"
+#include "telemetry.h"
+#include "warmup.h"
+
+#define SIM_FLASH_SIZE 0x100000     // Same as the logdata partition
+#define SIM_ADC_NOISE 2500          // Peak converter noise of the dark roast run, in counts
+
+// Deterministic noise so runs are comparable
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+    noiseState = noiseState * 1103515245u + 12345u;
+    return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Unblocked sensor, a cup placed for a while, then removed again
+static std::vector<uint32_t> cupPlacementScript() {
+    std::vector<uint32_t> script;
+    for (int i = 0; i < 25; i++) script.push_back(unblockedValue + noise(40));
+    for (int i = 0; i < 125; i++) script.push_back(121000 + noise(400));
+    for (int i = 0; i < 25; i++) script.push_back(unblockedValue + noise(40));
+    return script;
+}
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// LED output and die temperature settle exponentially from a cold start;
+// a warm device starts almost settled. Returns the warm-up time in ms.
+static uint32_t simulateWarmup(float irSag, float temperatureRise, WarmupStatus *status) {
+    WarmupTracker tracker;
+    warmupBegin(&tracker, 0);
+
+    for (uint32_t now = 0;; now += SIM_SAMPLE_INTERVAL_MS) {
+        float t = now / 1000.0f;
+        warmupAddSample(&tracker, (uint32_t)(unblockedValue * (1.0f - irSag * expf(-t / 10.0f))) + noise(5));
+        if (now % WARMUP_BUCKET_MS == 0) {
+            warmupAddTemperature(&tracker, 30.0f - temperatureRise * expf(-t / 15.0f));
+        }
+
+        *status = warmupUpdate(&tracker, now);
+        if (*status != WARMUP_RUNNING) return warmupElapsed(&tracker, now);
+    }
+}
+
+static void runWarmupSim() {
+    WarmupStatus status;
+    uint32_t cold = simulateWarmup(0.03f, 4.0f, &status);
+    printf("warm-up cold:   %u ms (%s)\n", cold, status == WARMUP_STABLE ? "stable" : "timeout");
+    uint32_t warm = simulateWarmup(0.0005f, 0.05f, &status);
+    printf("warm-up warm:   %u ms (%s)\n", warm, status == WARMUP_STABLE ? "stable" : "timeout");
+}
+
+#if DEBUG_LOGGING_ENABLED
+static uint32_t rangeVisited = 0;
+static uint32_t rangeErrors = 0;
+static void checkSessionEntry(const LogEntry &entry, uint32_t index) {
+    (void)index;
+    // Each boot logs timestamps 0, 100, 200, ...
+    if (entry.timestamp != rangeVisited * 100) rangeErrors++;
+    rangeVisited++;
+}
+
+static void printSession(const LogSessionInfo &info) {
+    printf("  session %u: entries %u..%u, %u pages from seq %u\n", info.session, info.firstEntry,
+           info.firstEntry + info.entries - 1, info.pages, info.firstSequence);
+}
+
+static uint32_t countedEntries = 0;
+static void countEntry(const LogEntry &, uint32_t) { countedEntries++; }
+
+// Boots with different amounts of logging, one of them none and one
+// large enough to wrap the ring, then reads back the last session
+static void runSessionSim() {
+    const uint32_t bootEntries[] = {30000, 20000, 500, 0, 200000, 1000};
+
+    RamFlashStorage flash(SIM_FLASH_SIZE);
+    for (size_t boot = 0; boot < sizeof(bootEntries) / sizeof(bootEntries[0]); boot++) {
+        setupDebugLog(flash);
+        for (uint32_t i = 0; i < bootEntries[boot]; i++) {
+            logMeasurement(i * 100, 121000 + noise(400), 120, logMeasurementFlags(AUTO_RANGE_BASELINE, false));
+        }
+        flushLogBuffer();
+    }
+
+    printf("sessions after %u boots:\n", (unsigned)(sizeof(bootEntries) / sizeof(bootEntries[0])));
+    forEachLogSession(printSession);
+
+    flash.resetCounters();
+    LogSessionInfo last;
+    bool found = findLogSession(lastLogSession(), &last);
+    rangeVisited = 0;
+    if (found) forEachLogEntryInRange(last.firstEntry, last.entries, checkSessionEntry);
+    printf("  LOG DUMP LAST: session %u, %u entries, %u errors, %u flash reads\n",
+           last.session, rangeVisited, rangeErrors, flash.readOps);
+
+    flash.resetCounters();
+    countedEntries = 0;
+    forEachLogEntry(countEntry);
+    printf("  full LOG DUMP: %u entries, %u flash reads\n", countedEntries, flash.readOps);
+}
+
+#endif
+
+// A dark roast reflects little more than the bare window. Converter noise
+// is a fixed number of counts, so at the calibration configuration it is
+// a large share of the reading; the auto range steps the gain up and
+// scales back, and the reading settles on fewer samples.
+static void runAutoRangeSim() {
+    std::vector<uint32_t> script;
+    for (int i = 0; i < 150; i++) script.push_back(36000 + noise(100));
+
+    SensorConfig config = simSensorConfig(false, false);
+
+    // Fixed gain: the same samples straight into the filter
+    ScriptedSensor fixed(script, SIM_SAMPLE_INTERVAL_MS);
+    fixed.configure(config);
+    fixed.adcNoise = SIM_ADC_NOISE;
+    ReadingFilter filter;
+    readingFilterReset(&filter);
+    uint32_t fixedSamples = 0;
+    uint32_t fixedLevel = 0;
+    for (uint32_t now = 0; !fixed.finished() && fixedLevel == 0; now += SIM_LOOP_STEP_MS) {
+        SensorSample samples[SAMPLE_QUEUE_SIZE];
+        uint8_t count = fixed.readSamples(samples, SAMPLE_QUEUE_SIZE, now);
+        for (uint8_t i = 0; i < count && fixedLevel == 0; i++) {
+            ReadingStats stats = readingFilterAdd(&filter, samples[i].ir);
+            fixedSamples++;
+            if (stats.stable) fixedLevel = stats.value;
+        }
+    }
+
+    ScriptedSensor ranged(script, SIM_SAMPLE_INTERVAL_MS);
+    ranged.configure(config);
+    ranged.adcNoise = SIM_ADC_NOISE;
+    SimLoop loop;
+    simLoopBegin(&loop, ranged);
+    uint32_t rangedSamples = 0;
+    MeasureResult result = MeasureResult();
+    while (!result.stable && simLoopNext(&loop, &result)) {
+        rangedSamples += loop.batchCount;
+    }
+
+    printf("dark roast, converter noise +-%d counts:\n", SIM_ADC_NOISE);
+    if (fixedLevel != 0) {
+        printf("  fixed gain:   locked after %u samples, agtron %d\n", fixedSamples,
+               calibrationLookup(&calibration, fixedLevel / 1000));
+    } else {
+        printf("  fixed gain:   not locked after %u samples\n", fixedSamples);
+    }
+    if (result.stable) {
+        printf("  auto range:   step %u, locked after %u samples, agtron %d, %u range changes\n",
+               result.range, rangedSamples, result.agtron, ranged.rangeChanges);
+    } else {
+        printf("  auto range:   step %u, not locked after %u samples\n", result.range, rangedSamples);
+    }
+    autoRangeReset(&autoRange);
+}
+
+// One pass of the cup placement with ambient light leaking in; readings
+// while no cup is loaded and the lock time count against it
+static void runAmbientCase(const char *label, bool ambientSlot, const std::vector<uint32_t> &script,
+                           const std::vector<uint32_t> &leak) {
+    SensorConfig config = simSensorConfig(ambientSlot, false);
+
+    ScriptedSensor sensor(script, SIM_SAMPLE_INTERVAL_MS);
+    sensor.configure(config);
+    sensor.ambient = leak;
+
+    const uint32_t cupPlaced = 25 * SIM_SAMPLE_INTERVAL_MS;
+    const uint32_t cupRemoved = 150 * SIM_SAMPLE_INTERVAL_MS;
+    uint32_t phantom = 0;
+    uint32_t rejected = 0;
+    uint32_t firstStable = 0;
+    int agtron = -1;
+    SimLoop loop;
+    simLoopBegin(&loop, sensor);
+    MeasureResult result;
+    while (simLoopNext(&loop, &result)) {
+        bool loaded = result.timestamp >= cupPlaced && result.timestamp < cupRemoved;
+        if (result.status == MEASURE_OK) {
+            if (!loaded) phantom++;
+            if (loaded) agtron = result.agtron;
+            if (loaded && result.stable && firstStable == 0) firstStable = loop.now;
+        } else if (result.status != MEASURE_NO_SAMPLE) {
+            rejected++;
+        }
+    }
+
+    printf("  %-14s %u readings without a cup, %u rejected, ", label, phantom, rejected);
+    if (firstStable != 0) {
+        printf("locked %u ms after placement, agtron %d\n", firstStable - cupPlaced, agtron);
+    } else {
+        printf("never locked\n");
+    }
+}
+
+// Flickering room light leaks past the window: strongly while it is bare,
+// a little around the cup
+static void runAmbientSim() {
+    std::vector<uint32_t> leak;
+    for (int i = 0; i < 175; i++) {
+        bool loaded = i >= 25 && i < 150;
+        float flicker = sinf(i * 1.45f);  // Mains flicker aliased by the sample rate
+        leak.push_back(loaded ? (uint32_t)(1500 + 1200 * flicker) : (uint32_t)(4000 + 1500 * flicker));
+    }
+
+    std::vector<uint32_t> script = cupPlacementScript();
+    printf("ambient light leak:\n");
+    runAmbientCase("no dark slot:", false, script, leak);
+    runAmbientCase("dark slot:", true, script, leak);
+    autoRangeReset(&autoRange);
+}
+
+// The same coffee packed three times, each reflecting a little more or
+// less of both wavelengths. Returns the locked Agtron of one packing.
+static int measurePacking(MeasureMode mode, float packing) {
+    std::vector<uint32_t> script;
+    std::vector<uint32_t> red;
+    for (int i = 0; i < 60; i++) {
+        script.push_back((uint32_t)(121000 * packing) + noise(400));
+        red.push_back((uint32_t)(121000 * 0.65f * packing) + noise(300));
+    }
+
+    ScriptedSensor sensor(script, SIM_SAMPLE_INTERVAL_MS);
+    sensor.configure(simSensorConfig(false, mode == MEASURE_MODE_RATIO));
+    sensor.red = red;
+    measureMode = mode;
+    sensorConfigured(mode);
+
+    SimLoop loop;
+    simLoopBegin(&loop, sensor);
+    MeasureResult result;
+    while (simLoopNext(&loop, &result)) {
+        if (result.status == MEASURE_OK && result.stable) return result.agtron;
+    }
+    return -1;
+}
+
+static void runRatioSim() {
+    const float packings[] = {0.92f, 1.0f, 1.08f};
+
+    printf("one coffee packed 3 times (-8%%, 0, +8%% reflectance):\n");
+    for (int m = 0; m < 2; m++) {
+        MeasureMode mode = m == 0 ? MEASURE_MODE_IR : MEASURE_MODE_RATIO;
+        int low = AGTRON_MAX;
+        int high = AGTRON_MIN;
+        printf("  %-6s agtron", mode == MEASURE_MODE_IR ? "IR:" : "ratio:");
+        for (size_t i = 0; i < sizeof(packings) / sizeof(packings[0]); i++) {
+            int agtron = measurePacking(mode, packings[i]);
+            printf(" %d", agtron);
+            low = std::min(low, agtron);
+            high = std::max(high, agtron);
+        }
+        printf(" (spread %d)\n", high - low);
+    }
+
+    measureMode = MEASURE_MODE_IR;
+    sensorConfigured(MEASURE_MODE_IR);
+    autoRangeReset(&autoRange);
+}
+
+#if DEBUG_LOGGING_ENABLED
+// Scripted samples through the pipeline at the firmware's sample and
+// batch rates until the idle timer fires or the reading locks. Returns
+// the time of that event, 0 if the script ran out first.
+static uint32_t runUntil(ScriptedSensor &sensor, IdleTimer *idle, MeasureResult *last) {
+    SimLoop loop;
+    simLoopBegin(&loop, sensor);
+    while (simLoopNext(&loop, last)) {
+        if (last->status == MEASURE_OK) {
+            logMeasurement(last->timestamp, last->rawLevel, last->agtron,
+                           logMeasurementFlags(last->range, last->mode == MEASURE_MODE_RATIO));
+        }
+        if (idle != NULL && idleTimerUpdate(idle, last->status, loop.now)) return loop.now;
+        if (idle == NULL && last->status == MEASURE_OK && last->stable) return loop.now;
+    }
+    return 0;
+}
+
+// The meter idles into deep sleep and a cup wakes it. RAM is lost in
+// between; only the RetainedState, in RTC memory on the device, survives.
+static void runIdleSleepSim() {
+    MemoryStore store;
+    loadSettings(store);
+    calibrationAddPoint(&calibration, 60, 30);
+    calibrationAddPoint(&calibration, 140, 95);
+    static Calibration before;
+    before = calibration;
+
+    RamFlashStorage flash(SIM_FLASH_SIZE);
+    setupDebugLog(flash);
+    for (uint32_t i = 0; i < 500; i++) {
+        logMeasurement(i * 100, 121000 + noise(400), 120, logMeasurementFlags(AUTO_RANGE_BASELINE, false));
+    }
+    uint32_t sessionBefore = getLogStatus().session;
+
+    std::vector<uint32_t> bare;
+    uint32_t bareMax = 0;
+    for (uint32_t i = 0; i < IDLE_SLEEP_SECONDS * 1000 / SIM_SAMPLE_INTERVAL_MS + 50; i++) {
+        bare.push_back(unblockedValue + noise(40));
+        bareMax = std::max(bareMax, bare.back());
+    }
+    ScriptedSensor idleSensor(bare, SIM_SAMPLE_INTERVAL_MS);
+    idleSensor.configure(simSensorConfig(false, false));
+    IdleTimer idle;
+    idleTimerReset(&idle);
+    MeasureResult result = MeasureResult();
+    uint32_t sleepAt = runUntil(idleSensor, &idle, &result);
+
+    // Park and capture, as the acquisition and UI tasks do before sleeping
+    idleSensor.configure(simSensorConfig(false, false));
+    idleSensor.armProximityWake(ledBrightness, proximityThreshold(unblockedValue));
+    uint8_t threshold = idleSensor.wakeThreshold;
+    flushLogBuffer();
+    static RetainedState rtc;
+    memset(&rtc, 0, sizeof(rtc));
+    retainState(&rtc, WARMUP_STABLE);
+
+    // Deep sleep
+    ledBrightness = 0;
+    intersectionPoint = 0;
+    deviation = 0.0f;
+    unblockedValue = 0;
+    calibrationReset(&calibration);
+
+    flash.resetCounters();
+    bool resumed = resumeState(&rtc);
+    LogOpenStatus opened = resumeDebugLog(flash, rtc.log);
+    uint32_t resumeReads = flash.readOps;
+    bool sameTable = memcmp(calibration.table, before.table, sizeof(before.table)) == 0;
+
+    std::vector<uint32_t> cup;
+    for (int i = 0; i < 60; i++) cup.push_back(121000 + noise(400));
+    ScriptedSensor cupSensor(cup, SIM_SAMPLE_INTERVAL_MS);
+    cupSensor.configure(simSensorConfig(false, false));
+    uint32_t lockedAt = runUntil(cupSensor, NULL, &result);
+    flushLogBuffer();
+    LogStatus status = getLogStatus();
+
+    bool again = resumeState(&rtc);
+
+    flash.resetCounters();
+    setupDebugLog(flash);
+    uint32_t scanReads = flash.readOps;
+
+    printf("idle deep sleep after %u ms without a cup:\n", sleepAt);
+    printf("  wake threshold %u (%u counts), bare window up to %u, cup %u\n", threshold,
+           (uint32_t)threshold << PROXIMITY_THRESHOLD_SHIFT, bareMax, cup[0]);
+    printf("  resume %s, calibration table %s, log %s with %u flash reads (cold scan %u)\n",
+           resumed ? "ok" : "FAILED", sameTable ? "identical" : "DIFFERENT",
+           opened == LOG_OPEN_LOADED ? "continued" : "rescanned", resumeReads, scanReads);
+    printf("  cup locked %u ms after the wake, agtron %d, logged in session %u (before: %u), %u entries\n",
+           lockedAt, result.agtron, status.session, sessionBefore, status.storedEntries);
+    printf("  second resume from the same capture: %s\n", again ? "ACCEPTED" : "refused");
+
+    calibrationReset(&calibration);
+}
+#endif
+
+static int runSim() {
+    runWarmupSim();
+
+    MemoryStore store;
+    loadSettings(store);
+
+    ScriptedSensor sensor(cupPlacementScript(), SIM_SAMPLE_INTERVAL_MS);
+    FramebufferDisplay display;
+#if DEBUG_LOGGING_ENABLED
+    RamFlashStorage flash(SIM_FLASH_SIZE);
+    setupDebugLog(flash);
+#endif
+
+    uint32_t measured = 0;
+    uint32_t rejected = 0;
+    uint32_t firstReading = 0;
+    uint32_t firstStable = 0;
+
+    SimLoop loop;
+    simLoopBegin(&loop, sensor);
+    MeasureResult result;
+    while (simLoopNext(&loop, &result)) {
+        if (result.status == MEASURE_OK) {
+            display.showMeasurement(result.agtron, result.stable);
+#if DEBUG_LOGGING_ENABLED
+            logMeasurement(result.timestamp, result.rawLevel, result.agtron,
+                           logMeasurementFlags(result.range, result.mode == MEASURE_MODE_RATIO));
+#endif
+            if (measured++ == 0) firstReading = loop.now;
+            if (result.stable && firstStable == 0) firstStable = loop.now;
+        } else {
+            display.showPleaseLoadSample();
+            if (result.status != MEASURE_NO_SAMPLE) rejected++;
+        }
+    }
+#if DEBUG_LOGGING_ENABLED
+    flushLogBuffer();
+#endif
+
+    printf("samples:        %u\n", (unsigned)cupPlacementScript().size());
+    printf("sensor reads:   %u\n", sensor.readCalls);
+    printf("measurements:   %u\n", measured);
+    printf("rejected:       %u\n", rejected);
+    printf("dropped:        %u\n", sampleQueue.droppedCount());
+    printf("fifo overflows: %u (%u samples lost)\n", sensor.fifoStats().overflows, sensor.fifoStats().samplesLost);
+    printf("frames pushed:  %u\n", display.framesPushed);
+    printf("last agtron:    %d%s\n", display.lastAgtron, display.lastLocked ? " (locked)" : "");
+    printf("time to lock:   %u ms after the first reading\n", firstStable - firstReading);
+
+    runAutoRangeSim();
+    runAmbientSim();
+    runRatioSim();
+#if DEBUG_LOGGING_ENABLED
+    printf("log entries:    %u\n", getLogStatus().storedEntries);
+
+    runSessionSim();
+    runIdleSleepSim();
+#endif
+    return 0;
+}
+
+static int runBench() {
+    const uint32_t batches = 2000000;
+    const uint8_t batchSize = 4;
+
+    SensorSample batch[batchSize];
+    for (uint8_t i = 0; i < batchSize; i++) {
+        batch[i].timestamp = i;
+        batch[i].ir = 121000 + noise(400);
+        batch[i].range = AUTO_RANGE_BASELINE;
+    }
+
+    ReadingFilter filter;
+    readingFilterReset(&filter);
+    calibrationReset(&calibration);
+
+    volatile int sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t n = 0; n < batches; n++) {
+        batch[n % batchSize].ir ^= n & 0x3F;
+        sink += evaluateSampleBatch(&filter, batch, batchSize).agtron;
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    printf("evaluateSampleBatch: %.2f ns/sample (%u batches of %u)\n",
+           (double)elapsed / ((double)batches * batchSize), batches, batchSize);
+    return sink == 0x7FFFFFFF;
+}
+
+// Baseline for the reading filter: copy and sort the whole window per sample
+static uint32_t sortedWindowMedian(const uint32_t *window, uint8_t count) {
+    uint32_t sorted[READING_SAMPLES];
+    memcpy(sorted, window, count * sizeof(uint32_t));
+    std::sort(sorted, sorted + count);
+    return sorted[count / 2];
+}
+
+static void benchReadingFilter() {
+    const uint32_t samples = 10000000;
+
+    std::vector<uint32_t> input(4096);
+    for (size_t i = 0; i < input.size(); i++) input[i] = 121000 + noise(2000);
+
+    ReadingFilter filter;
+    readingFilterReset(&filter);
+    volatile uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t n = 0; n < samples; n++) {
+        sink += readingFilterAdd(&filter, input[n & 4095]).value;
+    }
+    uint64_t incremental = nowNs() - start;
+
+    uint32_t window[READING_SAMPLES];
+    start = nowNs();
+    for (uint32_t n = 0; n < samples; n++) {
+        window[n % READING_SAMPLES] = input[n & 4095];
+        sink += sortedWindowMedian(window, READING_SAMPLES);
+    }
+    uint64_t resorted = nowNs() - start;
+
+    printf("reading filter (window %d, trim %d):\n", READING_SAMPLES, READING_TRIM);
+    printf("  incremental median + trimmed stats: %.2f ns/sample\n", (double)incremental / samples);
+    printf("  sort-per-sample median only:        %.2f ns/sample\n", (double)resorted / samples);
+}
+
+// Baseline for the calibration table: binary search for the segment, then
+// interpolate with the same rounding as the table
+static int searchedAgtron(const Calibration *cal, int32_t level) {
+    uint8_t low = 0;
+    uint8_t high = cal->count - 2;  // Segment s joins points s and s + 1
+    while (low < high) {
+        uint8_t mid = (low + high + 1) / 2;
+        if (cal->points[mid].level < level) low = mid;
+        else high = mid - 1;
+    }
+
+    const CalPoint &a = cal->points[low];
+    const CalPoint &b = cal->points[low + 1];
+    int32_t span = (int32_t)b.level - a.level;
+    int32_t numerator = (level - a.level) * ((int32_t)b.agtron - a.agtron);
+    int32_t value = a.agtron + (numerator >= 0 ? (numerator + span / 2) / span : (numerator - span / 2) / span);
+    return std::min<int32_t>(INT16_MAX, std::max<int32_t>(INT16_MIN, value));
+}
+
+static void benchCalibration() {
+    const uint32_t lookups = 20000000;
+    const CalPoint reference[] = {{150, 20}, {60, 95}, {121, 45}, {90, 70}, {30, 140}, {200, 5}};
+    const uint8_t pointCount = sizeof(reference) / sizeof(reference[0]);
+
+    Calibration cal = Calibration();  // No formula pointer: mapIRToAgtron
+    calibrationReset(&cal);
+    uint32_t mismatches = 0;
+    for (uint32_t level = 0; level <= SCALED_LEVEL_MAX; level++) {
+        if (cal.table[level] != mapIRToAgtron(level)) mismatches++;
+    }
+
+    // Added out of order, so every incremental update path is taken;
+    // after each add the table must match the interpolator everywhere
+    for (uint8_t i = 0; i < pointCount; i++) {
+        calibrationAddPoint(&cal, reference[i].level, reference[i].agtron);
+        if (cal.count < 2) continue;
+        for (int32_t level = 0; level <= SCALED_LEVEL_MAX; level++) {
+            if (calibrationLookup(&cal, level) != searchedAgtron(&cal, level)) mismatches++;
+        }
+    }
+
+    std::vector<uint32_t> levels(4096);
+    for (size_t i = 0; i < levels.size(); i++) levels[i] = 121 + noise(80);
+
+    volatile int sink = 0;
+    uint64_t start = nowNs();
+    for (uint32_t n = 0; n < lookups; n++) sink += mapIRToAgtron(levels[n & 4095]);
+    uint64_t formula = nowNs() - start;
+
+    start = nowNs();
+    for (uint32_t n = 0; n < lookups; n++) sink += searchedAgtron(&cal, levels[n & 4095]);
+    uint64_t searched = nowNs() - start;
+
+    start = nowNs();
+    for (uint32_t n = 0; n < lookups; n++) sink += calibrationLookup(&cal, levels[n & 4095]);
+    uint64_t table = nowNs() - start;
+
+    const uint32_t rebuilds = 20000;
+    start = nowNs();
+    for (uint32_t n = 0; n < rebuilds; n++) calibrationRebuild(&cal);
+    uint64_t rebuild = nowNs() - start;
+
+    printf("calibration (%u points, %u-entry table, %u bytes):\n",
+           pointCount, CAL_TABLE_SIZE, (unsigned)sizeof(cal.table));
+    printf("  two-parameter float formula: %.2f ns/lookup\n", (double)formula / lookups);
+    printf("  binary search + interpolate: %.2f ns/lookup\n", (double)searched / lookups);
+    printf("  table lookup:                %.2f ns/lookup\n", (double)table / lookups);
+    printf("  full table rebuild:          %.1f us\n", (double)rebuild / rebuilds / 1000.0);
+    printf("  table mismatches:            %u\n", mismatches);
+}
+
+// Log dump deviation column: %.3f of a float against integer milli-units
+static void benchDeviationFormatting() {
+    const uint32_t rows = 2000000;
+    char text[16];
+    volatile int sink = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t n = 0; n < rows; n++) {
+        sink += snprintf(text, sizeof(text), "%.3f", (uint16_t)n / 1000.0f);
+    }
+    uint64_t floating = nowNs() - start;
+
+    start = nowNs();
+    for (uint32_t n = 0; n < rows; n++) {
+        uint16_t milli = (uint16_t)n;
+        sink += snprintf(text, sizeof(text), "%u.%03u", milli / 1000, milli % 1000);
+    }
+    uint64_t fixed = nowNs() - start;
+
+    printf("log dump deviation column:\n");
+    printf("  float %%.3f:          %.2f ns/row\n", (double)floating / rows);
+    printf("  integer milli-units: %.2f ns/row\n", (double)fixed / rows);
+}
+
+#if PERF_COUNTERS_ENABLED
+// What one instrumented stage adds to the hot path: two counter reads and
+// the record, on the host clock instead of CCOUNT
+static void benchPerfCounters() {
+    const uint32_t records = 5000000;
+    perfReset(1000);
+
+    uint64_t start = nowNs();
+    for (uint32_t n = 0; n < records; n++) perfEnd(PERF_STAGE_MEASURE, perfStart());
+    uint64_t elapsed = nowNs() - start;
+
+    start = nowNs();
+    for (uint32_t n = 0; n < records; n++) perfLoopMark(PERF_LOOP_UI, n * 100);
+    uint64_t marks = nowNs() - start;
+
+    const PerfStats *stats = perfStats(PERF_STAGE_MEASURE);
+    printf("perf counters:\n");
+    printf("  perfStart + perfEnd: %.2f ns/record (%u recorded)\n", (double)elapsed / records, stats->count);
+    printf("  perfLoopMark:        %.2f ns/mark (jitter %u us)\n", (double)marks / records,
+           perfStats(PERF_LOOP_UI)->maxUs - perfStats(PERF_LOOP_UI)->minUs);
+}
+#endif
+
+#if DEBUG_LOGGING_ENABLED
+// Flash traffic of the debug log, including an idle flush every 50 entries
+static void benchLogWrites() {
+    const uint32_t entries = 500000;  // Wraps the partition at least twice
+
+    RamFlashStorage flash(SIM_FLASH_SIZE);
+    setupDebugLog(flash);
+    flash.resetCounters();
+
+    for (uint32_t i = 0; i < entries; i++) {
+        logMeasurement(i * 100, 121000 + noise(400), 120, logMeasurementFlags(AUTO_RANGE_BASELINE, false));
+        if (i % 50 == 49) flushLogBuffer();
+    }
+    flushLogBuffer();
+
+    LogStatus status = getLogStatus();
+    printf("debug log (LOG_BUFFER_SIZE=%d):\n", LOG_BUFFER_SIZE);
+    printf("  bytes written/entry: %.2f\n", (double)flash.bytesWritten / entries);
+    printf("  write ops/entry:     %.3f\n", (double)flash.writeOps / entries);
+    printf("  sector erases:       %u (max %u per sector)\n", flash.erases, flash.maxSectorErases());
+    printf("  entries stored:      %u in %u pages\n", status.storedEntries, status.pagesUsed);
+    printf("  program errors:      %u\n", flash.programErrors);
+
+    // Reboot: recovery only needs the page headers plus the newest page
+    flash.resetCounters();
+    uint64_t start = nowNs();
+    setupDebugLog(flash);
+    printf("  recovery:            %u reads, %llu bytes, %.1f us, %u entries\n",
+           flash.readOps, (unsigned long long)flash.bytesRead,
+           (nowNs() - start) / 1000.0, getLogStatus().storedEntries);
+}
+
+#endif
+
+// The producer waits for space, except in every tenth stretch of 100k
+// items where it pushes blindly; the consumer sleeps now and then, so those
+// stretches run the queue full and exercise the drop counter
+static int runStress() {
+    const uint32_t items = 20000000;
+    static SpscQueue<SensorSample, SAMPLE_QUEUE_SIZE> queue;
+
+    std::atomic<bool> done(false);
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint64_t start = nowNs();
+
+    std::thread consumer([&]() {
+        uint32_t expected = 0;
+        uint32_t popped = 0;
+        SensorSample sample;
+        for (;;) {
+            if (!queue.pop(&sample)) {
+                if (!done.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // done is set after the last push, so an empty pop now means drained
+                if (!queue.pop(&sample)) break;
+            }
+            // Sequence numbers must increase (gaps are drops); ir checks for torn slots
+            if (sample.timestamp < expected || sample.ir != sample.timestamp * 2654435761u) errors++;
+            expected = sample.timestamp + 1;
+            received++;
+            if (++popped % 100000 == 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+
+    uint32_t failedPushes = 0;
+    SensorSample sample;
+    for (uint32_t i = 0; i < items; i++) {
+        bool lossy = (i / 100000) % 10 == 9;
+        while (!lossy && queue.depth() == queue.capacity()) std::this_thread::yield();
+
+        sample.timestamp = i;
+        sample.ir = i * 2654435761u;
+        if (!queue.push(sample)) failedPushes++;
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    uint64_t elapsed = nowNs() - start;
+
+    printf("spsc stress (%u items, queue of %u):\n", items, queue.capacity());
+    printf("  received:   %u\n", received);
+    printf("  dropped:    %u\n", queue.droppedCount());
+    printf("  high water: %u\n", queue.highWaterMark());
+    printf("  errors:     %u\n", errors);
+    printf("  %.1f ns/item\n", (double)elapsed / items);
+
+    bool ok = errors == 0 && failedPushes == queue.droppedCount() &&
+              received + queue.droppedCount() == items;
+    printf("  %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+// Console: lines fed byte by byte, dispatched against a small table
+static char lastCommand[32];
+static int32_t lastArgument;
+static void recordCommand(const char *name, const CommandArgs &args) {
+    snprintf(lastCommand, sizeof(lastCommand), "%s/%u", name, args.count);
+    if (!commandArgInt(args, 0, &lastArgument)) lastArgument = -1;
+}
+static void commandDump(const CommandArgs &args) { recordCommand("dump", args); }
+static void commandDumpBin(const CommandArgs &args) { recordCommand("bin", args); }
+static void commandCalAdd(const CommandArgs &args) { recordCommand("cal", args); }
+
+static uint32_t verifyCommandParser() {
+    static const CommandEntry table[] = {
+        {"LOG DUMP", "", commandDump},
+        {"LOG DUMP BIN", "[sequence]", commandDumpBin},
+        {"CAL ADD", "[level] <agtron>", commandCalAdd},
+    };
+    struct Case {
+        const char *input;
+        const char *command;   // Expected handler/argument count, "" if none
+        int32_t argument;
+    };
+    const Case cases[] = {
+        {"log dump\n", "dump/0", -1},
+        {"LOG DUMP BIN\r\n", "bin/0", -1},
+        {"  log   dump  bin 42 \n", "bin/1", 42},
+        {"cal add 121 -5\r", "cal/2", 121},
+        {"LOG DUMPS\n", "", 0},
+        {"\r\n\n", "", 0},
+        {"CAL ADD 0123456789012345678901234567890123456789012345678901234567890123\n", "", 0},
+    };
+
+    CommandLine line;
+    commandLineReset(&line);
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        lastCommand[0] = '\0';
+        lastArgument = 0;
+        for (const char *c = cases[i].input; *c; c++) {
+            if (commandLineFeed(&line, *c) == COMMAND_READY) {
+                dispatchCommand(table, sizeof(table) / sizeof(table[0]), line.buffer);
+            }
+        }
+        if (strcmp(lastCommand, cases[i].command) != 0 ||
+            (lastCommand[0] && lastArgument != cases[i].argument)) {
+            printf("  \"%s\": got %s (%d)\n", cases[i].input, lastCommand, lastArgument);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// The baseline firmware's mapIRToAgtron(), verbatim but for the settings
+// passed in: the reference the table and the whole per-sample path are
+// held to, independent of the formula calibrationReset() fills from
+static int baselineMapIRToAgtron(uint32_t x, int intersectionPoint, float deviation) {
+    // Convert to int for calculation (x is already scaled down by /1000)
+    int scaledX = (int)x;
+    // Use float for intermediate calculations to avoid overflow
+    float result = scaledX - (intersectionPoint - scaledX) * deviation;
+    return round(result);
+}
+
+// The baseline measureSampleJob() on one getIR() value
+static MeasureStatus baselineMeasure(uint32_t rLevel, int *agtron) {
+    if (rLevel == 0 || rLevel > 1000000) return MEASURE_INVALID_READING;
+    long currentDelta = (long)rLevel - (long)unblockedValue;
+    if (currentDelta <= (long)100) return MEASURE_NO_SAMPLE;
+    uint32_t scaledLevel = rLevel / 1000;
+    if (scaledLevel > 1000) return MEASURE_SCALED_TOO_HIGH;
+    *agtron = baselineMapIRToAgtron(scaledLevel, intersectionPoint, deviation);
+    if (*agtron < 0 || *agtron > 350) return MEASURE_AGTRON_OUT_OF_RANGE;
+    return MEASURE_OK;
+}
+
+static int runVerify() {
+    uint32_t mismatches = 0;
+
+    // Per-sample mapping: the calibration table without points against
+    // the baseline float formula, for every scaled level and a spread of
+    // formula settings; then the whole per-sample path, one raw IR sample
+    // per batch from a fresh filter, against the baseline measurement of
+    // the same value over every raw level the sensor can report
+    const int intersections[] = {0, 60, 117, 180, 255};
+    const float deviations[] = {0.0f, 0.1f, 0.165f, 0.333f, 1.0f};
+    uint32_t pathMismatches = 0;
+    ReadingFilter filter;
+    measureMode = MEASURE_MODE_IR;
+    for (size_t i = 0; i < sizeof(intersections) / sizeof(intersections[0]); i++) {
+        for (size_t d = 0; d < sizeof(deviations) / sizeof(deviations[0]); d++) {
+            intersectionPoint = intersections[i];
+            deviation = deviations[d];
+            deviationX1000 = (uint16_t)(deviations[d] * 1000.0f + 0.5f);
+            calibrationReset(&calibration);
+            for (uint32_t scaled = 0; scaled <= SCALED_LEVEL_MAX; scaled++) {
+                if (calibrationLookup(&calibration, scaled) !=
+                    baselineMapIRToAgtron(scaled, intersectionPoint, deviation)) {
+                    mismatches++;
+                }
+            }
+
+            for (uint32_t ir = 0; ir <= IR_READING_MAX + 1000; ir++) {
+                readingFilterReset(&filter);
+                autoRangeReset(&autoRange);
+                SensorSample sample = SensorSample();
+                sample.ir = ir;
+                sample.range = AUTO_RANGE_BASELINE;
+                MeasureResult result = evaluateSampleBatch(&filter, &sample, 1);
+
+                int agtron = 0;
+                MeasureStatus expected = baselineMeasure(ir, &agtron);
+                if (result.status != expected || (expected == MEASURE_OK && result.agtron != agtron)) {
+                    pathMismatches++;
+                }
+            }
+        }
+    }
+    printf("IR -> Agtron mapping:     %u mismatches\n", mismatches);
+    printf("per-sample path:          %u mismatches\n", pathMismatches);
+    mismatches += pathMismatches;
+
+    // Log dump: every deviationX1000 value, printed both ways
+    uint32_t formatMismatches = 0;
+    for (uint32_t milli = 0; milli <= 0xFFFF; milli++) {
+        char floating[16];
+        char fixed[16];
+        snprintf(floating, sizeof(floating), "%.3f", milli / 1000.0f);
+        snprintf(fixed, sizeof(fixed), "%u.%03u", milli / 1000, milli % 1000);
+        if (strcmp(floating, fixed) != 0) formatMismatches++;
+    }
+    printf("deviation column:         %u mismatches\n", formatMismatches);
+
+    // Telemetry text: the preallocated formatter against printf, which
+    // matches the String concatenation it replaced
+    uint32_t textMismatches = 0;
+    for (uint32_t n = 0; n < 2000000; n++) {
+        MeasureResult result;
+        result.status = (MeasureStatus)(n % 5);
+        result.rLevel = n * 2147u;  // Spans the whole uint32 range
+        result.agtron = (int)(n % 1400) - 700;
+        result.stable = (n & 8) != 0;
+
+        char text[TELEMETRY_TEXT_SIZE];
+        char expected[TELEMETRY_TEXT_SIZE];
+        formatMeasurementText(text, sizeof(text), result);
+        switch (result.status) {
+        case MEASURE_OK:
+            snprintf(expected, sizeof(expected), "real:%u\r\nagtron:%d\r\n===========================\r\n",
+                     result.rLevel, result.agtron);
+            break;
+        case MEASURE_INVALID_READING:
+            snprintf(expected, sizeof(expected), "Warning: Invalid sensor reading: %u\r\n", result.rLevel);
+            break;
+        case MEASURE_SCALED_TOO_HIGH:
+            snprintf(expected, sizeof(expected), "Warning: Scaled value too high: %u\r\n", result.rLevel / 1000);
+            break;
+        case MEASURE_AGTRON_OUT_OF_RANGE:
+            snprintf(expected, sizeof(expected), "Warning: Agtron value out of range: %d\r\n", result.agtron);
+            break;
+        default:
+            expected[0] = '\0';
+            break;
+        }
+        if (strcmp(text, expected) != 0) textMismatches++;
+    }
+    printf("telemetry text:           %u mismatches\n", textMismatches);
+
+    uint32_t parserMismatches = verifyCommandParser();
+    printf("command parser:           %u mismatches\n", parserMismatches);
+
+    bool ok = mismatches == 0 && formatMismatches == 0 && textMismatches == 0 && parserMismatches == 0;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+static void addReplayStats(ReplayStats *total, const ReplayStats &stats) {
+    total->rows += stats.rows;
+    total->restarts += stats.restarts;
+    total->malformed += stats.malformed;
+    total->measured += stats.measured;
+    total->exact += stats.exact;
+    total->withinOne += stats.withinOne;
+    total->maxDifference = std::max(total->maxDifference, stats.maxDifference);
+    total->differenceSum += stats.differenceSum;
+    total->pipelineNs += stats.pipelineNs;
+    total->maxPipelineNs = std::max(total->maxPipelineNs, stats.maxPipelineNs);
+    total->totalNs += stats.totalNs;
+}
+
+static void printReplayStats(const char *label, const ReplayStats &stats) {
+    double measured = stats.measured > 0 ? stats.measured : 1;
+    double rows = stats.rows > 0 ? stats.rows : 1;
+    printf("%s: %u readings, %u restarts, %u malformed lines\n",
+           label, stats.rows, stats.restarts, stats.malformed);
+    printf("  agtron:   %u measured, %.1f%% exact, %.1f%% within 1, mean |diff| %.2f, max %u\n",
+           stats.measured, 100.0 * stats.exact / measured, 100.0 * stats.withinOne / measured,
+           stats.differenceSum / measured, stats.maxDifference);
+    printf("  pipeline: %.1f ns/sample (max %u ns), %.0f samples/s with parsing\n",
+           stats.pipelineNs / rows, stats.maxPipelineNs,
+           stats.totalNs > 0 ? stats.rows * 1e9 / stats.totalNs : 0.0);
+}
+
+static int runReplay(int fileCount, char **files) {
+    if (fileCount == 0) {
+        fprintf(stderr, "replay: no capture files given\n");
+        return 2;
+    }
+
+    ReplayStats total = ReplayStats();
+    bool failed = false;
+    for (int i = 0; i < fileCount; i++) {
+        ReplayStats stats = ReplayStats();
+        if (!replayFile(files[i], &stats)) {
+            fprintf(stderr, "replay: cannot open %s\n", files[i]);
+            failed = true;
+            continue;
+        }
+        printReplayStats(files[i], stats);
+        addReplayStats(&total, stats);
+    }
+    if (fileCount > 1) printReplayStats("total", total);
+    return failed || total.rows == 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *mode = argc > 1 ? argv[1] : "sim";
+
+    if (strcmp(mode, "sim") == 0) return runSim();
+    if (strcmp(mode, "bench") == 0) {
+#if DEBUG_LOGGING_ENABLED
+        benchLogWrites();
+#endif
+        benchReadingFilter();
+        benchCalibration();
+        benchDeviationFormatting();
+#if PERF_COUNTERS_ENABLED
+        benchPerfCounters();
+#endif
+        return runBench();
+    }
+    if (strcmp(mode, "stress") == 0) return runStress();
+    if (strcmp(mode, "verify") == 0) return runVerify();
+    if (strcmp(mode, "replay") == 0) return runReplay(argc - 2, argv + 2);
+
+    fprintf(stderr, "usage: %s [sim|bench|stress|verify] | replay capture.csv...\n", argv[0]);
+    return 2;
+}
+#endif
@@ -0,0 +1,160 @@
+#include "replay.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "auto_range.h"
+#include "calibration.h"
+#include "reading_filter.h"
+
+// IR count ratio rows are replayed at: inside the auto range band, so the
+// gain step stays put, and a tenth of RATIO_SCALE, so Red carries the level
+// to within 10 ppm
+#define REPLAY_RATIO_IR (RATIO_SCALE / 10)
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool replayParseRow(const char *line, ReplayRow *row) {
+    unsigned timestamp, rawLevel, ledBrightness, gainStep = AUTO_RANGE_BASELINE;
+    int agtron, intersectionPoint;
+    double deviation;
+    char mode[8] = "ir";
+
+    int fields = sscanf(line, "%u,%u,%d,%u,%d,%lf,%u,%7s", &timestamp, &rawLevel, &agtron,
+                        &ledBrightness, &intersectionPoint, &deviation, &gainStep, mode);
+    if (fields != 6 && fields != 8) return false;
+    if (ledBrightness > 255 || gainStep >= AUTO_RANGE_STEPS || deviation < 0.0 || deviation > 65.535) return false;
+
+    row->timestamp = timestamp;
+    row->rawLevel = rawLevel;
+    row->agtron = agtron;
+    row->ledBrightness = (uint8_t)ledBrightness;
+    row->intersectionPoint = intersectionPoint;
+    row->deviationX1000 = (uint16_t)(deviation * 1000.0 + 0.5);
+    row->gainStep = (uint8_t)gainStep;
+    row->mode = strcmp(mode, "ratio") == 0 ? MEASURE_MODE_RATIO : MEASURE_MODE_IR;
+    return true;
+}
+
+// -- Pipeline state --
+
+static ReadingFilter filter;
+
+// Settings the row was logged with; the IR table follows the formula
+static void applySettings(const ReplayRow &row, bool force) {
+    if (!force && row.ledBrightness == ledBrightness && row.intersectionPoint == intersectionPoint &&
+        row.deviationX1000 == deviationX1000) {
+        return;
+    }
+    ledBrightness = row.ledBrightness;
+    intersectionPoint = row.intersectionPoint;
+    deviationX1000 = row.deviationX1000;
+    deviation = row.deviationX1000 / 1000.0f;
+    calibrationReset(&calibration);
+}
+
+// Inverse of autoRangeNormalize(): the raw count the row's level was
+// scaled from at its gain step
+static uint32_t rawAtStep(uint32_t level, uint8_t step) {
+    uint8_t ledAmplitude = autoRangeLedAmplitude(step, ledBrightness);
+    if (step == AUTO_RANGE_BASELINE || ledAmplitude == 0) return level;
+
+    uint64_t numerator = (uint64_t)level * AUTO_RANGE_BASE_ADC * ledAmplitude;
+    uint64_t denominator = (uint64_t)autoRangeAdcRange(step) * ledBrightness;
+    return (uint32_t)((numerator + denominator / 2) / denominator);
+}
+
+// One FIFO sample standing for the whole batch the row was logged from
+static SensorSample replaySample(const ReplayRow &row) {
+    SensorSample sample = SensorSample();
+    sample.timestamp = row.timestamp;
+    sample.range = row.gainStep;
+    sample.mode = row.mode;
+    if (row.mode == MEASURE_MODE_RATIO) {
+        sample.ir = REPLAY_RATIO_IR;
+        sample.red = (uint32_t)(((uint64_t)row.rawLevel * REPLAY_RATIO_IR + RATIO_SCALE / 2) / RATIO_SCALE);
+    } else {
+        sample.ir = rawAtStep(row.rawLevel, row.gainStep);
+    }
+    return sample;
+}
+
+// -- End Pipeline state --
+
+bool replayFile(const char *path, ReplayStats *stats) {
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    uint64_t start = nowNs();
+
+    // Only logged readings are in the capture, so a cup is always present
+    unblockedValue = 0;
+    calibrationReset(&ratioCalibration);
+    readingFilterReset(&filter);
+    autoRangeReset(&autoRange);
+
+    bool settingsApplied = false;
+    bool fresh = true;  // Filter restarted; the next row starts a reading
+    uint32_t lastTimestamp = 0;
+    char line[256];
+
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') {
+            if (strncmp(line, "# warmup", 8) == 0 && !fresh) {
+                readingFilterReset(&filter);
+                autoRangeReset(&autoRange);
+                stats->restarts++;
+                fresh = true;
+            }
+            continue;
+        }
+        if (line[0] == '\r' || line[0] == '\n' || strncmp(line, "timestamp_ms", 12) == 0) continue;
+
+        ReplayRow row;
+        if (!replayParseRow(line, &row)) {
+            stats->malformed++;
+            continue;
+        }
+
+        // Rebooted (the clock went back) or no reading for a while: on the
+        // device the filter restarted in between
+        if (!fresh && (row.timestamp < lastTimestamp || row.timestamp - lastTimestamp >= REPLAY_RESTART_GAP_MS)) {
+            readingFilterReset(&filter);
+            autoRangeReset(&autoRange);
+            stats->restarts++;
+        }
+        fresh = false;
+        lastTimestamp = row.timestamp;
+
+        applySettings(row, !settingsApplied);
+        settingsApplied = true;
+        measureMode = row.mode;
+        autoRange.step = row.gainStep;  // The step the device was at for this batch
+        SensorSample sample = replaySample(row);
+
+        uint64_t evaluateStart = nowNs();
+        MeasureResult result = evaluateSampleBatch(&filter, &sample, 1);
+        uint32_t elapsed = (uint32_t)(nowNs() - evaluateStart);
+        stats->pipelineNs += elapsed;
+        if (elapsed > stats->maxPipelineNs) stats->maxPipelineNs = elapsed;
+        stats->rows++;
+
+        if (result.status != MEASURE_OK) continue;
+        uint32_t difference = (uint32_t)(result.agtron > row.agtron ? result.agtron - row.agtron
+                                                                     : row.agtron - result.agtron);
+        stats->measured++;
+        if (difference == 0) stats->exact++;
+        if (difference <= 1) stats->withinOne++;
+        if (difference > stats->maxDifference) stats->maxDifference = difference;
+        stats->differenceSum += difference;
+    }
+
+    fclose(file);
+    stats->totalNs += nowNs() - start;
+    return true;
+}
@@ -0,0 +1,57 @@
+// Replay of captured logs through the firmware measurement pipeline
+// (native env only).
+//
+// Reads the CSV written by tools/capture_log.py (or LOG DUMP) and feeds
+// every logged reading back through evaluateSampleBatch() on a clock taken
+// from the timestamps, with the settings, gain step and mode the row was
+// taken at. The agtron value the pipeline produces now is compared with
+// the one recorded, so a change to validation, filtering or calibration
+// can be scored against a whole archive of real roasts.
+//
+// A row is the mean level of one 100 ms batch, so the reading filter sees
+// one value per batch where the device saw every sample of it; agreement
+// is therefore close but not exact, and what a change should be judged by
+// is how it moves. Calibration points are not in the log: IR rows map
+// through the intersection / deviation formula, ratio rows through the
+// default ratio line. Ratio levels come back to within 10 ppm.
+#pragma once
+
+#include <stdint.h>
+
+#include "measurement.h"
+
+#define REPLAY_RESTART_GAP_MS 500  // No logged reading for this long: the cup was taken out
+
+struct ReplayRow {
+    uint32_t timestamp;
+    uint32_t rawLevel;        // raw_ir: batch mean at the calibration configuration
+    int agtron;
+    uint8_t ledBrightness;
+    int intersectionPoint;
+    uint16_t deviationX1000;
+    uint8_t gainStep;
+    MeasureMode mode;
+};
+
+struct ReplayStats {
+    uint32_t rows;            // Readings replayed
+    uint32_t restarts;        // Warm-ups, reboots and gaps that restarted the filter
+    uint32_t malformed;       // Lines that are neither a reading, a comment nor the header
+    uint32_t measured;        // Replayed to MEASURE_OK
+    uint32_t exact;           // ... with the recorded agtron
+    uint32_t withinOne;       // ... within one point of it
+    uint32_t maxDifference;   // Largest |replayed - recorded| agtron
+    uint64_t differenceSum;
+    uint64_t pipelineNs;      // Spent in evaluateSampleBatch()
+    uint32_t maxPipelineNs;
+    uint64_t totalNs;         // Whole replay, CSV parsing included
+};
+
+// Parse one CSV line; false for the header, comments and malformed lines.
+// Captures without the gain_step and mode columns (LOG DUMP, capture_log.py
+// without --extended) read as baseline IR.
+bool replayParseRow(const char *line, ReplayRow *row);
+
+// Replay one capture file into stats (added to what is there); false if
+// it cannot be opened. Leaves the measurement globals at its last row.
+bool replayFile(const char *path, ReplayStats *stats);
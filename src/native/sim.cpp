@@ -0,0 +1,46 @@
+#include "sim.h"
+
+SensorConfig simSensorConfig(bool ambientSlot, bool redSlot) {
+    SensorConfig config;
+    config.ledBrightness = ledBrightness;
+    config.sampleAverage = 4;
+    config.ledMode = 2;
+    config.sampleRate = 50;
+    config.pulseWidth = 411;
+    config.adcRange = AUTO_RANGE_BASE_ADC;
+    config.ambientSlot = ambientSlot;
+    config.redSlot = redSlot;
+    return config;
+}
+
+void simLoopBegin(SimLoop *loop, ScriptedSensor &sensor) {
+    loop->sensor = &sensor;
+    readingFilterReset(&loop->filter);
+    loop->now = 0;
+    loop->batchCount = 0;
+    loop->next = 0;
+    loop->lastTick = 0;
+    autoRangeReset(&autoRange);
+    resetSampleQueue();
+}
+
+bool simLoopNext(SimLoop *loop, MeasureResult *result) {
+    while (!loop->sensor->finished()) {
+        uint32_t now = loop->next;
+        loop->next += SIM_LOOP_STEP_MS;
+        acquireSamples(*loop->sensor, now);
+
+        if (now - loop->lastTick <= MEASURE_INTERVAL_MS) continue;
+        loop->lastTick = now;
+
+        SensorSample batch[SAMPLE_QUEUE_SIZE];
+        uint8_t count = drainSampleQueue(batch, SAMPLE_QUEUE_SIZE);
+        if (count == 0) continue;
+
+        loop->now = now;
+        loop->batchCount = count;
+        *result = evaluateSampleBatch(&loop->filter, batch, count);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+// Scripted sensor runs through the firmware measurement pipeline (native
+// env only), shared by the sim mode and the unit tests.
+//
+// The acquisition task reads the sensor FIFO every SIM_LOOP_STEP_MS into
+// the sample queue; once MEASURE_INTERVAL_MS has passed, the measurement
+// tick drains the queue into evaluateSampleBatch(), as on the device.
+#pragma once
+
+#include <stdint.h>
+
+#include "fakes.h"
+#include "measurement.h"
+
+#define SIM_SAMPLE_INTERVAL_MS 80  // 50 Hz with sampleAverage = 4
+#define SIM_LOOP_STEP_MS 10
+
+struct SimLoop {
+    ScriptedSensor *sensor;
+    ReadingFilter filter;
+    uint32_t now;         // Time of the batch evaluated last
+    uint8_t batchCount;   // Its samples
+    uint32_t next;        // Time of the next acquisition
+    uint32_t lastTick;
+};
+
+// The firmware's sensor settings, at the calibration configuration
+SensorConfig simSensorConfig(bool ambientSlot, bool redSlot);
+
+// Start at t = 0 with a fresh filter, sample queue and auto range
+void simLoopBegin(SimLoop *loop, ScriptedSensor &sensor);
+// Run up to the next measurement tick that has samples and evaluate its
+// batch; false once the sensor's script has run out
+bool simLoopNext(SimLoop *loop, MeasureResult *result);
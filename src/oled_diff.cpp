@@ -0,0 +1,38 @@
+#include "oled_diff.h"
+
+#include <string.h>
+
+void oledShadowReset(OledShadow *shadow) {
+    shadow->valid = false;
+}
+
+uint8_t oledSyncFrame(OledShadow *shadow, const uint8_t *frame,
+                      OledSpanWriter write, void *context) {
+    uint8_t spans = 0;
+
+    for (uint8_t page = 0; page < OLED_PAGE_COUNT; page++) {
+        const uint8_t *row = frame + page * SCREEN_WIDTH;
+        uint8_t *sent = shadow->frame + page * SCREEN_WIDTH;
+
+        int16_t first = 0;
+        int16_t last = SCREEN_WIDTH - 1;
+        if (shadow->valid) {
+            while (first < SCREEN_WIDTH && row[first] == sent[first]) first++;
+            if (first == SCREEN_WIDTH) continue;
+            while (row[last] == sent[last]) last--;
+        }
+
+        uint8_t length = (uint8_t)(last - first + 1);
+        shadow->bytesSent += write(page, (uint8_t)first, row + first, length, context);
+        memcpy(sent + first, row + first, length);
+        spans++;
+    }
+
+    shadow->valid = true;
+    if (spans > 0) {
+        shadow->framesPushed++;
+    } else {
+        shadow->framesSkipped++;
+    }
+    return spans;
+}
@@ -0,0 +1,75 @@
+#include "perf_counters.h"
+
+#if PERF_COUNTERS_ENABLED
+#include <string.h>
+
+static const char *const stageNames[PERF_STAGE_COUNT] = {
+    "sensor_read",
+    "measure",
+    "display",
+    "log_flush",
+    "telemetry",
+    "acquisition_loop",
+    "ui_loop",
+};
+
+// Roughly three per decade, 10 us up to the 300 ms beyond any loop period
+static const uint32_t bucketLimitsUs[PERF_HISTOGRAM_BUCKETS - 1] = {
+    10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000, 300000
+};
+
+static PerfStats stats[PERF_STAGE_COUNT];
+static uint32_t loopLastUs[PERF_STAGE_COUNT];
+static bool loopMarked[PERF_STAGE_COUNT];
+static uint32_t resultCounts[PERF_MEASURE_STATUS_COUNT];
+static uint32_t cyclesPerMicrosecond = 1;
+
+void perfReset(uint32_t cyclesPerUs) {
+    memset(stats, 0, sizeof(stats));
+    memset(loopMarked, 0, sizeof(loopMarked));
+    memset(resultCounts, 0, sizeof(resultCounts));
+    cyclesPerMicrosecond = cyclesPerUs > 0 ? cyclesPerUs : 1;
+}
+
+static void record(PerfStage stage, uint32_t us) {
+    PerfStats &s = stats[stage];
+    if (s.count == 0 || us < s.minUs) s.minUs = us;
+    if (us > s.maxUs) s.maxUs = us;
+    s.totalUs += us;
+    s.count++;
+
+    uint8_t bucket = 0;
+    while (bucket < PERF_HISTOGRAM_BUCKETS - 1 && us >= bucketLimitsUs[bucket]) bucket++;
+    s.histogram[bucket]++;
+}
+
+void perfEnd(PerfStage stage, uint32_t start) {
+    record(stage, (perfCycles() - start) / cyclesPerMicrosecond);
+}
+
+void perfLoopMark(PerfStage loop, uint32_t nowUs) {
+    if (loopMarked[loop]) record(loop, nowUs - loopLastUs[loop]);
+    loopLastUs[loop] = nowUs;
+    loopMarked[loop] = true;
+}
+
+void perfCountResult(MeasureStatus status) {
+    if ((unsigned)status < PERF_MEASURE_STATUS_COUNT) resultCounts[status]++;
+}
+
+const PerfStats *perfStats(PerfStage stage) {
+    return &stats[stage];
+}
+
+uint32_t perfResultCount(MeasureStatus status) {
+    return (unsigned)status < PERF_MEASURE_STATUS_COUNT ? resultCounts[status] : 0;
+}
+
+const char *perfStageName(PerfStage stage) {
+    return stage < PERF_STAGE_COUNT ? stageNames[stage] : "?";
+}
+
+uint32_t perfBucketLimitUs(uint8_t bucket) {
+    return bucket < PERF_HISTOGRAM_BUCKETS - 1 ? bucketLimitsUs[bucket] : 0;
+}
+#endif
@@ -0,0 +1,84 @@
+#include "reading_filter.h"
+
+#include <string.h>
+
+void readingFilterReset(ReadingFilter *filter) {
+    memset(filter, 0, sizeof(ReadingFilter));
+}
+
+// Replace outgoing with incoming in the sorted window, shifting only the
+// entries between the two positions
+static void replaceSorted(uint32_t *sorted, uint8_t count, uint32_t outgoing, uint32_t incoming) {
+    uint8_t i = 0;
+    while (sorted[i] != outgoing) i++;
+
+    while (i > 0 && sorted[i - 1] > incoming) {
+        sorted[i] = sorted[i - 1];
+        i--;
+    }
+    while (i + 1 < count && sorted[i + 1] < incoming) {
+        sorted[i] = sorted[i + 1];
+        i++;
+    }
+    sorted[i] = incoming;
+}
+
+static void insertSorted(uint32_t *sorted, uint8_t count, uint32_t incoming) {
+    uint8_t i = count;
+    while (i > 0 && sorted[i - 1] > incoming) {
+        sorted[i] = sorted[i - 1];
+        i--;
+    }
+    sorted[i] = incoming;
+}
+
+ReadingStats readingFilterAdd(ReadingFilter *filter, uint32_t sample) {
+    if (filter->count < READING_SAMPLES) {
+        insertSorted(filter->sorted, filter->count, sample);
+        filter->count++;
+    } else {
+        uint32_t outgoing = filter->arrival[filter->next];
+        replaceSorted(filter->sorted, filter->count, outgoing, sample);
+        filter->sum -= outgoing;
+        filter->sumSquares -= (uint64_t)outgoing * outgoing;
+    }
+    filter->arrival[filter->next] = sample;
+    filter->next = (filter->next + 1) % READING_SAMPLES;
+    filter->sum += sample;
+    filter->sumSquares += (uint64_t)sample * sample;
+
+    uint8_t count = filter->count;
+    const uint32_t *sorted = filter->sorted;
+
+    ReadingStats stats;
+    stats.median = (count & 1) ? sorted[count / 2]
+                               : (uint32_t)(((uint64_t)sorted[count / 2 - 1] + sorted[count / 2]) / 2);
+
+    // Trim only once there is something left in the middle
+    uint8_t trim = count > 2 * READING_TRIM ? READING_TRIM : 0;
+    uint64_t sum = filter->sum;
+    uint64_t sumSquares = filter->sumSquares;
+    for (uint8_t i = 0; i < trim; i++) {
+        uint32_t low = sorted[i];
+        uint32_t high = sorted[count - 1 - i];
+        sum -= (uint64_t)low + high;
+        sumSquares -= (uint64_t)low * low + (uint64_t)high * high;
+    }
+    uint8_t kept = count - 2 * trim;
+    stats.trimmedMean = (uint32_t)(sum / kept);
+    stats.trimmedVariance = (kept * sumSquares - sum * sum) / ((uint64_t)kept * kept);
+
+    // std deviation <= mean * tolerance, squared to stay in integers
+    uint64_t limit = (uint64_t)stats.trimmedMean * READING_TOLERANCE_PERMILLE;
+    stats.stable = count == READING_SAMPLES &&
+                   stats.trimmedVariance * 1000000 <= limit * limit;
+
+    if (!stats.stable) {
+        filter->locked = false;
+    } else if (!filter->locked) {
+        filter->locked = true;
+        filter->lockedMean = stats.trimmedMean;
+    }
+    stats.value = filter->locked ? filter->lockedMean : stats.trimmedMean;
+    return stats;
+}
@@ -1,180 +1,206 @@
 // VERSION 0.3-beta
 #include <Arduino.h>
-#include <Preferences.h>
-#include <Wire.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
 
-#include "MAX30105.h"
-#include <LittleFS.h>
-
-// -- Debug Logging Configuration --
-#ifndef DEBUG_LOGGING_ENABLED
-#define DEBUG_LOGGING_ENABLED 1
-#endif
-#ifndef DEBUG_SERIAL_COMMANDS
-#define DEBUG_SERIAL_COMMANDS 1
-#endif
-
-// -- Board Configuration (override via build_flags) --
-#ifndef I2C_SDA
-#define I2C_SDA -1
+#include "config.h"
+#if SENSOR_INT_PIN >= 0
+#include <driver/gpio.h>
+#include <esp_sleep.h>
 #endif
-#ifndef I2C_SCL
-#define I2C_SCL -1
+#if IDLE_SLEEP_ENABLED
+#include <driver/rtc_io.h>
+#include <soc/soc_caps.h>
 #endif
+#include "hal_arduino.h"
+#include "boot_trace.h"
+#include "calibration.h"
+#include "command_parser.h"
+#include "debug_log.h"
+#include "dump_frame.h"
+#include "idle_sleep.h"
+#include "measurement.h"
+#include "perf_counters.h"
+#include "settings.h"
+#include "spsc_queue.h"
+#include "telemetry.h"
+#include "warmup.h"
 
-// -- Display Configuration (override via build_flags) --
-#ifndef SCREEN_WIDTH
-#define SCREEN_WIDTH 128
-#endif
-#ifndef SCREEN_HEIGHT
-#define SCREEN_HEIGHT 64
-#endif
-#ifndef I2C_ADDRESS_OLED
-#define I2C_ADDRESS_OLED 0x3C
-#endif
-// Y offset for displays where visible area is shifted (e.g., some 64x48 OLEDs)
-#ifndef DISPLAY_Y_OFFSET
-#define DISPLAY_Y_OFFSET 0
-#endif
-
-// -- Constant Values --
-#ifndef FIRMWARE_REVISION_STRING
-#define FIRMWARE_REVISION_STRING "v0.2"
-#endif
+// -- Global Variables --
 
-#define WARMUP_TIME 60  // seconds
+// Shared by the sensor and the display
+I2cBus i2cBus;
 
-// -- End Constant Values --
+Max30105Sensor sensor(i2cBus);
 
-// -- Preferences constants --
+Ssd1306Display display(i2cBus);
 
-#define PREF_NAMESPACE "roast_meter"
-#define PREF_VALID_KEY "valid"
-#define PREF_VALID_CODE (0xAA)
-#define PREF_LED_BRIGHTNESS_KEY "led_brightness"
-#define PREF_LED_BRIGHTNESS_DEFAULT 95
-#define PREF_INTERSECTION_POINT_KEY "intersection_point"
-#define PREF_INTERSECTION_POINT_DEFAULT 117
-#define PREF_DEVIATION_KEY "deviation"
-#define PREF_DEVIATION_DEFAULT 0.165f
+PreferencesStore preferences;
 
-#define OLED_RESET -1
+#if DEBUG_LOGGING_ENABLED
+PartitionLogStorage logStorage(LOG_PARTITION_LABEL);
+#endif
 
-// -- End Preferences constants
+#if DEBUG_LOGGING_ENABLED
+// Measurements waiting for the storage task
+SpscQueue<MeasureResult, 32> logQueue;
+// Held by whichever task touches the debug log (storage or console)
+SemaphoreHandle_t logMutex;
+#endif
 
-// -- Debug Log constants --
+TaskHandle_t acquisitionTaskHandle;
+TaskHandle_t uiTaskHandle;
 #if DEBUG_LOGGING_ENABLED
-#define LOG_FILE_PATH "/log.bin"
-#define LOG_MAGIC 0x524F5354  // "ROST"
-#define LOG_VERSION 1
-#define LOG_MAX_ENTRIES 65000
-#define LOG_BUFFER_SIZE 10
-#define LOG_FLUSH_IDLE_MS 2000
-
-// Log header structure (32 bytes)
-struct __attribute__((packed)) LogHeader {
-    uint32_t magic;           // 0x524F5354 "ROST"
-    uint16_t version;         // Log format version
-    uint16_t reserved1;       // Padding
-    uint32_t writePosition;   // Next write index (0 to LOG_MAX_ENTRIES-1)
-    uint32_t entryCount;      // Total entries written (can exceed MAX if wrapped)
-    uint8_t  wrapped;         // 1 if buffer has wrapped
-    uint8_t  reserved2[15];   // Padding to 32 bytes
-};
+TaskHandle_t storageTaskHandle;
+#endif
+#if DEBUG_SERIAL_COMMANDS
+TaskHandle_t consoleTaskHandle;
+#endif
+#if SENSOR_INT_PIN >= 0
+TaskHandle_t powerTaskHandle;
+#endif
 
-// Log entry structure (16 bytes)
-struct __attribute__((packed)) LogEntry {
-    uint32_t timestamp;       // millis() value
-    uint32_t rawIR;           // Raw IR sensor value
-    int16_t  agtron;          // Calculated Agtron level
-    uint8_t  ledBrightness;   // LED brightness setting
-    uint8_t  intersectPt;     // Intersection point setting
-    uint16_t deviationX1000;  // Deviation * 1000
-    uint16_t flags;           // Reserved for future use
+enum AppState {
+    STATE_WARMUP,        // LED and die temperature settling
+    STATE_MEASURE,
+    STATE_SLEEP          // No cup for IDLE_SLEEP_SECONDS: sensor parked, deep sleep next
 };
+volatile AppState appState = STATE_WARMUP;
+
+WarmupTracker warmup;
+WarmupStatus warmupResult = WARMUP_RUNNING;  // How the warm-up of this boot (or the last cold one) ended
+ReadingFilter readingFilter;
+// Die temperature readings, acquisition -> ui, during warm-up only
+SpscQueue<float, 4> temperatureQueue;
+// Init stage timing of the last cold boot and, after a proximity wake, of
+// that wake; RTC memory keeps the cold one through deep sleep
+RTC_DATA_ATTR BootTrace coldBootTrace;
+#if IDLE_SLEEP_ENABLED
+RTC_DATA_ATTR BootTrace wakeBootTrace;
 #endif
-// -- End Debug Log constants --
-
-// -- Global Variables --
-
-uint32_t unblockedValue = 30000;  // Average IR at power up
-
-MAX30105 particleSensor;
-
-
-Adafruit_SSD1306 oled(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-
-Preferences preferences;
-
-// OLED status tracking
-bool oledAvailable = false;
-
-#if DEBUG_LOGGING_ENABLED
-// Debug logging state
-LogHeader logHeader;
-LogEntry logBuffer[LOG_BUFFER_SIZE];
-uint8_t logBufferCount = 0;
-unsigned long lastLogFlush = 0;
-unsigned long lastMeasurementTime = 0;
-bool logFileOpen = false;
+BootTrace *bootTrace = &coldBootTrace;  // This boot's
+// setup() waits here for the stages of the boot task
+TaskHandle_t setupTaskHandle;
+#if IDLE_SLEEP_ENABLED
+// Kept in RTC memory through deep sleep (idle_sleep.h)
+RTC_DATA_ATTR RetainedState retainedState;
+IdleTimer idleTimer;
+// The acquisition task left the sensor armed for the proximity wake
+volatile bool sensorParked = false;
+#endif
+#if DEBUG_SERIAL_COMMANDS
+// Scaled level of the current locked reading (0 when none), for CAL ADD
+volatile uint32_t lastStableLevel = 0;
+volatile TelemetryMode telemetryMode = TELEMETRY_TEXT;
 #endif
 
 // -- End Global Variables --
 
 // -- Global Setting --
 
-byte ledBrightness = 95;      // !Preferences setup
 byte sampleAverage = 4;  // Options: 1, 2, 4, 8, 16, --32--
 byte ledMode = 2;        // Options: 1 = Red only, --2 = Red + IR--, 3 = Red + IR + Green
 int sampleRate = 50;     // Options: 50, 100, 200, 400, 800, 1000, 1600, --3200--
 int pulseWidth = 411;    // Options: 69, 118, 215, --411--
 int adcRange = 16384;    // Options: 2048, 4096, 8192, --16384--
 
-int intersectionPoint = 117;  // !Preferences setup
-float deviation = 0.165;      // !Preferences setup
-
 // -- End Global Setting --
 
+// -- Task Setting --
+
+// Acquisition preempts everything else, so flash writes, display pushes
+// and serial dumps no longer delay sensor reads
+#define ACQUISITION_TASK_PRIORITY 4
+#define UI_TASK_PRIORITY 3
+#define STORAGE_TASK_PRIORITY 2
+#define CONSOLE_TASK_PRIORITY 1
+#define POWER_TASK_PRIORITY 0     // Shares the idle priority: runs only when nothing else can
+#define BOOT_TASK_PRIORITY 1      // Same as setup(), which waits on I2C while it reads flash
+#define TASK_STACK_SIZE 4096
+
+#define ACQUISITION_PERIOD_MS 10  // Well inside the 32-sample FIFO at any rate used here
+#define STORAGE_PERIOD_MS 50
+#define CONSOLE_PERIOD_MS 20
+#define SENSOR_INT_TIMEOUT_MS 1000  // Poll anyway if INT stays quiet this long
+#define LIGHT_SLEEP_MAX_MS 1000     // Timer wake-up so the periodic jobs still run
+
+// -- End Task Setting --
+
 // -- Setup Headers --
 
 void setupPreferences();
+void beginSensor();
 void setupParticleSensor();
+#if IDLE_SLEEP_ENABLED
+void resumeFromSleep(uint32_t setupStart);
+#endif
+void startTasks();
 
 // -- Setup Headers --
 
+// -- Task Headers --
+
+void bootTask(void *parameter);
+void acquisitionTask(void *parameter);
+void uiTask(void *parameter);
+#if DEBUG_LOGGING_ENABLED
+void storageTask(void *parameter);
+#endif
+#if DEBUG_SERIAL_COMMANDS
+void consoleTask(void *parameter);
+#endif
+#if SENSOR_INT_PIN >= 0
+void onSensorInterrupt();
+void powerTask(void *parameter);
+#endif
+
+// -- End Task Headers --
+
 // -- Sub Routine Headers --
 
-void displayStartUp();
-void warmUpLED();
+void uiJob();
+void warmUpJob();
+void startMeasuring();
+void temperatureJob();
 void measureSampleJob();
-void displayPleaseLoadSample();
-void displayMeasurement(int rLevel);
+void sleepJob();
+#if IDLE_SLEEP_ENABLED
+void parkSensor();
+#endif
+void telemetryJob(const SensorSample *batch, uint8_t count, const MeasureResult &result);
+void displayRateJob();
 
 #if DEBUG_LOGGING_ENABLED
-void setupDebugLog();
-void logMeasurement(uint32_t timestamp, uint32_t rawIR, int16_t agtron);
-void flushLogBuffer();
+void setupLogStorage(const LogPosition *resumeFrom);
 #endif
 
 #if DEBUG_SERIAL_COMMANDS
 void handleSerialCommands();
 void dumpLogToSerial();
+void dumpLogRange(uint32_t first, uint32_t count);
+void dumpLogSession(bool last, uint32_t session);
+void printLogSessions();
+void dumpLogBinary(bool singlePage, uint32_t sequence);
 void clearLog();
 void printLogStatus();
+void printDisplayStatus();
+void printTaskStatus();
+void printBootTimes();
+#if PERF_COUNTERS_ENABLED
+void printPerfStatus();
+void resetPerfCounters();
+#endif
+void addCalibrationPoint(const CommandArgs &args);
+void clearCalibration();
+void printCalibration();
+void setTelemetryMode(const CommandArgs &args);
+void setMeasureMode(const CommandArgs &args);
+void printHelp();
 #endif
 
 // -- End Sub Routine Headers --
 
-// -- Utility Function Headers --
-
-int mapIRToAgtron(uint32_t x);
-
-// -- End Utility Function Headers --
-
 // -- Main Process --
 void setup() {
+    uint32_t setupStart = micros();
     Serial.begin(115200);
 
 #if I2C_SDA >= 0 && I2C_SCL >= 0
@@ -182,556 +208,895 @@ void setup() {
 #else
     Wire.begin();
 #endif
+    i2cBus.begin();
+
+#if IDLE_SLEEP_ENABLED
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    bool proximityWake = cause == ESP_SLEEP_WAKEUP_EXT0 || cause == ESP_SLEEP_WAKEUP_GPIO;
+    if (proximityWake) {
+        bootTrace = &wakeBootTrace;
+        bootTraceReset(bootTrace);
+        bootPhaseStart(bootTrace, BOOT_PHASE_SETUP, setupStart);
+        bootPhaseStart(bootTrace, BOOT_PHASE_SETTINGS, micros());
+        bool resumed = resumeState(&retainedState);
+        bootPhaseEnd(bootTrace, BOOT_PHASE_SETTINGS, micros());
+        if (resumed) {
+            resumeFromSleep(setupStart);
+            return;
+        }
+        bootTrace = &coldBootTrace;
+    }
+    memset(&retainedState, 0, sizeof(retainedState));  // Cold boot: the wake count starts over
+    bootTraceReset(&wakeBootTrace);
+#endif
+    bootTraceReset(&coldBootTrace);
+    bootPhaseStart(bootTrace, BOOT_PHASE_SETUP, setupStart);
+
+    // Flash (settings, then the log) in the boot task, I2C (display, then
+    // the sensor) here; each stage waits on its bus while the other runs
+    setupTaskHandle = xTaskGetCurrentTaskHandle();
+    xTaskCreate(bootTask, "boot", TASK_STACK_SIZE, NULL, BOOT_TASK_PRIORITY, NULL);
 
-    // Initialize OLED
-    if (!oled.begin(SSD1306_SWITCHCAPVCC, I2C_ADDRESS_OLED)) {
+    // Initialize OLED; the start-up screen stays up until the warm-up screen
+    bootPhaseStart(bootTrace, BOOT_PHASE_DISPLAY, micros());
+    if (!display.begin()) {
         Serial.println(F("❌ OLED initialization failed!"));
         // Continue without display - device can still work via serial
         Serial.println(F("Continuing without display..."));
-        oledAvailable = false;
     } else {
-        oledAvailable = true;
         Serial.println(F("✅ OLED initialized successfully"));
-
-        oled.clearDisplay();
-        oled.setTextSize(1);
-        oled.setTextColor(WHITE);
-        oled.setCursor(0, 0);
-        oled.println("Initializing...");
-        oled.display();
     }
+    display.showStartUp(FIRMWARE_REVISION_STRING);
+    bootPhaseEnd(bootTrace, BOOT_PHASE_DISPLAY, micros());
 
-    setupPreferences();
+    bootPhaseStart(bootTrace, BOOT_PHASE_SENSOR, micros());
+    beginSensor();
+    ulTaskNotifyTake(pdFALSE, portMAX_DELAY);  // Settings loaded: ledBrightness, measureMode
+    setupParticleSensor();
+    bootPhaseEnd(bootTrace, BOOT_PHASE_SENSOR, micros());
 
 #if DEBUG_LOGGING_ENABLED
-    setupDebugLog();
+    ulTaskNotifyTake(pdFALSE, portMAX_DELAY);  // Log open
 #endif
 
-    // Initialize sensor
-    if (particleSensor.begin(Wire, 400000) == false)  // Use default I2C port, 400kHz speed
-    {
-        Serial.println("MAX30105 was not found. Please check wiring/power. ");
-        if (oledAvailable) {
-            oled.clearDisplay();
-            oled.setCursor(0, 0);
-            oled.println("Sensor Error!");
-            oled.println("Check wiring");
-            oled.display();
-        }
+    // Warm-up runs as the first state of the UI task
+    warmupBegin(&warmup, millis());
+    bootPhaseStart(bootTrace, BOOT_PHASE_WARMUP, micros());
+    startTasks();
+    bootPhaseEnd(bootTrace, BOOT_PHASE_SETUP, micros());
+}
 
-        // Retry every 5 seconds
-        while (particleSensor.begin(Wire, 400000) == false) {
-            Serial.println("Retrying sensor initialization...");
-            delay(5000);
-        }
-        Serial.println("Sensor initialized after retry!");
-    }
+void loop() {
+    // Everything runs in the tasks started by setup()
+    vTaskDelete(NULL);
+}
 
-    setupParticleSensor();
+#if IDLE_SLEEP_ENABLED
+// Warm path after a proximity wake: no splash, NVS read, log scan or
+// warm-up. The cup that woke the meter is measured right away.
+void resumeFromSleep(uint32_t setupStart) {
+    Serial.printf("Proximity wake %lu, resuming\n", retainedState.wakes);
 
-    displayStartUp();
-    warmUpLED();
-}
+    bootPhaseStart(bootTrace, BOOT_PHASE_DISPLAY, micros());
+    display.begin();
+    bootPhaseEnd(bootTrace, BOOT_PHASE_DISPLAY, micros());
+    preferences.begin(PREF_NAMESPACE);  // CAL and MODE still save to NVS
 
-void loop() {
-#if DEBUG_SERIAL_COMMANDS
-    handleSerialCommands();
+#if DEBUG_LOGGING_ENABLED
+    bootPhaseStart(bootTrace, BOOT_PHASE_LOG, micros());
+    setupLogStorage(&retainedState.log);
+    bootPhaseEnd(bootTrace, BOOT_PHASE_LOG, micros());
 #endif
-    measureSampleJob();
+
+    bootPhaseStart(bootTrace, BOOT_PHASE_SENSOR, micros());
+    beginSensor();
+    setupParticleSensor();
+    bootPhaseEnd(bootTrace, BOOT_PHASE_SENSOR, micros());
+
+    warmupResult = (WarmupStatus)retainedState.warmup;
+    startMeasuring();
+    startTasks();
+    bootPhaseEnd(bootTrace, BOOT_PHASE_SETUP, micros());
 }
+#endif
 
 // -- End Main Process --
 
 // -- Setups --
 
 void setupPreferences() {
-    preferences.begin(PREF_NAMESPACE, false);
+    SettingsStatus status = loadSettings(preferences);
 
-    if (preferences.getUChar(PREF_VALID_KEY, 0) != PREF_VALID_CODE) {
+    if (status == SETTINGS_INITIALIZED) {
         Serial.println("Preferences were invalid");
-
-        preferences.putUChar(PREF_VALID_KEY, PREF_VALID_CODE);
-        preferences.putUChar(PREF_LED_BRIGHTNESS_KEY, PREF_LED_BRIGHTNESS_DEFAULT);
-        preferences.putInt(PREF_INTERSECTION_POINT_KEY, PREF_INTERSECTION_POINT_DEFAULT);
-        preferences.putFloat(PREF_DEVIATION_KEY, PREF_DEVIATION_DEFAULT);
-
         Serial.println("Preferences initialized");
-    }
-
-    if (preferences.getUChar(PREF_VALID_KEY, 0) != PREF_VALID_CODE) {
+    } else if (status == SETTINGS_DEFAULTS) {
+        Serial.println("Preferences were invalid");
         Serial.println("Preferences cannot be initialized - using defaults");
-        // Use default values instead of hanging
-        ledBrightness = PREF_LED_BRIGHTNESS_DEFAULT;
-        intersectionPoint = PREF_INTERSECTION_POINT_DEFAULT;
-        deviation = PREF_DEVIATION_DEFAULT;
-        return;  // Exit early with defaults
+        return;
     }
 
     Serial.println("Preferences are valid");
-
-    ledBrightness = preferences.getUChar(PREF_LED_BRIGHTNESS_KEY, PREF_LED_BRIGHTNESS_DEFAULT);
     Serial.println("Set ledBrightness to " + String(ledBrightness));
-
-    intersectionPoint = preferences.getInt(PREF_INTERSECTION_POINT_KEY, PREF_INTERSECTION_POINT_DEFAULT);
     Serial.println("Set intersection point to " + String(intersectionPoint));
-
-    deviation = preferences.getFloat(PREF_DEVIATION_KEY, PREF_DEVIATION_DEFAULT);
     Serial.print("Set deviation to ");
     Serial.print(deviation);
     Serial.println();
+    Serial.println(measureMode == MEASURE_MODE_RATIO ? "Measuring the Red / IR ratio" : "Measuring IR");
+}
+
+void beginSensor() {
+    if (sensor.begin() == false)
+    {
+        Serial.println("MAX30105 was not found. Please check wiring/power. ");
+        display.showStatus("Sensor Error!", "Check wiring");
+
+        // Retry every 5 seconds
+        while (sensor.begin() == false) {
+            Serial.println("Retrying sensor initialization...");
+            delay(5000);
+        }
+        Serial.println("Sensor initialized after retry!");
+    }
 }
 
 void setupParticleSensor() {
-    
-    particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);  // Configure sensor with these settings
-    
-    particleSensor.setPulseAmplitudeRed(0);
-    particleSensor.setPulseAmplitudeGreen(0);
+    SensorConfig config;
+    config.ledBrightness = ledBrightness;
+    config.sampleAverage = sampleAverage;
+    config.ledMode = ledMode;
+    config.sampleRate = sampleRate;
+    config.pulseWidth = pulseWidth;
+    config.adcRange = adcRange;
+    config.ambientSlot = SENSOR_AMBIENT_SLOT;
+    MeasureMode mode = measureMode;
+    config.redSlot = mode == MEASURE_MODE_RATIO;
+
+    sensor.configure(config);
+    sensorConfigured(mode);
+#if SENSOR_INT_PIN >= 0
+    sensor.enableInterrupt(SENSOR_INT_SAMPLES);
+#endif
+}
 
-    particleSensor.disableSlots();
-    particleSensor.enableSlot(2, 0x02);  // Enable only SLOT_IR_LED = 0x02
+void startTasks() {
+#if PERF_COUNTERS_ENABLED
+    resetPerfCounters();
+#endif
+#if DEBUG_LOGGING_ENABLED
+    logMutex = xSemaphoreCreateMutex();
+    xTaskCreate(storageTask, "storage", TASK_STACK_SIZE, NULL, STORAGE_TASK_PRIORITY, &storageTaskHandle);
+#endif
+#if DEBUG_SERIAL_COMMANDS
+    xTaskCreate(consoleTask, "console", TASK_STACK_SIZE, NULL, CONSOLE_TASK_PRIORITY, &consoleTaskHandle);
+#endif
+    xTaskCreate(uiTask, "ui", TASK_STACK_SIZE, NULL, UI_TASK_PRIORITY, &uiTaskHandle);
+    xTaskCreate(acquisitionTask, "acquisition", TASK_STACK_SIZE, NULL, ACQUISITION_TASK_PRIORITY, &acquisitionTaskHandle);
+
+#if SENSOR_INT_PIN >= 0
+    // INT is open drain, active low
+    pinMode(SENSOR_INT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(SENSOR_INT_PIN), onSensorInterrupt, FALLING);
+    xTaskCreate(powerTask, "power", TASK_STACK_SIZE, NULL, POWER_TASK_PRIORITY, &powerTaskHandle);
+
+    // INT may already be held low from the warm-up; one read releases it
+    xTaskNotifyGive(acquisitionTaskHandle);
+#endif
 }
 
 // -- End Setups --
 
-// Sub Routines
+// -- Tasks --
 
-void displayStartUp() {
-    if (!oledAvailable) {
-        Serial.println("Display: Roast Meter " + String(FIRMWARE_REVISION_STRING));
-        delay(2000);
-        return;
+// The flash side of the cold boot; notifies setup() once per stage
+void bootTask(void *parameter) {
+    bootPhaseStart(bootTrace, BOOT_PHASE_SETTINGS, micros());
+    setupPreferences();
+    bootPhaseEnd(bootTrace, BOOT_PHASE_SETTINGS, micros());
+    xTaskNotifyGive(setupTaskHandle);
+
+#if DEBUG_LOGGING_ENABLED
+    bootPhaseStart(bootTrace, BOOT_PHASE_LOG, micros());
+    setupLogStorage(NULL);
+    bootPhaseEnd(bootTrace, BOOT_PHASE_LOG, micros());
+    xTaskNotifyGive(setupTaskHandle);
+#endif
+
+    vTaskDelete(NULL);
+}
+
+#if SENSOR_INT_PIN >= 0
+void IRAM_ATTR onSensorInterrupt() {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(acquisitionTaskHandle, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
     }
+}
+#endif
 
-    oled.clearDisplay();
-#if SCREEN_HEIGHT <= 48
-    oled.setCursor(4, 12 + DISPLAY_Y_OFFSET);
-    oled.print("Roast Meter");
-    oled.setCursor(20, 22 + DISPLAY_Y_OFFSET);
-    oled.print(FIRMWARE_REVISION_STRING);
+// Only producer of sampleQueue
+void acquisitionTask(void *parameter) {
+#if SENSOR_INT_PIN >= 0
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSOR_INT_TIMEOUT_MS));
+#if IDLE_SLEEP_ENABLED
+        if (appState == STATE_SLEEP) parkSensor();  // Does not return
+#endif
+        perfLoopMark(PERF_LOOP_ACQUISITION, micros());
+        if (sensorModeStale()) setupParticleSensor();  // MODE switched
+        uint32_t readStart = perfStart();
+        acquireSamples(sensor, millis());
+        perfEnd(PERF_STAGE_SENSOR_READ, readStart);
+        temperatureJob();
+
+        // Hand the batch straight to the UI task instead of waiting for its tick
+        xTaskNotifyGive(uiTaskHandle);
+    }
 #else
-    oled.setCursor(0, 0);
-    oled.print("Roast  ");
-    oled.print("Meter  ");
-    oled.print(FIRMWARE_REVISION_STRING);
+    TickType_t wakeTime = xTaskGetTickCount();
+    for (;;) {
+        perfLoopMark(PERF_LOOP_ACQUISITION, micros());
+        if (sensorModeStale()) setupParticleSensor();  // MODE switched
+        uint32_t readStart = perfStart();
+        acquireSamples(sensor, millis());
+        perfEnd(PERF_STAGE_SENSOR_READ, readStart);
+        temperatureJob();
+        vTaskDelayUntil(&wakeTime, pdMS_TO_TICKS(ACQUISITION_PERIOD_MS));
+    }
 #endif
-    oled.display();
+}
 
-    delay(2000);
+// Consumer of sampleQueue, producer of logQueue; owns the display
+void uiTask(void *parameter) {
+#if SENSOR_INT_PIN >= 0
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSOR_INT_TIMEOUT_MS));
+        perfLoopMark(PERF_LOOP_UI, micros());
+        uiJob();
+    }
+#else
+    TickType_t wakeTime = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&wakeTime, pdMS_TO_TICKS(MEASURE_INTERVAL_MS));
+        perfLoopMark(PERF_LOOP_UI, micros());
+        uiJob();
+    }
+#endif
 }
 
-const char* getWarmupFace(int secondsLeft) {
-    if (secondsLeft > 45) return "(-.-)zzZ";  // sleeping
-    if (secondsLeft > 30) return "(-.-)z";    // drowsy
-    if (secondsLeft > 15) return "(o.o)";     // waking
-    if (secondsLeft > 5)  return "(^.^)";     // alert
-    return "(^o^)/";                           // ready!
+#if DEBUG_LOGGING_ENABLED
+// Consumer of logQueue; the only task that writes flash
+void storageTask(void *parameter) {
+    for (;;) {
+        xSemaphoreTake(logMutex, portMAX_DELAY);
+
+        MeasureResult result;
+        while (logQueue.pop(&result)) {
+            if (!logMeasurement(result.timestamp, result.rawLevel, result.agtron,
+                                logMeasurementFlags(result.range, result.mode == MEASURE_MODE_RATIO))) {
+                Serial.println(F("WARNING: Log buffer full, dropping entry"));
+            }
+        }
+
+        // Flush log buffer if idle
+        if (logFlushDue(millis())) {
+            uint32_t flushStart = perfStart();
+            bool flushed = flushLogBuffer();
+            perfEnd(PERF_STAGE_LOG_FLUSH, flushStart);
+            if (!flushed) Serial.println(F("ERROR: Cannot write log"));
+        }
+
+        xSemaphoreGive(logMutex);
+        vTaskDelay(pdMS_TO_TICKS(STORAGE_PERIOD_MS));
+    }
 }
+#endif
 
-void warmUpLED() {
-    int countDownSeconds = WARMUP_TIME;
-    unsigned long jobTimerStart = millis();
-    unsigned long jobTimer = jobTimerStart;
+#if DEBUG_SERIAL_COMMANDS
+void consoleTask(void *parameter) {
+    for (;;) {
+        handleSerialCommands();
+        vTaskDelay(pdMS_TO_TICKS(CONSOLE_PERIOD_MS));
+    }
+}
+#endif
 
-    while (millis() - jobTimerStart <= WARMUP_TIME * 1000) {
-        unsigned long elapsed = millis() - jobTimer;
+#if SENSOR_INT_PIN >= 0
+// Light sleep stops USB, so only sleep with no host on the serial port,
+// and only once every queued sample and measurement has been handled
+static bool lightSleepAllowed() {
+    if (Serial) return false;
+    if (sampleQueue.depth() > 0) return false;
+#if DEBUG_LOGGING_ENABLED
+    if (logQueue.depth() > 0) return false;
+#endif
+    return digitalRead(SENSOR_INT_PIN) == HIGH;
+}
 
-        if (elapsed > 100) {
-            countDownSeconds = WARMUP_TIME - ((millis() - jobTimerStart) / 1000);
+void powerTask(void *parameter) {
+    esp_sleep_enable_timer_wakeup(LIGHT_SLEEP_MAX_MS * 1000ULL);
 
-            if (oledAvailable) {
-                oled.clearDisplay();
+    for (;;) {
+        if (!lightSleepAllowed()) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
 
-#if SCREEN_HEIGHT <= 48
-                // 64x48 display
-                oled.setTextSize(1);
-                oled.setCursor(8, 8 + DISPLAY_Y_OFFSET);
-                oled.println(getWarmupFace(countDownSeconds));
-                oled.println();
-                oled.printf(" Warm %ds", countDownSeconds);
-#else
-                // 128x64 display
-                oled.setCursor(0, 8);
-                oled.setTextSize(2);
-                oled.println(getWarmupFace(countDownSeconds));
-                oled.setTextSize(1);
-                oled.println();
-                oled.printf("  Warming up %ds", countDownSeconds);
-#endif
-                oled.display();
-            } else {
-                Serial.printf("Warm Up %ds %s\n", countDownSeconds, getWarmupFace(countDownSeconds));
-            }
+        // The edge interrupt cannot wake the chip; a low level can
+        gpio_wakeup_enable((gpio_num_t)SENSOR_INT_PIN, GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+        esp_light_sleep_start();
+        gpio_wakeup_disable((gpio_num_t)SENSOR_INT_PIN);
+        gpio_set_intr_type((gpio_num_t)SENSOR_INT_PIN, GPIO_INTR_NEGEDGE);
 
-            jobTimer = millis();
+        // The falling edge happened while asleep and was not latched
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+            xTaskNotifyGive(acquisitionTaskHandle);
         }
     }
-
-    // Ready celebration screen
-    if (oledAvailable) {
-        oled.clearDisplay();
-#if SCREEN_HEIGHT <= 48
-        oled.setTextSize(1);
-        oled.setCursor(12, 8 + DISPLAY_Y_OFFSET);
-        oled.println("(^o^)/");
-        oled.println();
-        oled.println(" Ready!");
-#else
-        oled.setTextSize(2);
-        oled.setCursor(20, 10);
-        oled.println("(^o^)/");
-        oled.setCursor(28, 35);
-        oled.println("Ready!");
+}
 #endif
-        oled.display();
-    } else {
-        Serial.println("(^o^)/ Ready!");
+
+// -- End Tasks --
+
+// Sub Routines
+
+void uiJob() {
+    switch (appState) {
+    case STATE_WARMUP:
+        warmUpJob();
+        break;
+    case STATE_MEASURE:
+        measureSampleJob();
+        break;
+    case STATE_SLEEP:
+        sleepJob();
+        break;
     }
-    delay(1500);
+    displayRateJob();
 }
 
-unsigned long measureSampleJobTimer = millis();
-void measureSampleJob() {
-#if DEBUG_LOGGING_ENABLED
-    // Flush log buffer if idle
-    if (logBufferCount > 0 && (millis() - lastMeasurementTime > LOG_FLUSH_IDLE_MS)) {
-        flushLogBuffer();
+// Feed the warm-up tracker; the countdown shows the WARMUP_TIME upper bound
+void warmUpJob() {
+    SensorSample batch[SAMPLE_QUEUE_SIZE];
+    uint8_t count = drainSampleQueue(batch, SAMPLE_QUEUE_SIZE);
+    for (uint8_t i = 0; i < count; i++) {
+        warmupAddSample(&warmup, ambientCorrectedIR(batch[i]));
+    }
+
+    float celsius;
+    while (temperatureQueue.pop(&celsius)) {
+        warmupAddTemperature(&warmup, celsius);
     }
+
+    unsigned long now = millis();
+    WarmupStatus status = warmupUpdate(&warmup, now);
+    uint32_t elapsed = warmupElapsed(&warmup, now);
+
+    if (status == WARMUP_RUNNING) {
+        display.showWarmUp(WARMUP_TIME - elapsed / 1000);
+        return;
+    }
+
+    Serial.printf("Warm-up %s after %lu ms\n", status == WARMUP_STABLE ? "stable" : "timed out", elapsed);
+#if DEBUG_LOGGING_ENABLED
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    logWarmup(now, elapsed, status == WARMUP_STABLE ? LOG_WARMUP_STABLE : LOG_WARMUP_TIMEOUT);
+    xSemaphoreGive(logMutex);
 #endif
 
-    if (millis() - measureSampleJobTimer > 100) {
-        uint32_t rLevel = particleSensor.getIR();
+    warmupResult = status;
+    bootPhaseEnd(bootTrace, BOOT_PHASE_WARMUP, micros());
+    // Stays up until the first batch is measured, one tick later
+    display.showReady();
+    startMeasuring();
+}
 
-        // Validate sensor reading
-        if (rLevel == 0 || rLevel > 1000000) {  // Check for invalid readings
-            Serial.println("Warning: Invalid sensor reading: " + String(rLevel));
-            displayPleaseLoadSample();
-            measureSampleJobTimer = millis();
-            return;
-        }
+// Samples from the warm-up are stale; start measuring fresh
+void startMeasuring() {
+    resetSampleQueue();
+    readingFilterReset(&readingFilter);
+#if IDLE_SLEEP_ENABLED
+    idleTimerReset(&idleTimer);
+#endif
+    bootPhaseStart(bootTrace, BOOT_PHASE_FIRST_READING, micros());
+    appState = STATE_MEASURE;
+}
 
-        long currentDelta = (long)rLevel - (long)unblockedValue;
+// Runs in the acquisition task, which owns the sensor
+unsigned long temperatureJobTimer = 0;
+void temperatureJob() {
+    if (appState != STATE_WARMUP) return;
+    if (millis() - temperatureJobTimer < WARMUP_BUCKET_MS) return;
+    temperatureJobTimer = millis();
 
-        if (currentDelta > (long)100) {
-            // Convert to smaller scale before passing to mapIRToAgtron
-            uint32_t scaledLevel = rLevel / 1000;
+    temperatureQueue.push(sensor.readTemperature());
+}
 
-            // Additional validation for scaled value
-            if (scaledLevel > 1000) {  // Sanity check for scaled value
-                Serial.println("Warning: Scaled value too high: " + String(scaledLevel));
-                displayPleaseLoadSample();
-                measureSampleJobTimer = millis();
-                return;
-            }
+// I2C bytes the display used over the last full second
+uint32_t displayBytesPerSecond = 0;
 
-            int calibratedAgtronLevel = mapIRToAgtron(scaledLevel);
+unsigned long displayRateJobTimer = millis();
+uint32_t displayRateBytesStart = 0;
+void displayRateJob() {
+    if (millis() - displayRateJobTimer < 1000) return;
+    displayRateJobTimer = millis();
 
-            // Validate Agtron result (typical range 0-350)
-            if (calibratedAgtronLevel < 0 || calibratedAgtronLevel > 350) {
-                Serial.println("Warning: Agtron value out of range: " + String(calibratedAgtronLevel));
-                displayPleaseLoadSample();
-                measureSampleJobTimer = millis();
-                return;
-            }
+    uint32_t bytesSent = display.bytesSent();
+    displayBytesPerSecond = bytesSent - displayRateBytesStart;
+    displayRateBytesStart = bytesSent;
+}
+
+void measureSampleJob() {
+    SensorSample batch[SAMPLE_QUEUE_SIZE];
+    uint8_t count = drainSampleQueue(batch, SAMPLE_QUEUE_SIZE);
+
+    // No new FIFO output since the last tick: keep the current screen
+    if (count == 0) return;
+
+    uint32_t measureStart = perfStart();
+    MeasureResult result = evaluateSampleBatch(&readingFilter, batch, count);
+    perfEnd(PERF_STAGE_MEASURE, measureStart);
+    perfCountResult(result.status);
+    if (!bootTrace->ended[BOOT_PHASE_FIRST_READING]) {
+        bootPhaseEnd(bootTrace, BOOT_PHASE_FIRST_READING, micros());
+    }
+
+    uint32_t displayStart = perfStart();
+    switch (result.status) {
+    case MEASURE_OK:
+        display.showMeasurement(result.agtron, result.stable);
+        break;
+
+    case MEASURE_INVALID_READING:
+    case MEASURE_SCALED_TOO_HIGH:
+    case MEASURE_AGTRON_OUT_OF_RANGE:
+    case MEASURE_NO_SAMPLE:
+        display.showPleaseLoadSample();
+        break;
+    }
+    perfEnd(PERF_STAGE_DISPLAY, displayStart);
 
-            displayMeasurement(calibratedAgtronLevel);
 #if DEBUG_LOGGING_ENABLED
-            logMeasurement(millis(), rLevel, calibratedAgtronLevel);
+    if (result.status == MEASURE_OK) {
+        logQueue.push(result);  // Counts a drop when full; TASK STATUS reports it
+    }
 #endif
 
-            Serial.println("real:" + String(rLevel));
-            Serial.println("agtron:" + String(calibratedAgtronLevel));
-            Serial.println("===========================");
-        } else {
-            displayPleaseLoadSample();
-        }
+    uint32_t telemetryStart = perfStart();
+    telemetryJob(batch, count, result);
+    perfEnd(PERF_STAGE_TELEMETRY, telemetryStart);
+
+#if DEBUG_SERIAL_COMMANDS
+    lastStableLevel = result.stable ? result.rLevel / 1000 : 0;
+#endif
 
-        measureSampleJobTimer = millis();
+#if IDLE_SLEEP_ENABLED
+    // A host on the serial port keeps the meter awake, as it does for light sleep
+    if (idleTimerUpdate(&idleTimer, result.status, millis()) && !Serial) {
+        appState = STATE_SLEEP;
     }
+#endif
 }
 
-void displayPleaseLoadSample() {
-    if (!oledAvailable) {
-        Serial.println("Display: Please load sample!");
-        return;
-    }
+#if IDLE_SLEEP_ENABLED
+// Runs in the acquisition task, which owns the sensor: back to the
+// calibration configuration, armed for the proximity wake, and no more
+// reads before the deep sleep
+void parkSensor() {
+    setupParticleSensor();
+    sensor.armProximityWake(ledBrightness, proximityThreshold(unblockedValue));
+    sensorParked = true;
+    xTaskNotifyGive(uiTaskHandle);
+    vTaskSuspend(NULL);
+}
+#endif
 
-    oled.clearDisplay();
+// Runs in the UI task, which owns the display, once the sensor is parked
+void sleepJob() {
+#if IDLE_SLEEP_ENABLED
+    if (!sensorParked) return;
 
-#if SCREEN_HEIGHT <= 48
-    // 64x48 (0.66" OLED)
-    // Text size 1 = 8px tall, 3 lines = 24px + spacing ~30px
-    // Center in 48px visible area, apply Y offset
-    oled.setTextSize(1);
-    oled.setCursor(4, 8 + DISPLAY_Y_OFFSET);
-    oled.println("Load");
-    oled.println("sample!");
+    Serial.printf("No cup for %d s, sleeping until one is placed\n", IDLE_SLEEP_SECONDS);
+#if DEBUG_LOGGING_ENABLED
+    // Never given back, so the storage task cannot write after the capture
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    flushLogBuffer();
+#endif
+    retainState(&retainedState, warmupResult);
+    display.powerDown();
+    Serial.flush();
+
+    // The light-sleep timer would end the deep sleep after a second. INT
+    // stays low while a cup is in front of the sensor, so one placed since
+    // parking wakes the chip at once.
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+#if SOC_PM_SUPPORT_EXT_WAKEUP
+    rtc_gpio_pullup_en((gpio_num_t)SENSOR_INT_PIN);
+    rtc_gpio_pulldown_dis((gpio_num_t)SENSOR_INT_PIN);
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)SENSOR_INT_PIN, 0);
 #else
-    // 128x64 (0.96" OLED)
-    oled.setCursor(0, 0);
-    oled.setTextSize(2);
-    oled.println("Please ");
-    oled.println("load ");
-    oled.println("sample! ");
+    esp_deep_sleep_enable_gpio_wakeup(1ULL << SENSOR_INT_PIN, ESP_GPIO_WAKEUP_GPIO_LOW);
+#endif
+    esp_deep_sleep_start();
 #endif
-
-    oled.display();
 }
 
-void drawMyCenterString(const String &buf){
-    int16_t x1, y1;
-    uint16_t w, h;
-    oled.getTextBounds(buf, 0, 0, &x1, &y1, &w, &h);
-    // Center horizontally and vertically
-    // y1 is negative offset from cursor to top of text
-    int x = (SCREEN_WIDTH - w) / 2 - x1;
-    int y = (SCREEN_HEIGHT - h) / 2 - y1;
-    oled.setCursor(x, y);
-    oled.print(buf);
+// Preallocated, the UI task prints a result every MEASURE_INTERVAL_MS
+static char telemetryText[TELEMETRY_TEXT_SIZE];
+#if DEBUG_SERIAL_COMMANDS
+static uint8_t telemetryFrame[sizeof(DumpFrameHeader) + SAMPLE_QUEUE_SIZE * sizeof(TelemetrySample) + 4];
+static uint16_t telemetryFrameLength = 0;
+static uint32_t telemetryFrameCount = 0;
+
+// Collects a whole frame so it reaches Serial in one write, not split by
+// console output from another task
+static void appendTelemetryFrame(const uint8_t *data, size_t len) {
+    memcpy(telemetryFrame + telemetryFrameLength, data, len);
+    telemetryFrameLength += len;
 }
+#endif
 
-void displayMeasurement(int agtronLevel) {
-    if (!oledAvailable) {
-        Serial.println("Display: Agtron Level = " + String(agtronLevel));
+void telemetryJob(const SensorSample *batch, uint8_t count, const MeasureResult &result) {
+#if DEBUG_SERIAL_COMMANDS
+    if (telemetryMode == TELEMETRY_OFF) return;
+    if (telemetryMode == TELEMETRY_BINARY) {
+        TelemetrySample samples[SAMPLE_QUEUE_SIZE];
+        uint16_t length = buildTelemetrySamples(samples, batch, count, result);
+        telemetryFrameLength = 0;
+        writeDumpFrame(appendTelemetryFrame, DUMP_FRAME_TELEMETRY, telemetryFrameCount++, samples, length);
+        Serial.write(telemetryFrame, telemetryFrameLength);
         return;
     }
-
-    oled.clearDisplay();
-
-    String agtronLevelText = String(agtronLevel);
-#if SCREEN_HEIGHT <= 48
-    // 64x48 (0.66" OLED)
-    oled.setTextSize(2);
-    // Size 2: 12px wide per char, 16px tall
-    int charWidth = 12;
-    int textWidth = agtronLevelText.length() * charWidth;
-    int xPos = (SCREEN_WIDTH - textWidth) / 2;
-    int yPos = (SCREEN_HEIGHT - 16) / 2 + DISPLAY_Y_OFFSET;
-    oled.setCursor(xPos > 0 ? xPos : 0, yPos);
-    oled.print(agtronLevelText);
-    // Debug output
-    Serial.printf("64x48 display: x=%d y=%d (offset=%d) text='%s'\n", xPos, yPos, DISPLAY_Y_OFFSET, agtronLevelText.c_str());
-#elif SCREEN_WIDTH <= 64
-    // 64x64 - use size 2
-    oled.setTextSize(2);
-    drawMyCenterString(agtronLevelText);
 #else
-    // 128x64 (0.96" OLED)
-    oled.setTextSize(3);
-    drawMyCenterString(agtronLevelText);
+    (void)batch;
+    (void)count;
 #endif
+    // Rejected batches arrive every tick while no cup is loaded; PERF STATUS
+    // counts them (where built in) instead of a warning line each
+    if (result.status != MEASURE_OK) return;
 
-    oled.display();
+    uint16_t length = formatMeasurementText(telemetryText, sizeof(telemetryText), result);
+    if (length > 0) {
+        Serial.write((const uint8_t*)telemetryText, length);
+    }
 }
 
-
 // -- End Sub Routines --
 
-// -- Utility Functions --
-
-int mapIRToAgtron(uint32_t x) {
-    // Convert to int for calculation (x is already scaled down by /1000)
-    int scaledX = (int)x;
-    // Use float for intermediate calculations to avoid overflow
-    float result = scaledX - (intersectionPoint - scaledX) * deviation;
-    return round(result);
-    //return round(intersectionPoint - (x - intersectionPoint) * deviation);
-} 
-
-// -- End Utility Functions --
-
 // -- Debug Logging Functions --
 
 #if DEBUG_LOGGING_ENABLED
-void setupDebugLog() {
+// resumeFrom: position retained through deep sleep, NULL to scan the log
+void setupLogStorage(const LogPosition *resumeFrom) {
     Serial.println(F("Initializing debug log..."));
 
-    if (!LittleFS.begin(true)) {  // true = format if mount fails
-        Serial.println(F("ERROR: LittleFS mount failed"));
+    LogOpenStatus opened = resumeFrom ? resumeDebugLog(logStorage, *resumeFrom) : setupDebugLog(logStorage);
+    switch (opened) {
+    case LOG_OPEN_MOUNT_FAILED:
+        Serial.println(F("ERROR: logdata partition not found"));
         return;
+    case LOG_OPEN_CREATE_FAILED:
+        Serial.println(F("ERROR: Cannot start log page"));
+        return;
+    case LOG_OPEN_CREATED:
+        Serial.println(F("Log created"));
+        break;
+    case LOG_OPEN_RECOVERED:
+        Serial.println(F("WARNING: Torn log block skipped after power loss"));
+        // Fall through
+    case LOG_OPEN_LOADED: {
+        LogStatus status = getLogStatus();
+        Serial.printf("Log loaded: %lu entries, wrapped=%d\n",
+                      status.storedEntries, status.wrapped);
+        break;
+    }
     }
-    Serial.println(F("LittleFS mounted"));
+}
+#endif
 
-    File file = LittleFS.open(LOG_FILE_PATH, "r+");
-    if (!file) {
-        // File doesn't exist, create it
-        Serial.println(F("Creating new log file..."));
-        file = LittleFS.open(LOG_FILE_PATH, "w+");
-        if (!file) {
-            Serial.println(F("ERROR: Cannot create log file"));
-            return;
-        }
+// -- End Debug Logging Functions --
 
-        // Initialize header
-        memset(&logHeader, 0, sizeof(LogHeader));
-        logHeader.magic = LOG_MAGIC;
-        logHeader.version = LOG_VERSION;
-        logHeader.writePosition = 0;
-        logHeader.entryCount = 0;
-        logHeader.wrapped = 0;
+// -- Debug Serial Commands --
 
-        file.write((uint8_t*)&logHeader, sizeof(LogHeader));
-        file.close();
+#if DEBUG_SERIAL_COMMANDS
+static void commandLogSessions(const CommandArgs &) { printLogSessions(); }
+static void commandLogDumpLast(const CommandArgs &) { dumpLogSession(true, 0); }
+static void commandLogClear(const CommandArgs &) { clearLog(); }
+static void commandLogStatus(const CommandArgs &) { printLogStatus(); }
+static void commandDisplayStatus(const CommandArgs &) { printDisplayStatus(); }
+static void commandTaskStatus(const CommandArgs &) { printTaskStatus(); }
+static void commandBootTimes(const CommandArgs &) { printBootTimes(); }
+#if PERF_COUNTERS_ENABLED
+static void commandPerfStatus(const CommandArgs &) { printPerfStatus(); }
+static void commandPerfReset(const CommandArgs &) { resetPerfCounters(); }
+#endif
+static void commandCalClear(const CommandArgs &) { clearCalibration(); }
+static void commandCalList(const CommandArgs &) { printCalibration(); }
+static void commandHelp(const CommandArgs &) { printHelp(); }
+
+static void commandLogDump(const CommandArgs &args) {
+    uint32_t first;
+    uint32_t count;
+    if (args.count == 0) {
+        dumpLogToSerial();
+    } else if (args.count == 2 && commandArgUInt(args, 0, &first) && commandArgUInt(args, 1, &count)) {
+        dumpLogRange(first, count);
+    } else {
+        Serial.println(F("LOG DUMP: Usage LOG DUMP [<from> <count>]"));
+    }
+}
 
-        Serial.println(F("Log file created"));
+static void commandLogDumpSession(const CommandArgs &args) {
+    uint32_t session;
+    if (args.count == 1 && commandArgUInt(args, 0, &session)) {
+        dumpLogSession(false, session);
     } else {
-        // Read existing header
-        file.read((uint8_t*)&logHeader, sizeof(LogHeader));
-        file.close();
-
-        // Validate header
-        if (logHeader.magic != LOG_MAGIC || logHeader.version != LOG_VERSION) {
-            Serial.println(F("WARNING: Log corrupted, reinitializing..."));
-            LittleFS.remove(LOG_FILE_PATH);
-            setupDebugLog();  // Recursive call to create fresh
-            return;
+        Serial.println(F("LOG DUMP SESSION: Usage LOG DUMP SESSION <n>"));
+    }
+}
+
+static void commandLogDumpBin(const CommandArgs &args) {
+    uint32_t sequence;
+    if (args.count == 0) {
+        dumpLogBinary(false, 0);
+    } else if (commandArgUInt(args, 0, &sequence)) {
+        dumpLogBinary(true, sequence);
+    } else {
+        Serial.println(F("LOG DUMP BIN: Usage LOG DUMP BIN [sequence]"));
+    }
+}
+
+// Longest name wins, so "LOG DUMP BIN" is not taken for "LOG DUMP"
+static const CommandEntry commandTable[] = {
+    {"LOG DUMP", "[<from> <count>]", commandLogDump},
+    {"LOG DUMP LAST", "", commandLogDumpLast},
+    {"LOG DUMP SESSION", "<n>", commandLogDumpSession},
+    {"LOG SESSIONS", "", commandLogSessions},
+    {"LOG DUMP BIN", "[sequence]", commandLogDumpBin},
+    {"LOG CLEAR", "", commandLogClear},
+    {"LOG STATUS", "", commandLogStatus},
+    {"DISPLAY STATUS", "", commandDisplayStatus},
+    {"TASK STATUS", "", commandTaskStatus},
+    {"BOOT TIMES", "", commandBootTimes},
+#if PERF_COUNTERS_ENABLED
+    {"PERF STATUS", "", commandPerfStatus},
+    {"PERF RESET", "", commandPerfReset},
+#endif
+    {"CAL ADD", "[level] <agtron>", addCalibrationPoint},
+    {"CAL CLEAR", "", commandCalClear},
+    {"CAL LIST", "", commandCalList},
+    {"TELEMETRY", "<TEXT|BIN|OFF>", setTelemetryMode},
+    {"MODE", "[IR|RATIO]", setMeasureMode},
+    {"HELP", "", commandHelp},
+};
+
+static CommandLine consoleLine;
+
+// Takes only the bytes that have already arrived; a partial line waits in
+// consoleLine for the next call, so the console task never blocks on input
+void handleSerialCommands() {
+    while (Serial.available() > 0) {
+        CommandFeedResult fed = commandLineFeed(&consoleLine, (char)Serial.read());
+        if (fed == COMMAND_TOO_LONG) {
+            Serial.printf("Command too long (max %d characters)\n", COMMAND_LINE_SIZE - 1);
+            continue;
         }
+        if (fed != COMMAND_READY) continue;
 
-        Serial.printf("Log loaded: %lu entries, wrapped=%d\n",
-                      logHeader.entryCount, logHeader.wrapped);
+#if DEBUG_LOGGING_ENABLED
+        // Keep the storage task off the log while a command reads or resets it
+        xSemaphoreTake(logMutex, portMAX_DELAY);
+#endif
+
+        CommandDispatchResult result = dispatchCommand(commandTable,
+            sizeof(commandTable) / sizeof(commandTable[0]), consoleLine.buffer);
+
+#if DEBUG_LOGGING_ENABLED
+        xSemaphoreGive(logMutex);
+#endif
+
+        if (result == COMMAND_UNKNOWN) {
+            // The line is split in place, buffer now ends after the first word
+            Serial.printf("Unknown command: %s (HELP lists commands)\n", consoleLine.buffer);
+        }
     }
+}
 
-    logFileOpen = true;
-    logBufferCount = 0;
-    lastLogFlush = millis();
+void printHelp() {
+    Serial.println(F("=== ROAST METER COMMANDS ==="));
+    for (size_t i = 0; i < sizeof(commandTable) / sizeof(commandTable[0]); i++) {
+        Serial.printf("%s %s\n", commandTable[i].name, commandTable[i].usage);
+    }
 }
 
-void logMeasurement(uint32_t timestamp, uint32_t rawIR, int16_t agtron) {
-    if (!logFileOpen) return;
+#if DEBUG_LOGGING_ENABLED
+static void printLogEntryCsv(const LogEntry &entry, uint32_t index) {
+    // Events are comment lines so the CSV columns stay measurement-only
+    if (entry.flags & LOG_FLAG_WARMUP) {
+        Serial.printf("# warmup timestamp_ms=%lu duration_ms=%lu reason=%s\n",
+                      entry.timestamp, entry.rawIR,
+                      entry.agtron == LOG_WARMUP_STABLE ? "stable" : "timeout");
+        return;
+    }
 
-    // Flush first if buffer is full (ensures space for new entry)
-    if (logBufferCount >= LOG_BUFFER_SIZE) {
-        flushLogBuffer();
+    // Deviation printed from its milli-units, same text as %.3f without float
+    Serial.printf("%lu,%lu,%d,%d,%d,%u.%03u\n",
+                  entry.timestamp,
+                  entry.rawIR,
+                  entry.agtron,
+                  entry.ledBrightness,
+                  entry.intersectPt,
+                  entry.deviationX1000 / 1000,
+                  entry.deviationX1000 % 1000);
+
+    // Yield to prevent watchdog timeout on large dumps
+    if (index % 100 == 0) {
+        yield();
     }
+}
+#endif
 
-    // Only add if there's space (handles case where flush failed)
-    if (logBufferCount >= LOG_BUFFER_SIZE) {
-        Serial.println(F("WARNING: Log buffer full, dropping entry"));
+void dumpLogToSerial() {
+#if DEBUG_LOGGING_ENABLED
+    if (!logReady) {
+        Serial.println(F("LOG DUMP: Logging not initialized"));
         return;
     }
 
-    // Create entry
-    LogEntry entry;
-    entry.timestamp = timestamp;
-    entry.rawIR = rawIR;
-    entry.agtron = agtron;
-    entry.ledBrightness = ledBrightness;
-    entry.intersectPt = (uint8_t)intersectionPoint;
-    entry.deviationX1000 = (uint16_t)(deviation * 1000);
-    entry.flags = 0;
+    // Flush any pending entries first
+    flushLogBuffer();
+
+    LogStatus status = getLogStatus();
+
+    Serial.println(F("=== ROAST METER LOG DUMP ==="));
+    Serial.printf("ENTRIES: %lu\n", status.storedEntries);
+    Serial.printf("WRAPPED: %s\n", status.wrapped ? "YES" : "NO");
+    Serial.println(F("--- BEGIN CSV ---"));
+    Serial.println(F("timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation"));
+
+    if (!forEachLogEntry(printLogEntryCsv)) {
+        Serial.println(F("LOG DUMP: Cannot read log"));
+    }
 
-    // Add to buffer
-    logBuffer[logBufferCount++] = entry;
-    lastMeasurementTime = millis();
+    Serial.println(F("--- END CSV ---"));
+#else
+    Serial.println(F("LOG DUMP: Logging disabled at compile time"));
+#endif
 }
 
-void flushLogBuffer() {
-    if (!logFileOpen || logBufferCount == 0) return;
+#if DEBUG_LOGGING_ENABLED
+// Entries first .. first + count - 1, framed like the full dump; only the
+// pages holding them are read
+static void dumpLogEntries(uint32_t first, uint32_t count) {
+    Serial.println(F("=== ROAST METER LOG DUMP ==="));
+    Serial.printf("RANGE: %lu +%lu\n", first, count);
+    Serial.println(F("--- BEGIN CSV ---"));
+    Serial.println(F("timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation"));
+
+    if (!forEachLogEntryInRange(first, count, printLogEntryCsv)) {
+        Serial.println(F("LOG DUMP: No stored entries in range"));
+    }
 
-    File file = LittleFS.open(LOG_FILE_PATH, "r+");
-    if (!file) {
-        Serial.println(F("ERROR: Cannot open log for write"));
+    Serial.println(F("--- END CSV ---"));
+}
+#endif
+
+void dumpLogRange(uint32_t first, uint32_t count) {
+#if DEBUG_LOGGING_ENABLED
+    if (!logReady) {
+        Serial.println(F("LOG DUMP: Logging not initialized"));
         return;
     }
 
-    // Write each buffered entry
-    for (uint8_t i = 0; i < logBufferCount; i++) {
-        // Calculate file position: header + (writePosition * entrySize)
-        uint32_t pos = sizeof(LogHeader) + (logHeader.writePosition * sizeof(LogEntry));
-        file.seek(pos);
-        file.write((uint8_t*)&logBuffer[i], sizeof(LogEntry));
+    flushLogBuffer();
+    dumpLogEntries(first, count);
+#else
+    Serial.println(F("LOG DUMP: Logging disabled at compile time"));
+#endif
+}
 
-        // Update write position (circular)
-        logHeader.writePosition++;
-        if (logHeader.writePosition >= LOG_MAX_ENTRIES) {
-            logHeader.writePosition = 0;
-            logHeader.wrapped = 1;
-        }
-        logHeader.entryCount++;
+void dumpLogSession(bool last, uint32_t session) {
+#if DEBUG_LOGGING_ENABLED
+    if (!logReady) {
+        Serial.println(F("LOG DUMP: Logging not initialized"));
+        return;
+    }
+
+    flushLogBuffer();
+    if (last) {
+        session = lastLogSession();
     }
 
-    // Update header
-    file.seek(0);
-    file.write((uint8_t*)&logHeader, sizeof(LogHeader));
-    file.close();
+    LogSessionInfo info;
+    if (!findLogSession(session, &info)) {
+        Serial.printf("LOG DUMP: Session %lu has no stored entries\n", session);
+        return;
+    }
+    Serial.printf("SESSION: %lu\n", session);
+    dumpLogEntries(info.firstEntry, info.entries);
+#else
+    Serial.println(F("LOG DUMP: Logging disabled at compile time"));
+#endif
+}
 
-    logBufferCount = 0;
-    lastLogFlush = millis();
+#if DEBUG_LOGGING_ENABLED
+static void printLogSessionRow(const LogSessionInfo &info) {
+    Serial.printf("%lu,%lu,%lu,%lu,%u\n",
+                  info.session, info.firstEntry, info.entries, info.firstSequence, info.pages);
 }
 #endif
 
-// -- End Debug Logging Functions --
+void printLogSessions() {
+#if DEBUG_LOGGING_ENABLED
+    if (!logReady) {
+        Serial.println(F("LOG SESSIONS: Logging not initialized"));
+        return;
+    }
 
-// -- Debug Serial Commands --
+    flushLogBuffer();
 
-#if DEBUG_SERIAL_COMMANDS
-void handleSerialCommands() {
-    if (!Serial.available()) return;
+    Serial.println(F("=== ROAST METER LOG SESSIONS ==="));
+    Serial.printf("Current session: %lu\n", getLogStatus().session);
+    Serial.println(F("session,first_entry,entries,first_page,pages"));
+    forEachLogSession(printLogSessionRow);
+#else
+    Serial.println(F("LOG SESSIONS: Logging disabled at compile time"));
+#endif
+}
 
-    String cmd = Serial.readStringUntil('\n');
-    cmd.trim();
-    cmd.toUpperCase();
+#if DEBUG_LOGGING_ENABLED
+static void writeSerialBytes(const uint8_t *data, size_t len) {
+    Serial.write(data, len);
+}
 
-    if (cmd == "LOG DUMP") {
-        dumpLogToSerial();
-    } else if (cmd == "LOG CLEAR") {
-        clearLog();
-    } else if (cmd == "LOG STATUS") {
-        printLogStatus();
+static uint8_t dumpPageBuffer[LOG_PAGE_SIZE];
+
+static void sendLogPageFrame(uint32_t sequence) {
+    uint16_t used;
+    if (readLogPage(sequence, dumpPageBuffer, &used)) {
+        writeDumpFrame(writeSerialBytes, DUMP_FRAME_PAGE, sequence, dumpPageBuffer, used);
+    } else {
+        writeDumpFrame(writeSerialBytes, DUMP_FRAME_MISSING, sequence, NULL, 0);
     }
 }
+#endif
 
-void dumpLogToSerial() {
+// Framed raw-page dump for tools/capture_log.py (see dump_frame.h).
+// Whole pages go out in single writes, which the native USB CDC on the
+// S2 and C3 moves at full USB speed instead of the 115200 baud text rate.
+void dumpLogBinary(bool singlePage, uint32_t sequence) {
 #if DEBUG_LOGGING_ENABLED
-    if (!logFileOpen) {
+    if (!logReady) {
         Serial.println(F("LOG DUMP: Logging not initialized"));
         return;
     }
 
-    // Flush any pending entries first
-    flushLogBuffer();
-
-    File file = LittleFS.open(LOG_FILE_PATH, "r");
-    if (!file) {
-        Serial.println(F("LOG DUMP: Cannot open log file"));
+    if (singlePage) {
+        sendLogPageFrame(sequence);
+        Serial.flush();
         return;
     }
 
-    // Re-read header (in case it changed)
-    file.read((uint8_t*)&logHeader, sizeof(LogHeader));
-
-    uint32_t entriesToRead = logHeader.wrapped ? LOG_MAX_ENTRIES : logHeader.writePosition;
-    uint32_t startPos = logHeader.wrapped ? logHeader.writePosition : 0;
-
-    Serial.println(F("=== ROAST METER LOG DUMP ==="));
-    Serial.printf("ENTRIES: %lu\n", entriesToRead);
-    Serial.printf("WRAPPED: %s\n", logHeader.wrapped ? "YES" : "NO");
-    Serial.println(F("--- BEGIN CSV ---"));
-    Serial.println(F("timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation"));
+    flushLogBuffer();
 
-    LogEntry entry;
-    for (uint32_t i = 0; i < entriesToRead; i++) {
-        uint32_t idx = (startPos + i) % LOG_MAX_ENTRIES;
-        uint32_t pos = sizeof(LogHeader) + (idx * sizeof(LogEntry));
-        file.seek(pos);
-        file.read((uint8_t*)&entry, sizeof(LogEntry));
-
-        Serial.printf("%lu,%lu,%d,%d,%d,%.3f\n",
-                      entry.timestamp,
-                      entry.rawIR,
-                      entry.agtron,
-                      entry.ledBrightness,
-                      entry.intersectPt,
-                      entry.deviationX1000 / 1000.0f);
-
-        // Yield to prevent watchdog timeout on large dumps
-        if (i % 100 == 0) {
-            yield();
-        }
+    LogStatus status = getLogStatus();
+    DumpBeginInfo info;
+    info.firstSequence = status.oldestSequence;
+    info.pageCount = status.pagesUsed;
+    info.pageSize = LOG_PAGE_SIZE;
+    info.storedEntries = status.storedEntries;
+    info.wrapped = status.wrapped ? 1 : 0;
+    writeDumpFrame(writeSerialBytes, DUMP_FRAME_BEGIN, 0, &info, sizeof(info));
+
+    for (uint16_t i = 0; i < status.pagesUsed; i++) {
+        sendLogPageFrame(status.oldestSequence + i);
+        yield();
     }
 
-    Serial.println(F("--- END CSV ---"));
-    file.close();
+    writeDumpFrame(writeSerialBytes, DUMP_FRAME_END, status.oldestSequence + status.pagesUsed, NULL, 0);
+    Serial.flush();
 #else
     Serial.println(F("LOG DUMP: Logging disabled at compile time"));
 #endif
@@ -739,26 +1104,12 @@ void dumpLogToSerial() {
 
 void clearLog() {
 #if DEBUG_LOGGING_ENABLED
-    if (!logFileOpen) {
+    if (!logReady) {
         Serial.println(F("LOG CLEAR: Logging not initialized"));
         return;
     }
 
-    // Reset header
-    logHeader.writePosition = 0;
-    logHeader.entryCount = 0;
-    logHeader.wrapped = 0;
-
-    // Write header to file
-    File file = LittleFS.open(LOG_FILE_PATH, "r+");
-    if (file) {
-        file.seek(0);
-        file.write((uint8_t*)&logHeader, sizeof(LogHeader));
-        file.close();
-    }
-
-    // Clear buffer
-    logBufferCount = 0;
+    resetLog();
 
     Serial.println(F("LOG CLEAR: Log cleared successfully"));
 #else
@@ -768,24 +1119,234 @@ void clearLog() {
 
 void printLogStatus() {
 #if DEBUG_LOGGING_ENABLED
-    if (!logFileOpen) {
+    if (!logReady) {
         Serial.println(F("LOG STATUS: Logging not initialized"));
         return;
     }
 
+    LogStatus status = getLogStatus();
+
     Serial.println(F("=== ROAST METER LOG STATUS ==="));
-    Serial.printf("Entries logged: %lu\n", logHeader.entryCount);
-    Serial.printf("Current position: %lu / %d\n", logHeader.writePosition, LOG_MAX_ENTRIES);
-    Serial.printf("Wrapped: %s\n", logHeader.wrapped ? "YES" : "NO");
+    Serial.printf("Entries logged: %lu\n", status.entryCount);
+    Serial.printf("Entries stored: %lu\n", status.storedEntries);
+    Serial.printf("Session: %lu\n", status.session);
+    Serial.printf("Current page: %u / %u (seq %lu)\n", status.currentPage, status.pageCount, status.pageSequence);
+    Serial.printf("Wrapped: %s\n", status.wrapped ? "YES" : "NO");
     Serial.printf("Buffer pending: %d\n", logBufferCount);
 
-    uint32_t usedEntries = logHeader.wrapped ? LOG_MAX_ENTRIES : logHeader.writePosition;
-    float capacityPct = (usedEntries * 100.0f) / LOG_MAX_ENTRIES;
+    float capacityPct = (status.pagesUsed * 100.0f) / status.pageCount;
     Serial.printf("Capacity used: %.1f%%\n", capacityPct);
 #else
     Serial.println(F("LOG STATUS: Logging disabled at compile time"));
 #endif
 }
+
+void printDisplayStatus() {
+    Serial.println(F("=== ROAST METER DISPLAY STATUS ==="));
+    Serial.printf("I2C bytes/s: %lu\n", displayBytesPerSecond);
+    Serial.printf("I2C bytes total: %lu\n", display.bytesSent());
+}
+
+static void printQueueStatus(const char *name, uint16_t depth, uint16_t capacity,
+                             uint16_t highWater, uint32_t dropped) {
+    Serial.printf("%s queue: %u / %u (high water %u, dropped %lu)\n",
+                  name, depth, capacity, highWater, dropped);
+}
+
+void printTaskStatus() {
+    Serial.println(F("=== ROAST METER TASK STATUS ==="));
+    printQueueStatus("Sample", sampleQueue.depth(), sampleQueue.capacity(),
+                     sampleQueue.highWaterMark(), sampleQueue.droppedCount());
+#if DEBUG_LOGGING_ENABLED
+    printQueueStatus("Log", logQueue.depth(), logQueue.capacity(),
+                     logQueue.highWaterMark(), logQueue.droppedCount());
+#endif
+
+    // Unused stack (bytes) of each task
+    Serial.printf("Stack free: acquisition %u, ui %u",
+                  uxTaskGetStackHighWaterMark(acquisitionTaskHandle),
+                  uxTaskGetStackHighWaterMark(uiTaskHandle));
+#if DEBUG_LOGGING_ENABLED
+    Serial.printf(", storage %u", uxTaskGetStackHighWaterMark(storageTaskHandle));
+#endif
+    Serial.printf(", console %u\n", uxTaskGetStackHighWaterMark(consoleTaskHandle));
+
+    SensorFifoStats fifo = sensor.fifoStats();
+    Serial.printf("Sensor FIFO: %lu overflows, %lu samples lost\n", fifo.overflows, fifo.samplesLost);
+    Serial.printf("I2C bus: %lu sensor transactions, %lu waited (max %lu us), %lu display transactions\n",
+                  i2cBus.sensorLocks, i2cBus.sensorWaits, i2cBus.sensorWaitMaxUs, i2cBus.displayLocks);
+}
+
+static void printBootTrace(const char *label, const BootTrace *trace) {
+    Serial.printf("%s\n", label);
+    Serial.println(F("phase,start_us,end_us,duration_us"));
+    for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (!trace->started[i]) continue;
+        if (trace->ended[i]) {
+            Serial.printf("%s,%lu,%lu,%lu\n", bootPhaseName((BootPhase)i), trace->startUs[i],
+                          trace->endUs[i], trace->endUs[i] - trace->startUs[i]);
+        } else {
+            Serial.printf("%s,%lu,,\n", bootPhaseName((BootPhase)i), trace->startUs[i]);
+        }
+    }
+}
+
+// Microseconds since the chip started; phases of one boot overlap where
+// they run in different tasks
+void printBootTimes() {
+    Serial.println(F("=== ROAST METER BOOT TIMES ==="));
+    printBootTrace("Cold boot:", &coldBootTrace);
+#if IDLE_SLEEP_ENABLED
+    if (bootTrace == &wakeBootTrace) {
+        printBootTrace("Proximity wake:", &wakeBootTrace);
+    }
+#endif
+}
+
+#if PERF_COUNTERS_ENABLED
+static const char *const measureStatusNames[PERF_MEASURE_STATUS_COUNT] = {
+    "ok", "no_sample", "invalid_reading", "scaled_too_high", "agtron_out_of_range"
+};
+
+static uint32_t perfResetMillis = 0;
+void resetPerfCounters() {
+    perfReset(getCpuFrequencyMhz());
+    perfResetMillis = millis();
+}
+
+// Stage durations in microseconds; loops are the interval between two
+// iterations, and their max - min is the jitter. The heap low-water mark
+// is kept by the allocator since boot and survives PERF RESET.
+void printPerfStatus() {
+    Serial.println(F("=== ROAST METER PERF STATUS ==="));
+    Serial.printf("Since reset: %lu ms\n", millis() - perfResetMillis);
+
+    Serial.print(F("stage,count,min_us,max_us,mean_us"));
+    for (uint8_t b = 0; b < PERF_HISTOGRAM_BUCKETS; b++) {
+        uint32_t limit = perfBucketLimitUs(b);
+        if (limit > 0) {
+            Serial.printf(",lt_%lu", limit);
+        } else {
+            Serial.printf(",ge_%lu", perfBucketLimitUs(b - 1));
+        }
+    }
+    Serial.println();
+    for (uint8_t i = 0; i < PERF_STAGE_COUNT; i++) {
+        const PerfStats *stats = perfStats((PerfStage)i);
+        uint32_t mean = stats->count > 0 ? (uint32_t)(stats->totalUs / stats->count) : 0;
+        Serial.printf("%s,%lu,%lu,%lu,%lu", perfStageName((PerfStage)i),
+                      stats->count, stats->minUs, stats->maxUs, mean);
+        for (uint8_t b = 0; b < PERF_HISTOGRAM_BUCKETS; b++) {
+            Serial.printf(",%lu", stats->histogram[b]);
+        }
+        Serial.println();
+    }
+
+    const PerfStats *acquisition = perfStats(PERF_LOOP_ACQUISITION);
+    const PerfStats *ui = perfStats(PERF_LOOP_UI);
+    Serial.printf("Loop jitter: acquisition %lu us, ui %lu us\n",
+                  acquisition->count > 0 ? acquisition->maxUs - acquisition->minUs : 0,
+                  ui->count > 0 ? ui->maxUs - ui->minUs : 0);
+
+    Serial.print(F("Results:"));
+    for (uint8_t i = 0; i < PERF_MEASURE_STATUS_COUNT; i++) {
+        Serial.printf(" %s %lu", measureStatusNames[i], perfResultCount((MeasureStatus)i));
+    }
+    Serial.println();
+
+    Serial.printf("Free heap: %lu bytes (low water %lu since boot)\n",
+                  (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap());
+}
+#endif
+
+// CAL ADD <agtron> pairs the current locked reading with the reference
+// value; CAL ADD <level> <agtron> enters a known pair directly
+void addCalibrationPoint(const CommandArgs &args) {
+    int32_t level;
+    int32_t agtron;
+    bool parsed = args.count == 2 ? commandArgInt(args, 0, &level) && commandArgInt(args, 1, &agtron)
+                                  : args.count == 1 && commandArgInt(args, 0, &agtron);
+    if (!parsed) {
+        Serial.println(F("CAL ADD: Usage CAL ADD [level] <agtron>"));
+        return;
+    }
+
+    if (args.count == 1) {
+        if (lastStableLevel == 0) {
+            Serial.println(F("CAL ADD: No locked reading - load the reference sample first"));
+            return;
+        }
+        level = lastStableLevel;
+    }
+
+    MeasureMode mode = measureMode;
+    Calibration *cal = calibrationFor(mode);
+    if (agtron < AGTRON_MIN || agtron > AGTRON_MAX || level < 0 || level > SCALED_LEVEL_MAX ||
+        !calibrationAddPoint(cal, (uint16_t)level, (int16_t)agtron)) {
+        Serial.printf("CAL ADD: Rejected (level 0-%d, agtron %d-%d, at most %d points)\n",
+                      SCALED_LEVEL_MAX, AGTRON_MIN, AGTRON_MAX, CAL_MAX_POINTS);
+        return;
+    }
+
+    if (!saveCalibration(preferences, mode)) {
+        Serial.println(F("CAL ADD: WARNING - point not saved"));
+    }
+    Serial.printf("CAL ADD: level %ld -> agtron %ld (%u points)\n", (long)level, (long)agtron, cal->count);
+}
+
+void clearCalibration() {
+    MeasureMode mode = measureMode;
+    calibrationReset(calibrationFor(mode));
+    saveCalibration(preferences, mode);
+    Serial.println(mode == MEASURE_MODE_RATIO ? F("CAL CLEAR: Back to the default ratio line")
+                                              : F("CAL CLEAR: Back to the intersection point / deviation formula"));
+}
+
+void printCalibration() {
+    const Calibration *cal = calibrationFor(measureMode);
+    Serial.println(F("=== ROAST METER CALIBRATION ==="));
+    Serial.printf("Mode: %s\n", measureMode == MEASURE_MODE_RATIO ? "RATIO" : "IR");
+    Serial.printf("Points: %u / %d%s\n", cal->count, CAL_MAX_POINTS,
+                  cal->count < 2 ? " (formula in use)" : "");
+    for (uint8_t i = 0; i < cal->count; i++) {
+        Serial.printf("  level %u -> agtron %d\n", cal->points[i].level, cal->points[i].agtron);
+    }
+}
+
+// TELEMETRY BIN streams every sample as DUMP_FRAME_TELEMETRY frames until
+// TELEMETRY TEXT or OFF; tools/telemetry.py switches the mode itself
+void setTelemetryMode(const CommandArgs &args) {
+    const char *mode = args.count == 1 ? args.values[0] : "";
+    if (strcmp(mode, "BIN") == 0) {
+        telemetryMode = TELEMETRY_BINARY;
+        Serial.println(F("TELEMETRY: Binary sample stream"));
+    } else if (strcmp(mode, "TEXT") == 0) {
+        telemetryMode = TELEMETRY_TEXT;
+        Serial.println(F("TELEMETRY: Text"));
+    } else if (strcmp(mode, "OFF") == 0) {
+        telemetryMode = TELEMETRY_OFF;
+        Serial.println(F("TELEMETRY: Off"));
+    } else {
+        Serial.println(F("TELEMETRY: Usage TELEMETRY <TEXT|BIN|OFF>"));
+    }
+}
+
+// MODE RATIO pairs the Red and IR slots; the acquisition task reconfigures
+// the sensor before its next read, and CAL works on the mode's own points
+void setMeasureMode(const CommandArgs &args) {
+    const char *mode = args.count == 1 ? args.values[0] : "";
+    if (strcmp(mode, "IR") == 0 || strcmp(mode, "RATIO") == 0) {
+        measureMode = strcmp(mode, "RATIO") == 0 ? MEASURE_MODE_RATIO : MEASURE_MODE_IR;
+        lastStableLevel = 0;  // A level of the other mode
+        if (!saveMeasureMode(preferences)) {
+            Serial.println(F("MODE: WARNING - mode not saved"));
+        }
+    } else if (args.count != 0) {
+        Serial.println(F("MODE: Usage MODE [IR|RATIO]"));
+        return;
+    }
+    Serial.printf("MODE: %s\n", measureMode == MEASURE_MODE_RATIO ? "RATIO (Red / IR)" : "IR");
+}
 #endif
 
 // -- End Debug Serial Commands --
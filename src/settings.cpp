@@ -0,0 +1,83 @@
+#include "settings.h"
+
+#include <stdio.h>
+
+#include "calibration.h"
+#include "measurement.h"
+
+static const char *calibrationCountKey(MeasureMode mode) {
+    return mode == MEASURE_MODE_RATIO ? PREF_RATIO_CAL_COUNT_KEY : PREF_CAL_COUNT_KEY;
+}
+
+static void calibrationPointKey(char *key, MeasureMode mode, uint8_t index) {
+    snprintf(key, 12, "%s%u", mode == MEASURE_MODE_RATIO ? PREF_RATIO_CAL_POINT_KEY : PREF_CAL_POINT_KEY, index);
+}
+
+static void loadCalibration(KeyValueStore &store, MeasureMode mode) {
+    Calibration *cal = calibrationFor(mode);
+    calibrationReset(cal);
+
+    uint8_t count = store.getUChar(calibrationCountKey(mode), 0);
+    if (count > CAL_MAX_POINTS) count = CAL_MAX_POINTS;
+
+    for (uint8_t i = 0; i < count; i++) {
+        char key[12];
+        calibrationPointKey(key, mode, i);
+        int32_t packed = store.getInt(key, -1);
+        if (packed < 0) continue;  // Missing point
+        calibrationAddPoint(cal, (uint16_t)(packed >> 16), (int16_t)(packed & 0xFFFF));
+    }
+}
+
+SettingsStatus loadSettings(KeyValueStore &store) {
+    SettingsStatus status = SETTINGS_LOADED;
+
+    store.begin(PREF_NAMESPACE);
+
+    if (store.getUChar(PREF_VALID_KEY, 0) != PREF_VALID_CODE) {
+        store.putUChar(PREF_VALID_KEY, PREF_VALID_CODE);
+        store.putUChar(PREF_LED_BRIGHTNESS_KEY, PREF_LED_BRIGHTNESS_DEFAULT);
+        store.putInt(PREF_INTERSECTION_POINT_KEY, PREF_INTERSECTION_POINT_DEFAULT);
+        store.putFloat(PREF_DEVIATION_KEY, PREF_DEVIATION_DEFAULT);
+        status = SETTINGS_INITIALIZED;
+    }
+
+    if (store.getUChar(PREF_VALID_KEY, 0) != PREF_VALID_CODE) {
+        // Use default values instead of hanging
+        ledBrightness = PREF_LED_BRIGHTNESS_DEFAULT;
+        intersectionPoint = PREF_INTERSECTION_POINT_DEFAULT;
+        deviation = PREF_DEVIATION_DEFAULT;
+        deviationX1000 = (uint16_t)(deviation * 1000);
+        measureMode = MEASURE_MODE_IR;
+        calibrationReset(&calibration);
+        calibrationReset(&ratioCalibration);
+        return SETTINGS_DEFAULTS;
+    }
+
+    ledBrightness = store.getUChar(PREF_LED_BRIGHTNESS_KEY, PREF_LED_BRIGHTNESS_DEFAULT);
+    intersectionPoint = store.getInt(PREF_INTERSECTION_POINT_KEY, PREF_INTERSECTION_POINT_DEFAULT);
+    deviation = store.getFloat(PREF_DEVIATION_KEY, PREF_DEVIATION_DEFAULT);
+    deviationX1000 = (uint16_t)(deviation * 1000);
+    measureMode = store.getUChar(PREF_USE_RATIO_KEY, 0) ? MEASURE_MODE_RATIO : MEASURE_MODE_IR;
+    // After the formula parameters, for a table without points
+    loadCalibration(store, MEASURE_MODE_IR);
+    loadCalibration(store, MEASURE_MODE_RATIO);
+    return status;
+}
+
+bool saveCalibration(KeyValueStore &store, MeasureMode mode) {
+    const Calibration *cal = calibrationFor(mode);
+    bool ok = true;
+    for (uint8_t i = 0; i < cal->count; i++) {
+        char key[12];
+        calibrationPointKey(key, mode, i);
+        int32_t packed = ((int32_t)cal->points[i].level << 16) | (uint16_t)cal->points[i].agtron;
+        ok &= store.putInt(key, packed);
+    }
+    ok &= store.putUChar(calibrationCountKey(mode), cal->count);
+    return ok;
+}
+
+bool saveMeasureMode(KeyValueStore &store) {
+    return store.putUChar(PREF_USE_RATIO_KEY, measureMode == MEASURE_MODE_RATIO ? 1 : 0);
+}
@@ -0,0 +1,107 @@
+#include "telemetry.h"
+
+#include "calibration.h"
+
+// -- Text Formatting --
+
+struct TextCursor {
+    char *out;
+    char *end;   // Last usable byte, kept for the terminator
+};
+
+static void appendText(TextCursor *cursor, const char *text) {
+    while (*text && cursor->out < cursor->end) {
+        *cursor->out++ = *text++;
+    }
+}
+
+static void appendUnsigned(TextCursor *cursor, uint32_t value) {
+    char digits[10];
+    uint8_t count = 0;
+
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0 && cursor->out < cursor->end) {
+        *cursor->out++ = digits[--count];
+    }
+}
+
+static void appendLine(TextCursor *cursor, const char *label, uint32_t value) {
+    appendText(cursor, label);
+    appendUnsigned(cursor, value);
+    appendText(cursor, "\r\n");
+}
+
+static void appendSignedLine(TextCursor *cursor, const char *label, int32_t value) {
+    appendText(cursor, label);
+    if (value < 0) appendText(cursor, "-");
+    appendUnsigned(cursor, value < 0 ? 0u - (uint32_t)value : (uint32_t)value);
+    appendText(cursor, "\r\n");
+}
+
+uint16_t formatMeasurementText(char *out, uint16_t size, const MeasureResult &result) {
+    if (size == 0) return 0;
+
+    TextCursor cursor;
+    cursor.out = out;
+    cursor.end = out + size - 1;
+
+    switch (result.status) {
+    case MEASURE_OK:
+        appendLine(&cursor, "real:", result.rLevel);
+        appendSignedLine(&cursor, "agtron:", result.agtron);
+        appendText(&cursor, "===========================\r\n");
+        break;
+
+    case MEASURE_INVALID_READING:
+        appendLine(&cursor, "Warning: Invalid sensor reading: ", result.rLevel);
+        break;
+
+    case MEASURE_SCALED_TOO_HIGH:
+        appendLine(&cursor, "Warning: Scaled value too high: ", result.rLevel / 1000);
+        break;
+
+    case MEASURE_AGTRON_OUT_OF_RANGE:
+        appendSignedLine(&cursor, "Warning: Agtron value out of range: ", result.agtron);
+        break;
+
+    case MEASURE_NO_SAMPLE:
+        break;
+    }
+
+    *cursor.out = '\0';
+    return (uint16_t)(cursor.out - out);
+}
+
+// -- End Text Formatting --
+
+// -- Binary Stream --
+
+uint16_t buildTelemetrySamples(TelemetrySample *out, const SensorSample *batch, uint8_t count,
+                               const MeasureResult &result) {
+    uint8_t batchFlags = 0;
+    if (result.status != MEASURE_NO_SAMPLE && result.status != MEASURE_INVALID_READING) {
+        batchFlags |= TELEMETRY_FLAG_PRESENT;
+    }
+    if (result.stable) batchFlags |= TELEMETRY_FLAG_LOCKED;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t level = sampleLevel(batch[i]);
+        out[i].timestamp = batch[i].timestamp;
+        out[i].ir = level;
+        out[i].agtron = 0;
+        out[i].flags = (uint8_t)(batchFlags | batch[i].range << TELEMETRY_RANGE_SHIFT);
+        if (batch[i].mode == MEASURE_MODE_RATIO) out[i].flags |= TELEMETRY_FLAG_RATIO;
+
+        if (level != 0 && level <= IR_READING_MAX) {  // Implies level / 1000 <= SCALED_LEVEL_MAX
+            out[i].agtron = (int16_t)calibrationLookup(calibrationFor((MeasureMode)batch[i].mode), level / 1000);
+            out[i].flags |= TELEMETRY_FLAG_VALID;
+        }
+    }
+    return (uint16_t)(count * sizeof(TelemetrySample));
+}
+
+// -- End Binary Stream --
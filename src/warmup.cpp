@@ -0,0 +1,72 @@
+#include "warmup.h"
+
+#include <string.h>
+
+#include "measurement.h"
+
+void warmupBegin(WarmupTracker *tracker, uint32_t now) {
+    memset(tracker, 0, sizeof(WarmupTracker));
+    tracker->startTime = now;
+    tracker->bucketStart = now;
+}
+
+void warmupAddSample(WarmupTracker *tracker, uint32_t ir) {
+    if (ir == 0 || ir > IR_READING_MAX) return;
+    tracker->irSum += ir;
+    tracker->irCount++;
+}
+
+void warmupAddTemperature(WarmupTracker *tracker, float celsius) {
+    tracker->temperature = celsius;
+    tracker->temperatureValid = true;
+}
+
+// A bucket without IR samples says nothing about drift, so it is dropped
+// instead of entering the window. Temperature is read about once per
+// bucket; the latest reading carries over when one arrives late.
+static void closeBucket(WarmupTracker *tracker) {
+    if (tracker->irCount > 0 && tracker->temperatureValid) {
+        tracker->irMeans[tracker->next] = (uint32_t)(tracker->irSum / tracker->irCount);
+        tracker->temperatures[tracker->next] = tracker->temperature;
+        tracker->next = (tracker->next + 1) % WARMUP_WINDOW_BUCKETS;
+        if (tracker->buckets < WARMUP_WINDOW_BUCKETS) tracker->buckets++;
+    }
+    tracker->irSum = 0;
+    tracker->irCount = 0;
+}
+
+static bool windowStable(const WarmupTracker *tracker) {
+    if (tracker->buckets < WARMUP_WINDOW_BUCKETS) return false;
+
+    uint32_t irMin = tracker->irMeans[0], irMax = irMin;
+    float tempMin = tracker->temperatures[0], tempMax = tempMin;
+    uint64_t irSum = 0;
+    for (uint8_t i = 0; i < WARMUP_WINDOW_BUCKETS; i++) {
+        uint32_t ir = tracker->irMeans[i];
+        float temp = tracker->temperatures[i];
+        if (ir < irMin) irMin = ir;
+        if (ir > irMax) irMax = ir;
+        if (temp < tempMin) tempMin = temp;
+        if (temp > tempMax) tempMax = temp;
+        irSum += ir;
+    }
+
+    uint64_t irMean = irSum / WARMUP_WINDOW_BUCKETS;
+    return (uint64_t)(irMax - irMin) * 1000000 <= irMean * WARMUP_IR_DRIFT_PPM &&
+           tempMax - tempMin <= WARMUP_TEMP_DRIFT_C;
+}
+
+WarmupStatus warmupUpdate(WarmupTracker *tracker, uint32_t now) {
+    if (now - tracker->bucketStart >= WARMUP_BUCKET_MS) {
+        closeBucket(tracker);
+        tracker->bucketStart = now;
+        if (windowStable(tracker)) return WARMUP_STABLE;
+    }
+
+    if (warmupElapsed(tracker, now) >= (uint32_t)WARMUP_TIME * 1000) return WARMUP_TIMEOUT;
+    return WARMUP_RUNNING;
+}
+
+uint32_t warmupElapsed(const WarmupTracker *tracker, uint32_t now) {
+    return now - tracker->startTime;
+}
@@ -0,0 +1,121 @@
+// Auto range: the step ladder and its thresholds, scaling back to the
+// calibration configuration, and the pipeline locking onto dark and light
+// cups at the same level as a fixed gain would.
+#include <unity.h>
+
+#include <vector>
+
+#include "auto_range.h"
+#include "sim.h"
+
+#define LOW_COUNT ((uint32_t)((uint64_t)AUTO_RANGE_FULL_SCALE * AUTO_RANGE_LOW_PERCENT / 100))
+#define HIGH_COUNT ((uint32_t)((uint64_t)AUTO_RANGE_FULL_SCALE * AUTO_RANGE_HIGH_PERCENT / 100))
+
+static AutoRange range;
+
+void setUp() {
+    ledBrightness = 95;
+    autoRangeReset(&range);
+}
+
+void tearDown() {
+    autoRangeReset(&autoRange);
+}
+
+static void test_reset_is_the_calibration_configuration() {
+    TEST_ASSERT_EQUAL_UINT8(AUTO_RANGE_BASELINE, range.step);
+    TEST_ASSERT_EQUAL_UINT8(95, autoRangeLedAmplitude(AUTO_RANGE_BASELINE, 95));
+    TEST_ASSERT_EQUAL_INT(AUTO_RANGE_BASE_ADC, autoRangeAdcRange(AUTO_RANGE_BASELINE));
+    TEST_ASSERT_EQUAL_UINT32(123456, autoRangeNormalize(123456, AUTO_RANGE_BASELINE, 95));
+}
+
+static void test_steps_inside_the_band_hold() {
+    TEST_ASSERT_FALSE(autoRangeUpdate(&range, LOW_COUNT, false));
+    TEST_ASSERT_FALSE(autoRangeUpdate(&range, HIGH_COUNT, false));
+    TEST_ASSERT_EQUAL_UINT8(AUTO_RANGE_BASELINE, range.step);
+}
+
+static void test_low_readings_climb_to_the_top_step() {
+    for (uint8_t step = AUTO_RANGE_BASELINE + 1; step < AUTO_RANGE_STEPS; step++) {
+        TEST_ASSERT_TRUE(autoRangeUpdate(&range, LOW_COUNT - 1, false));
+        TEST_ASSERT_EQUAL_UINT8(step, range.step);
+    }
+    TEST_ASSERT_FALSE(autoRangeUpdate(&range, 0, false));
+    TEST_ASSERT_EQUAL_UINT8(AUTO_RANGE_STEPS - 1, range.step);
+}
+
+static void test_high_or_saturated_readings_step_down() {
+    TEST_ASSERT_TRUE(autoRangeUpdate(&range, HIGH_COUNT + 1, false));
+    TEST_ASSERT_EQUAL_UINT8(0, range.step);
+    TEST_ASSERT_FALSE(autoRangeUpdate(&range, AUTO_RANGE_FULL_SCALE, true));
+    TEST_ASSERT_EQUAL_UINT8(0, range.step);
+
+    // Saturation wins over a low mean
+    range.step = 3;
+    TEST_ASSERT_TRUE(autoRangeUpdate(&range, 1000, true));
+    TEST_ASSERT_EQUAL_UINT8(2, range.step);
+}
+
+static void test_each_step_doubles_the_gain() {
+    TEST_ASSERT_EQUAL_UINT8(47, autoRangeLedAmplitude(0, 95));
+    TEST_ASSERT_EQUAL_UINT8(1, autoRangeLedAmplitude(0, 1));
+    TEST_ASSERT_EQUAL_INT(AUTO_RANGE_BASE_ADC, autoRangeAdcRange(0));
+    for (uint8_t step = AUTO_RANGE_BASELINE + 1; step < AUTO_RANGE_STEPS; step++) {
+        TEST_ASSERT_EQUAL_UINT8(95, autoRangeLedAmplitude(step, 95));
+        TEST_ASSERT_EQUAL_INT(2 * autoRangeAdcRange(step), autoRangeAdcRange(step - 1));
+    }
+
+    // Back to the calibration configuration: the exact register ratios
+    TEST_ASSERT_EQUAL_UINT32(20000, autoRangeNormalize(40000, 2, 95));
+    TEST_ASSERT_EQUAL_UINT32(5000, autoRangeNormalize(40000, 4, 95));
+    TEST_ASSERT_EQUAL_UINT32(80851, autoRangeNormalize(40000, 0, 95));  // 40000 * 95 / 47
+    TEST_ASSERT_EQUAL_UINT32(0, autoRangeNormalize(0, 0, 0));
+}
+
+// Lock onto a cup reflecting level at the calibration configuration
+static MeasureResult measureCup(uint32_t level, uint32_t *rangeChanges) {
+    std::vector<uint32_t> script(150, level);
+    ScriptedSensor sensor(script, SIM_SAMPLE_INTERVAL_MS);
+    sensor.configure(simSensorConfig(false, false));
+
+    SimLoop loop;
+    simLoopBegin(&loop, sensor);
+    MeasureResult result = MeasureResult();
+    while (!result.stable && simLoopNext(&loop, &result)) {}
+    *rangeChanges = sensor.rangeChanges;
+    return result;
+}
+
+static void test_dark_cup_is_measured_at_a_higher_gain() {
+    uint32_t rangeChanges;
+    MeasureResult result = measureCup(36000, &rangeChanges);
+
+    TEST_ASSERT_TRUE(result.stable);
+    TEST_ASSERT_EQUAL_INT(MEASURE_OK, result.status);
+    TEST_ASSERT_GREATER_THAN_UINT32(AUTO_RANGE_BASELINE, result.range);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, rangeChanges);
+    TEST_ASSERT_UINT32_WITHIN(36, 36000, result.rawLevel);
+}
+
+static void test_light_cup_is_measured_at_half_amplitude() {
+    uint32_t rangeChanges;
+    MeasureResult result = measureCup(230000, &rangeChanges);
+
+    TEST_ASSERT_TRUE(result.stable);
+    TEST_ASSERT_EQUAL_UINT8(0, result.range);
+    TEST_ASSERT_UINT32_WITHIN(230, 230000, result.rawLevel);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_reset_is_the_calibration_configuration);
+    RUN_TEST(test_steps_inside_the_band_hold);
+    RUN_TEST(test_low_readings_climb_to_the_top_step);
+    RUN_TEST(test_high_or_saturated_readings_step_down);
+    RUN_TEST(test_each_step_doubles_the_gain);
+    RUN_TEST(test_dark_cup_is_measured_at_a_higher_gain);
+    RUN_TEST(test_light_cup_is_measured_at_half_amplitude);
+    return UNITY_END();
+}
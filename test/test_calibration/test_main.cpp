@@ -0,0 +1,102 @@
+// Calibration table: the formula without points, straight segments
+// through the points, and incremental updates matching a full rebuild.
+#include <unity.h>
+
+#include "calibration.h"
+
+void setUp() {
+    intersectionPoint = 117;
+    deviation = 0.165f;
+    calibrationReset(&calibration);
+    calibrationReset(&ratioCalibration);
+}
+
+void tearDown() {}
+
+static void test_no_points_follows_the_ir_formula() {
+    // level - (117 - level) * 0.165, rounded
+    TEST_ASSERT_EQUAL_INT(-19, calibrationLookup(&calibration, 0));
+    TEST_ASSERT_EQUAL_INT(51, calibrationLookup(&calibration, 60));
+    TEST_ASSERT_EQUAL_INT(117, calibrationLookup(&calibration, 117));
+    TEST_ASSERT_EQUAL_INT(122, calibrationLookup(&calibration, 121));
+    TEST_ASSERT_EQUAL_INT(1146, calibrationLookup(&calibration, SCALED_LEVEL_MAX));
+
+    // A single point is not enough to leave the formula
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 60, 30));
+    TEST_ASSERT_EQUAL_INT(51, calibrationLookup(&calibration, 60));
+}
+
+static void test_no_points_follows_the_ratio_formula() {
+    TEST_ASSERT_EQUAL_INT(35, calibrationLookup(&ratioCalibration, 450));
+    TEST_ASSERT_EQUAL_INT(65, calibrationLookup(&ratioCalibration, 650));
+    TEST_ASSERT_EQUAL_INT(95, calibrationLookup(&ratioCalibration, 850));
+}
+
+static void test_rebuild_follows_new_formula_settings() {
+    intersectionPoint = 60;
+    deviation = 1.0f;
+    TEST_ASSERT_EQUAL_INT(117, calibrationLookup(&calibration, 117));
+    calibrationRebuild(&calibration);
+    TEST_ASSERT_EQUAL_INT(174, calibrationLookup(&calibration, 117));
+}
+
+static void test_two_points_give_a_straight_line() {
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 60, 30));
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 140, 95));
+
+    TEST_ASSERT_EQUAL_INT(30, calibrationLookup(&calibration, 60));
+    TEST_ASSERT_EQUAL_INT(95, calibrationLookup(&calibration, 140));
+    TEST_ASSERT_EQUAL_INT(63, calibrationLookup(&calibration, 100));  // 62.5, half away from zero
+
+    // The line carries on past both ends
+    TEST_ASSERT_EQUAL_INT(-19, calibrationLookup(&calibration, 0));
+    TEST_ASSERT_EQUAL_INT(160, calibrationLookup(&calibration, 220));
+}
+
+static void test_point_at_same_level_is_replaced() {
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 60, 30));
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 140, 95));
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 60, 40));
+
+    TEST_ASSERT_EQUAL_UINT8(2, calibration.count);
+    TEST_ASSERT_EQUAL_INT(40, calibrationLookup(&calibration, 60));
+}
+
+static void test_rejects_out_of_range_and_extra_points() {
+    TEST_ASSERT_FALSE(calibrationAddPoint(&calibration, SCALED_LEVEL_MAX + 1, 50));
+
+    for (uint16_t i = 0; i < CAL_MAX_POINTS; i++) {
+        TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 50 + i * 20, 20 + i * 10));
+    }
+    TEST_ASSERT_FALSE(calibrationAddPoint(&calibration, 10, 5));
+    TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, 50, 25));  // Replacing still works
+    TEST_ASSERT_EQUAL_UINT8(CAL_MAX_POINTS, calibration.count);
+}
+
+static void test_incremental_update_matches_full_rebuild() {
+    // Out of order, inside, outside and on top of existing points
+    const CalPoint points[] = {{140, 95}, {60, 30}, {100, 70}, {20, 5}, {300, 180}, {100, 60}, {200, 120}};
+
+    for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+        TEST_ASSERT_TRUE(calibrationAddPoint(&calibration, points[i].level, points[i].agtron));
+
+        static Calibration rebuilt;
+        rebuilt = calibration;
+        calibrationRebuild(&rebuilt);
+        TEST_ASSERT_EQUAL_MEMORY(rebuilt.table, calibration.table, sizeof(calibration.table));
+    }
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_no_points_follows_the_ir_formula);
+    RUN_TEST(test_no_points_follows_the_ratio_formula);
+    RUN_TEST(test_rebuild_follows_new_formula_settings);
+    RUN_TEST(test_two_points_give_a_straight_line);
+    RUN_TEST(test_point_at_same_level_is_replaced);
+    RUN_TEST(test_rejects_out_of_range_and_extra_points);
+    RUN_TEST(test_incremental_update_matches_full_rebuild);
+    return UNITY_END();
+}
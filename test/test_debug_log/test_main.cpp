@@ -0,0 +1,284 @@
+// Page log on a RAM flash: appending across reboots and wakes, session
+// lookup, recovery from a torn block, and the ring wrapping around.
+#include <unity.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "debug_log.h"
+#include "fakes.h"
+
+#if DEBUG_LOGGING_ENABLED
+#define TEST_FLASH_SIZE (16 * LOG_PAGE_SIZE)
+
+static std::vector<LogEntry> visited;
+static std::vector<uint32_t> visitedIndexes;
+static std::vector<LogSessionInfo> sessions;
+static uint32_t nextTimestamp;
+
+void setUp() {
+    visited.clear();
+    visitedIndexes.clear();
+    sessions.clear();
+    nextTimestamp = 0;
+}
+
+void tearDown() {}
+
+static void collectEntry(const LogEntry &entry, uint32_t index) {
+    visited.push_back(entry);
+    visitedIndexes.push_back(index);
+}
+
+static void collectSession(const LogSessionInfo &info) {
+    sessions.push_back(info);
+}
+
+// Log count measurements with consecutive timestamps, then flush
+static void logEntries(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t timestamp = nextTimestamp++;
+        TEST_ASSERT_TRUE(logMeasurement(timestamp, 121000 + timestamp % 97, 120, logMeasurementFlags(1, false)));
+    }
+    TEST_ASSERT_TRUE(flushLogBuffer());
+}
+
+// Every stored entry, in order, with the timestamps logEntries() gave them
+static void assertStoredEntries(uint32_t firstTimestamp, uint32_t count) {
+    visited.clear();
+    visitedIndexes.clear();
+    TEST_ASSERT_TRUE(forEachLogEntry(collectEntry));
+    TEST_ASSERT_EQUAL_UINT32(count, visited.size());
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(firstTimestamp + i, visited[i].timestamp);
+        TEST_ASSERT_EQUAL_UINT32(121000 + visited[i].timestamp % 97, visited[i].rawIR);
+    }
+}
+
+static void assertSession(uint32_t session, uint32_t firstEntry, uint32_t entries) {
+    LogSessionInfo info;
+    TEST_ASSERT_TRUE(findLogSession(session, &info));
+    TEST_ASSERT_EQUAL_UINT32(session, info.session);
+    TEST_ASSERT_EQUAL_UINT32(firstEntry, info.firstEntry);
+    TEST_ASSERT_EQUAL_UINT32(entries, info.entries);
+}
+
+static void test_fresh_log_round_trips_entries() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    TEST_ASSERT_EQUAL_INT(LOG_OPEN_CREATED, setupDebugLog(flash));
+    TEST_ASSERT_EQUAL_UINT32(1, getLogStatus().session);
+
+    logEntries(25);
+    assertStoredEntries(0, 25);
+    TEST_ASSERT_EQUAL_UINT32(25, getLogStatus().entryCount);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.programErrors);
+}
+
+static void test_reboot_appends_to_the_same_page() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(25);
+    uint16_t page = getLogStatus().currentPage;
+
+    flash.resetCounters();
+    TEST_ASSERT_EQUAL_INT(LOG_OPEN_LOADED, setupDebugLog(flash));
+    TEST_ASSERT_EQUAL_UINT32(2, getLogStatus().session);
+    TEST_ASSERT_EQUAL_UINT32(1, lastLogSession());  // Nothing logged yet this boot
+
+    logEntries(10);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.erases);
+    TEST_ASSERT_EQUAL_UINT16(page, getLogStatus().currentPage);
+    TEST_ASSERT_EQUAL_UINT32(2, lastLogSession());
+
+    assertStoredEntries(0, 35);
+    assertSession(1, 0, 25);
+    assertSession(2, 25, 10);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.programErrors);
+}
+
+static void test_boot_without_entries_is_no_session() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(5);
+
+    setupDebugLog(flash);
+    setupDebugLog(flash);
+    TEST_ASSERT_EQUAL_UINT32(2, getLogStatus().session);
+
+    logEntries(5);
+    TEST_ASSERT_TRUE(forEachLogSession(collectSession));
+    TEST_ASSERT_EQUAL_UINT32(2, sessions.size());
+    TEST_ASSERT_EQUAL_UINT32(2, sessions[1].session);
+    TEST_ASSERT_EQUAL_UINT32(5, sessions[1].firstEntry);
+    TEST_ASSERT_EQUAL_UINT32(5, sessions[1].entries);
+
+    LogSessionInfo info;
+    TEST_ASSERT_FALSE(findLogSession(3, &info));
+}
+
+static void test_wake_continues_the_session() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(5);
+    setupDebugLog(flash);
+    logEntries(20);
+
+    LogPosition position;
+    TEST_ASSERT_TRUE(getLogPosition(&position));
+
+    // Deep sleep: RAM state is gone, the position survives
+    flash.resetCounters();
+    TEST_ASSERT_EQUAL_INT(LOG_OPEN_LOADED, resumeDebugLog(flash, position));
+    TEST_ASSERT_EQUAL_UINT32(1, flash.readOps);
+    TEST_ASSERT_EQUAL_UINT32(2, getLogStatus().session);
+
+    logEntries(7);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.erases);
+    assertStoredEntries(0, 32);
+    assertSession(2, 5, 27);
+
+    // The next cold boot is a new session again
+    setupDebugLog(flash);
+    TEST_ASSERT_EQUAL_UINT32(3, getLogStatus().session);
+}
+
+static void test_wake_before_logging_keeps_the_pending_session() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(5);
+    setupDebugLog(flash);
+
+    LogPosition position;
+    TEST_ASSERT_TRUE(getLogPosition(&position));
+    resumeDebugLog(flash, position);
+    TEST_ASSERT_EQUAL_UINT32(2, getLogStatus().session);
+
+    logEntries(3);
+    assertSession(1, 0, 5);
+    assertSession(2, 5, 3);
+}
+
+static void test_stale_position_falls_back_to_a_scan() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(5);
+
+    LogPosition position;
+    TEST_ASSERT_TRUE(getLogPosition(&position));
+    position.currentSequence++;
+
+    TEST_ASSERT_EQUAL_INT(LOG_OPEN_LOADED, resumeDebugLog(flash, position));
+    TEST_ASSERT_EQUAL_UINT32(2, getLogStatus().session);
+    TEST_ASSERT_EQUAL_UINT32(5, getLogStatus().entryCount);
+}
+
+static void test_torn_block_is_skipped() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(LOG_BUFFER_SIZE);
+    logEntries(LOG_BUFFER_SIZE);
+
+    // Power lost in the middle of the second block's write
+    LogStatus status = getLogStatus();
+    LogPosition position;
+    getLogPosition(&position);
+    flash.data[status.currentPage * LOG_PAGE_SIZE + position.pageOffset - 1] ^= 0x5A;
+
+    TEST_ASSERT_EQUAL_INT(LOG_OPEN_RECOVERED, setupDebugLog(flash));
+    TEST_ASSERT_TRUE(getLogStatus().currentPage != status.currentPage);
+    TEST_ASSERT_EQUAL_UINT32(LOG_BUFFER_SIZE, getLogStatus().entryCount);
+
+    nextTimestamp = LOG_BUFFER_SIZE;
+    logEntries(3);
+    assertStoredEntries(0, LOG_BUFFER_SIZE + 3);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.programErrors);
+}
+
+static void test_ring_wraps_and_sessions_stay_findable() {
+    RamFlashStorage flash(4 * LOG_PAGE_SIZE);
+    const uint32_t bootEntries[] = {3000, 40, 0, 2500, 12, 6000, 1, 700};
+    uint32_t firstEntries[8];
+    uint32_t total = 0;
+
+    for (size_t boot = 0; boot < sizeof(bootEntries) / sizeof(bootEntries[0]); boot++) {
+        setupDebugLog(flash);
+        firstEntries[boot] = total;
+        if (bootEntries[boot] > 0) logEntries(bootEntries[boot]);
+        total += bootEntries[boot];
+    }
+
+    LogStatus status = getLogStatus();
+    TEST_ASSERT_TRUE(status.wrapped);
+    TEST_ASSERT_EQUAL_UINT32(total, status.entryCount);
+    TEST_ASSERT_LESS_THAN_UINT32(total, status.storedEntries);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(8, flash.maxSectorErases());
+    TEST_ASSERT_EQUAL_UINT32(0, flash.programErrors);
+    uint32_t oldest = total - status.storedEntries;
+    assertStoredEntries(oldest, status.storedEntries);
+
+    // The boot without entries took no session number: sessions 1..7
+    TEST_ASSERT_EQUAL_UINT32(7, lastLogSession());
+    assertSession(7, firstEntries[7], 700);
+    assertSession(6, firstEntries[6], 1);
+    TEST_ASSERT_GREATER_THAN_UINT32(firstEntries[5], oldest);  // Its start has been recycled
+    assertSession(5, oldest, firstEntries[6] - oldest);
+
+    // The listing agrees with the lookups, down to the partly overwritten session
+    TEST_ASSERT_TRUE(forEachLogSession(collectSession));
+    TEST_ASSERT_EQUAL_UINT32(oldest, sessions[0].firstEntry);
+    for (size_t i = 0; i < sessions.size(); i++) {
+        LogSessionInfo info;
+        TEST_ASSERT_TRUE(findLogSession(sessions[i].session, &info));
+        TEST_ASSERT_EQUAL_UINT32(sessions[i].entries, info.entries);
+        if (i > 0) TEST_ASSERT_EQUAL_UINT32(sessions[i].firstEntry, info.firstEntry);
+        if (i + 1 < sessions.size()) {
+            TEST_ASSERT_EQUAL_UINT32(sessions[i + 1].firstEntry, sessions[i].firstEntry + sessions[i].entries);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(7, sessions.back().session);
+
+    // LOG DUMP SESSION reads just that range
+    visited.clear();
+    visitedIndexes.clear();
+    TEST_ASSERT_TRUE(forEachLogEntryInRange(firstEntries[6], 1, collectEntry));
+    TEST_ASSERT_EQUAL_UINT32(1, visited.size());
+    TEST_ASSERT_EQUAL_UINT32(firstEntries[6], visitedIndexes[0]);
+    TEST_ASSERT_EQUAL_UINT32(firstEntries[6], visited[0].timestamp);
+}
+
+static void test_reset_starts_over() {
+    RamFlashStorage flash(TEST_FLASH_SIZE);
+    setupDebugLog(flash);
+    logEntries(30);
+
+    resetLog();
+    TEST_ASSERT_EQUAL_UINT32(0, getLogStatus().entryCount);
+    nextTimestamp = 1000;
+    logEntries(4);
+
+    setupDebugLog(flash);
+    assertStoredEntries(1000, 4);
+}
+#else
+void setUp() {}
+void tearDown() {}
+#endif
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+#if DEBUG_LOGGING_ENABLED
+    RUN_TEST(test_fresh_log_round_trips_entries);
+    RUN_TEST(test_reboot_appends_to_the_same_page);
+    RUN_TEST(test_boot_without_entries_is_no_session);
+    RUN_TEST(test_wake_continues_the_session);
+    RUN_TEST(test_wake_before_logging_keeps_the_pending_session);
+    RUN_TEST(test_stale_position_falls_back_to_a_scan);
+    RUN_TEST(test_torn_block_is_skipped);
+    RUN_TEST(test_ring_wraps_and_sessions_stay_findable);
+    RUN_TEST(test_reset_starts_over);
+#endif
+    return UNITY_END();
+}
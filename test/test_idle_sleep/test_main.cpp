@@ -0,0 +1,183 @@
+// Idle deep sleep: when the idle timer fires, the proximity wake threshold,
+// and the state a wake restores from RTC memory.
+#include <unity.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+
+#include "idle_sleep.h"
+#include "sim.h"
+
+#define IDLE_SLEEP_MS ((uint32_t)IDLE_SLEEP_SECONDS * 1000)
+
+static IdleTimer timer;
+static RetainedState rtc;
+
+void setUp() {
+    idleTimerReset(&timer);
+    memset(&rtc, 0, sizeof(rtc));
+    ledBrightness = 95;
+    measureMode = MEASURE_MODE_IR;
+    intersectionPoint = 117;
+    deviation = 0.165f;
+    unblockedValue = 30000;
+    calibrationReset(&calibration);
+    calibrationReset(&ratioCalibration);
+}
+
+void tearDown() {
+    calibrationReset(&calibration);
+    calibrationReset(&ratioCalibration);
+}
+
+static void test_timer_fires_after_the_idle_time() {
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 5000));
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 5000 + IDLE_SLEEP_MS - 1));
+    TEST_ASSERT_TRUE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 5000 + IDLE_SLEEP_MS));
+}
+
+static void test_any_reading_restarts_the_timer() {
+    idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 0);
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_OK, IDLE_SLEEP_MS / 2));
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, IDLE_SLEEP_MS / 2 + 100));
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, IDLE_SLEEP_MS));
+
+    // A rejected reading means something is in front of the sensor too
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_AGTRON_OUT_OF_RANGE, IDLE_SLEEP_MS + 100));
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, IDLE_SLEEP_MS + 200));
+    TEST_ASSERT_TRUE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 2 * IDLE_SLEEP_MS + 200));
+}
+
+static void test_timer_across_millis_wrap() {
+    idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 0xFFFFFF00);
+    TEST_ASSERT_FALSE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, 0x100));
+    TEST_ASSERT_TRUE(idleTimerUpdate(&timer, MEASURE_NO_SAMPLE, IDLE_SLEEP_MS - 0x100));
+}
+
+static void test_wake_threshold_sits_just_above_the_margin() {
+    const uint32_t levels[] = {0, 1, 30000, 31744, 100000, 257000};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        uint32_t counts = (uint32_t)proximityThreshold(levels[i]) << PROXIMITY_THRESHOLD_SHIFT;
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(levels[i] + PROXIMITY_WAKE_MARGIN, counts);
+        TEST_ASSERT_LESS_THAN_UINT32(levels[i] + PROXIMITY_WAKE_MARGIN + (1UL << PROXIMITY_THRESHOLD_SHIFT), counts);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0xFF, proximityThreshold(300000));
+}
+
+static void test_bare_window_idles_into_sleep() {
+    std::vector<uint32_t> bare(IDLE_SLEEP_MS / SIM_SAMPLE_INTERVAL_MS + 50);
+    for (size_t i = 0; i < bare.size(); i++) bare[i] = unblockedValue + i % 41 - 20;
+    ScriptedSensor sensor(bare, SIM_SAMPLE_INTERVAL_MS);
+    sensor.configure(simSensorConfig(false, false));
+
+    SimLoop loop;
+    simLoopBegin(&loop, sensor);
+    MeasureResult result;
+    uint32_t sleepAt = 0;
+    while (sleepAt == 0 && simLoopNext(&loop, &result)) {
+        TEST_ASSERT_EQUAL_INT(MEASURE_NO_SAMPLE, result.status);
+        if (idleTimerUpdate(&timer, result.status, loop.now)) sleepAt = loop.now;
+    }
+    TEST_ASSERT_UINT32_WITHIN(2 * MEASURE_INTERVAL_MS, IDLE_SLEEP_MS, sleepAt);
+
+    sensor.armProximityWake(ledBrightness, proximityThreshold(unblockedValue));
+    TEST_ASSERT_EQUAL_UINT8(proximityThreshold(unblockedValue), sensor.wakeThreshold);
+}
+
+static void test_resume_restores_what_was_retained() {
+    ledBrightness = 120;
+    measureMode = MEASURE_MODE_RATIO;
+    intersectionPoint = 100;
+    deviation = 0.25f;
+    unblockedValue = 31000;
+    calibrationAddPoint(&calibration, 60, 30);
+    calibrationAddPoint(&calibration, 140, 95);
+    calibrationAddPoint(&ratioCalibration, 500, 40);
+    static Calibration before;
+    static Calibration ratioBefore;
+    before = calibration;
+    ratioBefore = ratioCalibration;
+
+    retainState(&rtc, WARMUP_STABLE);
+
+    // Deep sleep loses RAM
+    ledBrightness = 0;
+    measureMode = MEASURE_MODE_IR;
+    intersectionPoint = 0;
+    deviation = 0.0f;
+    unblockedValue = 0;
+    calibrationReset(&calibration);
+    calibrationReset(&ratioCalibration);
+
+    TEST_ASSERT_TRUE(resumeState(&rtc));
+    TEST_ASSERT_EQUAL_UINT8(120, ledBrightness);
+    TEST_ASSERT_EQUAL_INT(MEASURE_MODE_RATIO, measureMode);
+    TEST_ASSERT_EQUAL_INT(100, intersectionPoint);
+    TEST_ASSERT_EQUAL_UINT16(250, deviationX1000);
+    TEST_ASSERT_EQUAL_UINT32(31000, unblockedValue);
+    TEST_ASSERT_EQUAL_UINT8(WARMUP_STABLE, rtc.warmup);
+    TEST_ASSERT_EQUAL_MEMORY(before.table, calibration.table, sizeof(before.table));
+    TEST_ASSERT_EQUAL_MEMORY(ratioBefore.table, ratioCalibration.table, sizeof(ratioBefore.table));
+}
+
+static void test_capture_is_used_once() {
+    retainState(&rtc, WARMUP_TIMEOUT);
+    TEST_ASSERT_TRUE(resumeState(&rtc));
+    TEST_ASSERT_EQUAL_UINT32(1, rtc.wakes);
+    TEST_ASSERT_FALSE(resumeState(&rtc));
+
+    // The wake count carries over into the next capture
+    retainState(&rtc, WARMUP_TIMEOUT);
+    TEST_ASSERT_TRUE(resumeState(&rtc));
+    TEST_ASSERT_EQUAL_UINT32(2, rtc.wakes);
+}
+
+static void test_damaged_capture_is_refused() {
+    retainState(&rtc, WARMUP_STABLE);
+    ((uint8_t*)&rtc)[offsetof(RetainedState, unblockedValue)] ^= 0x01;
+    unblockedValue = 0;
+
+    TEST_ASSERT_FALSE(resumeState(&rtc));
+    TEST_ASSERT_EQUAL_UINT32(0, unblockedValue);
+}
+
+#if DEBUG_LOGGING_ENABLED
+static void test_wake_continues_the_log() {
+    RamFlashStorage flash(8 * LOG_PAGE_SIZE);
+    setupDebugLog(flash);
+    for (uint32_t i = 0; i < 30; i++) logMeasurement(i * 100, 121000, 120, logMeasurementFlags(1, false));
+    flushLogBuffer();
+    LogStatus before = getLogStatus();
+
+    retainState(&rtc, WARMUP_STABLE);
+    TEST_ASSERT_TRUE(resumeState(&rtc));
+    flash.resetCounters();
+    TEST_ASSERT_EQUAL_INT(LOG_OPEN_LOADED, resumeDebugLog(flash, rtc.log));
+    TEST_ASSERT_EQUAL_UINT32(1, flash.readOps);
+
+    LogStatus after = getLogStatus();
+    TEST_ASSERT_EQUAL_UINT32(before.session, after.session);
+    TEST_ASSERT_EQUAL_UINT16(before.currentPage, after.currentPage);
+    TEST_ASSERT_EQUAL_UINT32(before.entryCount, after.entryCount);
+}
+#endif
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_timer_fires_after_the_idle_time);
+    RUN_TEST(test_any_reading_restarts_the_timer);
+    RUN_TEST(test_timer_across_millis_wrap);
+    RUN_TEST(test_wake_threshold_sits_just_above_the_margin);
+    RUN_TEST(test_bare_window_idles_into_sleep);
+    RUN_TEST(test_resume_restores_what_was_retained);
+    RUN_TEST(test_capture_is_used_once);
+    RUN_TEST(test_damaged_capture_is_refused);
+#if DEBUG_LOGGING_ENABLED
+    RUN_TEST(test_wake_continues_the_log);
+#endif
+    return UNITY_END();
+}
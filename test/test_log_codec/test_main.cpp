@@ -0,0 +1,190 @@
+// Log block codec: v2 records round-trip every entry field, stay within
+// their size bounds, carry sessions, and malformed payloads are refused.
+#include <unity.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "log_codec.h"
+
+static LogEncoder encoder;
+static LogDecoder decoder;
+static std::vector<LogEntry> decoded;
+static std::vector<uint32_t> decodedSessions;
+
+void setUp() {
+    logEncoderReset(&encoder);
+    logDecoderReset(&decoder, 7);
+    decoded.clear();
+    decodedSessions.clear();
+}
+
+void tearDown() {}
+
+static void collect(const LogEntry &entry, void *context) {
+    decoded.push_back(entry);
+    decodedSessions.push_back(((const LogDecoder*)context)->session);
+}
+
+static LogEntry sample(uint32_t timestamp, uint32_t rawIR, int16_t agtron) {
+    LogEntry entry;
+    entry.timestamp = timestamp;
+    entry.rawIR = rawIR;
+    entry.agtron = agtron;
+    entry.ledBrightness = 95;
+    entry.intersectPt = 117;
+    entry.deviationX1000 = 165;
+    entry.flags = logMeasurementFlags(1, false);
+    return entry;
+}
+
+static LogEntry warmup(uint32_t timestamp, uint32_t durationMs, uint8_t reason) {
+    LogEntry entry = sample(timestamp, durationMs, reason);
+    entry.flags = LOG_FLAG_WARMUP;
+    return entry;
+}
+
+// Encode entries into one payload; returns its length
+static uint16_t encode(const LogEntry *entries, size_t count, uint8_t *payload) {
+    uint16_t length = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t n = logEncodeEntry(&encoder, entries[i], payload + length);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * LOG_MAX_RECORD_BYTES, n);
+        length += n;
+    }
+    return length;
+}
+
+static void assertEntryEqual(const LogEntry &expected, const LogEntry &actual) {
+    TEST_ASSERT_EQUAL_UINT32(expected.timestamp, actual.timestamp);
+    TEST_ASSERT_EQUAL_UINT32(expected.rawIR, actual.rawIR);
+    TEST_ASSERT_EQUAL_INT(expected.agtron, actual.agtron);
+    TEST_ASSERT_EQUAL_UINT16(expected.flags, actual.flags);
+    if (expected.flags & LOG_FLAG_WARMUP) return;  // Events carry no settings of their own
+    TEST_ASSERT_EQUAL_UINT8(expected.ledBrightness, actual.ledBrightness);
+    TEST_ASSERT_EQUAL_UINT8(expected.intersectPt, actual.intersectPt);
+    TEST_ASSERT_EQUAL_UINT16(expected.deviationX1000, actual.deviationX1000);
+}
+
+static void test_round_trip_of_every_field() {
+    LogEntry entries[] = {
+        sample(0, 121000, 120),
+        sample(100, 121400, 121),
+        warmup(150, 12000, LOG_WARMUP_STABLE),
+        sample(200, 0, -700),                  // Escaped agtron delta
+        sample(0xFFFFFF00, 1000000, 350),      // Far jumps in both directions
+        sample(0x00000010, 3, 0),              // millis() wrapped
+        sample(300, 4000000000u, 32767),
+        sample(400, 121000, -32768),
+    };
+    entries[4].ledBrightness = 255;            // Settings change mid-block
+    entries[5].deviationX1000 = 65535;
+    entries[6].flags = logMeasurementFlags(4, true);
+    const size_t count = sizeof(entries) / sizeof(entries[0]);
+
+    uint8_t payload[count * 2 * LOG_MAX_RECORD_BYTES];
+    uint16_t length = encode(entries, count, payload);
+    TEST_ASSERT_TRUE(logDecodeBlock(&decoder, LOG_VERSION_DELTA, payload, length, collect, &decoder));
+
+    TEST_ASSERT_EQUAL_UINT32(count, decoded.size());
+    for (size_t i = 0; i < count; i++) assertEntryEqual(entries[i], decoded[i]);
+}
+
+static void test_steady_samples_are_small() {
+    uint8_t record[2 * LOG_MAX_RECORD_BYTES];
+    uint8_t first = logEncodeEntry(&encoder, sample(0, 121000, 120), record);
+    TEST_ASSERT_EQUAL_HEX8(LOG_TAG_SETTINGS, record[0]);
+    TEST_ASSERT_GREATER_THAN_UINT32(4, first);
+
+    uint8_t next = logEncodeEntry(&encoder, sample(100, 121040, 121), record);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(4, next);
+    TEST_ASSERT_TRUE(record[0] < LOG_TAG_SAMPLE_ESCAPE);
+}
+
+static void test_escaped_sample_takes_the_record_bound() {
+    uint8_t record[2 * LOG_MAX_RECORD_BYTES];
+    logEncodeEntry(&encoder, sample(0, 0, 16384), record);
+
+    // Every delta at its widest varint: 3-byte agtron, 5-byte time and IR
+    uint8_t n = logEncodeEntry(&encoder, sample(0xF0000000, 0x40000000, 0), record);
+    TEST_ASSERT_EQUAL_HEX8(LOG_TAG_SAMPLE_ESCAPE, record[0]);
+    TEST_ASSERT_EQUAL_UINT32(LOG_MAX_RECORD_BYTES, n);
+}
+
+static void test_encoder_reset_starts_a_new_chain() {
+    uint8_t payload[4 * LOG_MAX_RECORD_BYTES];
+    LogEntry entries[] = {sample(100, 121000, 120), sample(200, 121100, 121)};
+    encode(entries, 1, payload);
+
+    // A new page: its decoder starts from zero, so must the encoder
+    logEncoderReset(&encoder);
+    uint16_t length = encode(entries + 1, 1, payload);
+    TEST_ASSERT_EQUAL_HEX8(LOG_TAG_SETTINGS, payload[0]);
+    TEST_ASSERT_TRUE(logDecodeBlock(&decoder, LOG_VERSION_DELTA, payload, length, collect, &decoder));
+    TEST_ASSERT_EQUAL_UINT32(1, decoded.size());
+    assertEntryEqual(entries[1], decoded[0]);
+}
+
+static void test_session_record_switches_the_session() {
+    uint8_t payload[2 * LOG_SESSION_RECORD_BYTES + 4 * LOG_MAX_RECORD_BYTES];
+    LogEntry entries[] = {sample(100, 121000, 120), sample(0, 60000, 40)};
+
+    uint16_t length = encode(entries, 1, payload);
+    uint8_t n = logEncodeSession(0xFFFFFFFE, payload + length);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(LOG_SESSION_RECORD_BYTES, n);
+    length += n;
+    length += encode(entries + 1, 1, payload + length);
+
+    TEST_ASSERT_TRUE(logDecodeBlock(&decoder, LOG_VERSION_DELTA, payload, length, collect, &decoder));
+    TEST_ASSERT_EQUAL_UINT32(2, decoded.size());
+    TEST_ASSERT_EQUAL_UINT32(7, decodedSessions[0]);  // From the page header
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFE, decodedSessions[1]);
+
+    // The sample deltas run on across the session record
+    assertEntryEqual(entries[1], decoded[1]);
+}
+
+static void test_fixed_blocks_decode() {
+    LogEntry entries[] = {sample(100, 121000, 120), warmup(200, 9000, LOG_WARMUP_TIMEOUT)};
+    TEST_ASSERT_TRUE(logDecodeBlock(&decoder, LOG_VERSION_FIXED, (const uint8_t*)entries, sizeof(entries),
+                                    collect, &decoder));
+    TEST_ASSERT_EQUAL_UINT32(2, decoded.size());
+    TEST_ASSERT_EQUAL_MEMORY(entries, decoded.data(), sizeof(entries));
+
+    TEST_ASSERT_FALSE(logDecodeBlock(&decoder, LOG_VERSION_FIXED, (const uint8_t*)entries, sizeof(entries) - 1,
+                                     collect, &decoder));
+}
+
+static void test_malformed_payloads_are_refused() {
+    uint8_t payload[2 * LOG_MAX_RECORD_BYTES];
+    logEncodeEntry(&encoder, sample(100, 121000, 120), payload);
+    uint16_t length = logEncodeEntry(&encoder, sample(0xFFFFFF00, 1000000, -700), payload);
+
+    // Cut anywhere inside the escaped sample record
+    for (uint16_t cut = 1; cut < length; cut++) {
+        TEST_ASSERT_FALSE(logDecodeBlock(&decoder, LOG_VERSION_DELTA, payload, cut, collect, &decoder));
+    }
+
+    const uint8_t unknownTag[] = {0x90, 0x00};
+    TEST_ASSERT_FALSE(logDecodeBlock(&decoder, LOG_VERSION_DELTA, unknownTag, sizeof(unknownTag),
+                                     collect, &decoder));
+    const uint8_t endlessVarint[] = {LOG_TAG_SESSION, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    TEST_ASSERT_FALSE(logDecodeBlock(&decoder, LOG_VERSION_DELTA, endlessVarint, sizeof(endlessVarint),
+                                     collect, &decoder));
+    TEST_ASSERT_FALSE(logDecodeBlock(&decoder, 3, payload, length, collect, &decoder));
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_of_every_field);
+    RUN_TEST(test_steady_samples_are_small);
+    RUN_TEST(test_escaped_sample_takes_the_record_bound);
+    RUN_TEST(test_encoder_reset_starts_a_new_chain);
+    RUN_TEST(test_session_record_switches_the_session);
+    RUN_TEST(test_fixed_blocks_decode);
+    RUN_TEST(test_malformed_payloads_are_refused);
+    return UNITY_END();
+}
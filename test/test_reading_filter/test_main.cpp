@@ -0,0 +1,133 @@
+// Reading filter: the streaming window against a sort of the whole window,
+// and when a reading counts as stable and locks.
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include "reading_filter.h"
+
+static ReadingFilter filter;
+
+void setUp() {
+    readingFilterReset(&filter);
+}
+
+void tearDown() {}
+
+static ReadingStats addRepeated(uint32_t sample, uint8_t times) {
+    ReadingStats stats = ReadingStats();
+    for (uint8_t i = 0; i < times; i++) stats = readingFilterAdd(&filter, sample);
+    return stats;
+}
+
+static void test_first_sample_is_the_reading() {
+    ReadingStats stats = readingFilterAdd(&filter, 121000);
+    TEST_ASSERT_EQUAL_UINT32(121000, stats.median);
+    TEST_ASSERT_EQUAL_UINT32(121000, stats.trimmedMean);
+    TEST_ASSERT_EQUAL_UINT32(121000, stats.value);
+    TEST_ASSERT_FALSE(stats.stable);
+}
+
+static void test_stable_only_once_the_window_is_full() {
+    ReadingStats stats = addRepeated(121000, READING_SAMPLES - 1);
+    TEST_ASSERT_FALSE(stats.stable);
+
+    stats = readingFilterAdd(&filter, 121000);
+    TEST_ASSERT_TRUE(stats.stable);
+    TEST_ASSERT_EQUAL_UINT32(121000, stats.value);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.trimmedVariance);
+}
+
+static void test_outliers_are_trimmed() {
+    addRepeated(100000, READING_SAMPLES - 2);
+    readingFilterAdd(&filter, 900000);
+    ReadingStats stats = readingFilterAdd(&filter, 1000);
+
+    TEST_ASSERT_EQUAL_UINT32(100000, stats.median);
+    TEST_ASSERT_EQUAL_UINT32(100000, stats.trimmedMean);
+    TEST_ASSERT_TRUE(stats.stable);
+}
+
+static void test_locked_value_holds_through_small_noise() {
+    ReadingStats stats = addRepeated(121000, READING_SAMPLES);
+    TEST_ASSERT_TRUE(stats.stable);
+
+    // Within the 2% tolerance the shown value stays where it locked
+    const uint32_t noisy[] = {121400, 120700, 121300, 120900, 121200};
+    for (size_t i = 0; i < sizeof(noisy) / sizeof(noisy[0]); i++) {
+        stats = readingFilterAdd(&filter, noisy[i]);
+        TEST_ASSERT_TRUE(stats.stable);
+        TEST_ASSERT_EQUAL_UINT32(121000, stats.value);
+    }
+    TEST_ASSERT_TRUE(stats.trimmedMean != 121000);
+}
+
+static void test_wide_spread_unlocks() {
+    addRepeated(121000, READING_SAMPLES);
+
+    // A new cup: the window fills with a different level
+    ReadingStats stats = ReadingStats();
+    for (uint8_t i = 0; i < READING_SAMPLES / 2; i++) {
+        stats = readingFilterAdd(&filter, 60000);
+    }
+    TEST_ASSERT_FALSE(stats.stable);
+    TEST_ASSERT_EQUAL_UINT32(stats.trimmedMean, stats.value);
+
+    stats = addRepeated(60000, READING_SAMPLES);
+    TEST_ASSERT_TRUE(stats.stable);
+    TEST_ASSERT_EQUAL_UINT32(60000, stats.value);
+}
+
+static void test_reset_starts_an_empty_window() {
+    addRepeated(121000, READING_SAMPLES);
+    readingFilterReset(&filter);
+
+    ReadingStats stats = readingFilterAdd(&filter, 50000);
+    TEST_ASSERT_EQUAL_UINT32(50000, stats.value);
+    TEST_ASSERT_FALSE(stats.stable);
+}
+
+static void test_matches_a_sorted_window() {
+    srand(7);
+    uint32_t window[READING_SAMPLES];
+    uint32_t count = 0;
+    uint32_t sample = 0;
+
+    for (uint32_t n = 0; n < 20000; n++) {
+        // Two levels taking turns, with noise and the odd repeated sample
+        if (n % 7 != 0) sample = (n / 500 % 2 ? 60000 : 121000) + rand() % 3000;
+        ReadingStats stats = readingFilterAdd(&filter, sample);
+
+        window[n % READING_SAMPLES] = sample;
+        if (count < READING_SAMPLES) count++;
+        uint32_t sorted[READING_SAMPLES];
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t j = i;
+            for (; j > 0 && sorted[j - 1] > window[i]; j--) sorted[j] = sorted[j - 1];
+            sorted[j] = window[i];
+        }
+
+        uint32_t median = (count & 1) ? sorted[count / 2]
+                                      : (uint32_t)(((uint64_t)sorted[count / 2 - 1] + sorted[count / 2]) / 2);
+        uint32_t trim = count > 2 * READING_TRIM ? READING_TRIM : 0;
+        uint64_t sum = 0;
+        for (uint32_t i = trim; i < count - trim; i++) sum += sorted[i];
+
+        TEST_ASSERT_EQUAL_UINT32(median, stats.median);
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)(sum / (count - 2 * trim)), stats.trimmedMean);
+    }
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_is_the_reading);
+    RUN_TEST(test_stable_only_once_the_window_is_full);
+    RUN_TEST(test_outliers_are_trimmed);
+    RUN_TEST(test_locked_value_holds_through_small_noise);
+    RUN_TEST(test_wide_spread_unlocks);
+    RUN_TEST(test_reset_starts_an_empty_window);
+    RUN_TEST(test_matches_a_sorted_window);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+// Adaptive warm-up: ends once IR and die temperature hold still over the
+// whole window, keeps going while either drifts, and times out at
+// WARMUP_TIME.
+#include <unity.h>
+
+#include <math.h>
+
+#include "warmup.h"
+
+#define SAMPLE_INTERVAL_MS 80
+
+// Sensor readings t ms into the warm-up
+typedef uint32_t (*IrCurve)(uint32_t t);
+typedef float (*TemperatureCurve)(uint32_t t);
+
+void setUp() {}
+
+void tearDown() {}
+
+// Feed a sample every SAMPLE_INTERVAL_MS and a temperature every bucket,
+// as the firmware does; returns the warm-up time
+static uint32_t runWarmup(IrCurve ir, TemperatureCurve temperature, WarmupStatus *status) {
+    WarmupTracker tracker;
+    warmupBegin(&tracker, 0);
+
+    for (uint32_t now = 0;; now += SAMPLE_INTERVAL_MS) {
+        warmupAddSample(&tracker, ir(now));
+        if (now % WARMUP_BUCKET_MS == 0) warmupAddTemperature(&tracker, temperature(now));
+
+        *status = warmupUpdate(&tracker, now);
+        if (*status != WARMUP_RUNNING) return warmupElapsed(&tracker, now);
+    }
+}
+
+static uint32_t steadyIr(uint32_t) { return 30000; }
+static float steadyTemperature(uint32_t) { return 30.0f; }
+
+// Cold start: LED output and die temperature settle exponentially
+static uint32_t coldIr(uint32_t t) { return (uint32_t)(30000 * (1.0f - 0.03f * expf(-(float)t / 10000.0f))); }
+static float coldTemperature(uint32_t t) { return 30.0f - 4.0f * expf(-(float)t / 15000.0f); }
+
+static float risingTemperature(uint32_t t) { return 25.0f + t / 10000.0f; }
+
+static uint32_t noIr(uint32_t) { return 0; }
+
+static void test_settled_device_is_done_after_one_window() {
+    WarmupStatus status;
+    uint32_t elapsed = runWarmup(steadyIr, steadyTemperature, &status);
+    TEST_ASSERT_EQUAL_INT(WARMUP_STABLE, status);
+    // Buckets close on the first sample past WARMUP_BUCKET_MS
+    TEST_ASSERT_UINT32_WITHIN(WARMUP_WINDOW_BUCKETS * SAMPLE_INTERVAL_MS, WARMUP_WINDOW_BUCKETS * WARMUP_BUCKET_MS,
+                              elapsed);
+}
+
+static void test_cold_device_waits_for_the_drift_to_settle() {
+    WarmupStatus status;
+    uint32_t elapsed = runWarmup(coldIr, coldTemperature, &status);
+    TEST_ASSERT_EQUAL_INT(WARMUP_STABLE, status);
+    TEST_ASSERT_GREATER_THAN_UINT32(3 * WARMUP_WINDOW_BUCKETS * WARMUP_BUCKET_MS, elapsed);
+    TEST_ASSERT_LESS_THAN_UINT32((uint32_t)WARMUP_TIME * 1000, elapsed);
+}
+
+static void test_rising_temperature_times_out() {
+    WarmupStatus status;
+    uint32_t elapsed = runWarmup(steadyIr, risingTemperature, &status);
+    TEST_ASSERT_EQUAL_INT(WARMUP_TIMEOUT, status);
+    TEST_ASSERT_UINT32_WITHIN(SAMPLE_INTERVAL_MS, (uint32_t)WARMUP_TIME * 1000, elapsed);
+}
+
+// Bucket means taking turns spreadPpm of 100000 apart, one full bucket each
+static WarmupStatus alternateBuckets(uint32_t spreadPpm) {
+    WarmupTracker tracker;
+    warmupBegin(&tracker, 0);
+    warmupAddTemperature(&tracker, 30.0f);
+
+    WarmupStatus status = WARMUP_RUNNING;
+    for (uint32_t bucket = 0; status == WARMUP_RUNNING; bucket++) {
+        for (uint8_t i = 0; i < 12; i++) warmupAddSample(&tracker, 100000 + bucket % 2 * spreadPpm / 10);
+        status = warmupUpdate(&tracker, (bucket + 1) * WARMUP_BUCKET_MS);
+    }
+    return status;
+}
+
+static void test_ir_drift_threshold() {
+    TEST_ASSERT_EQUAL_INT(WARMUP_STABLE, alternateBuckets(WARMUP_IR_DRIFT_PPM - 100));
+    TEST_ASSERT_EQUAL_INT(WARMUP_TIMEOUT, alternateBuckets(WARMUP_IR_DRIFT_PPM + 100));
+}
+
+static void test_buckets_without_samples_do_not_count() {
+    WarmupStatus status;
+    runWarmup(noIr, steadyTemperature, &status);
+    TEST_ASSERT_EQUAL_INT(WARMUP_TIMEOUT, status);
+
+    // Nor do samples before the first temperature reading
+    WarmupTracker tracker;
+    warmupBegin(&tracker, 0);
+    uint32_t now = 0;
+    for (; now <= WARMUP_WINDOW_BUCKETS * WARMUP_BUCKET_MS; now += SAMPLE_INTERVAL_MS) {
+        warmupAddSample(&tracker, 30000);
+        TEST_ASSERT_EQUAL_INT(WARMUP_RUNNING, warmupUpdate(&tracker, now));
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, tracker.buckets);
+}
+
+static void test_elapsed_across_millis_wrap() {
+    WarmupTracker tracker;
+    warmupBegin(&tracker, 0xFFFFF000);
+    TEST_ASSERT_EQUAL_UINT32(0x1000 + 500, warmupElapsed(&tracker, 500));
+    TEST_ASSERT_EQUAL_INT(WARMUP_RUNNING, warmupUpdate(&tracker, 500));
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_settled_device_is_done_after_one_window);
+    RUN_TEST(test_cold_device_waits_for_the_drift_to_settle);
+    RUN_TEST(test_rising_temperature_times_out);
+    RUN_TEST(test_ir_drift_threshold);
+    RUN_TEST(test_buckets_without_samples_do_not_count);
+    RUN_TEST(test_elapsed_across_millis_wrap);
+    return UNITY_END();
+}
@@ -1,25 +1,285 @@
 #!/usr/bin/env python3
 """
 Roast Meter Log Capture Tool
-Connects to device, sends LOG DUMP, saves CSV output.
+Connects to device, dumps the debug log, saves CSV output.
 
-Usage: python capture_log.py [port] [output.csv]
+By default the log is fetched with LOG DUMP BIN: the device sends raw log
+pages in CRC-checked frames, corrupted or lost pages are re-requested one
+by one, and the pages are decoded here. --text uses the old LOG DUMP CSV. --last and
+--session N fetch a single boot session as CSV (LOG DUMP LAST / LOG DUMP
+SESSION), reading only its pages on the device.
+--extended adds the auto range gain_step and the ir / ratio mode columns
+to a binary dump; the default columns are those of the text LOG DUMP.
+src/native replay reads both.
+Events such as the warm-up time are written as "#" comment lines.
+
+Usage: python capture_log.py [--text | --last | --session N | --extended] [--baud N] [port] [output.csv]
 """
 
+import argparse
+import struct
 import sys
-import serial
 import time
+import zlib
 
-def capture_log(port='/dev/ttyUSB0', output='roast_log.csv', baud=115200):
-    print(f"Connecting to {port}...")
-    ser = serial.Serial(port, baud, timeout=1)
-    time.sleep(2)  # Wait for device
+import serial
 
-    # Clear any pending data
-    ser.flushInput()
+CSV_HEADER = 'timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation'
+EXTENDED_HEADER = 'timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation,gain_step,mode'
+
+# -- Frame format (include/dump_frame.h) --
+
+FRAME_SYNC = b'\xa5\x5a'
+FRAME_HEADER = struct.Struct('<2sBBIH')
+FRAME_BEGIN = 1
+FRAME_PAGE = 2
+FRAME_END = 3
+FRAME_MISSING = 4
+FRAME_TELEMETRY = 5  # TELEMETRY BIN stream, see telemetry.py
+BEGIN_INFO = struct.Struct('<IHHIB')
+
+# -- Page log format (include/log_format.h) --
+
+PAGE_MAGIC = 0x50474F4C
+PAGE_HEADER = struct.Struct('<IIIHHI8sI')
+BLOCK_HEADER = struct.Struct('<HH')
+LOG_ENTRY = struct.Struct('<IIhBBHH')
+BLOCK_ERASED = 0xFFFF
+VERSION_FIXED = 1
+VERSION_DELTA = 2
+TAG_SAMPLE_ESCAPE = 0x7F
+TAG_SETTINGS = 0x80
+TAG_WARMUP = 0x81
+TAG_SESSION = 0x82
+FLAG_WARMUP = 0x8000
+FLAG_RANGED = 0x0008
+FLAG_RANGE_MASK = 0x0007
+FLAG_RATIO = 0x0010
+RANGE_BASELINE = 1  # AUTO_RANGE_BASELINE (include/auto_range.h)
+
+MAX_RETRIES = 3
+
+
+class FrameReader:
+    """Pulls frames out of the serial byte stream, skipping text output."""
+
+    def __init__(self, ser):
+        self.ser = ser
+        self.buffer = bytearray()
+
+    def _fill(self, deadline):
+        chunk = self.ser.read(max(1, self.ser.in_waiting))
+        if chunk:
+            self.buffer += chunk
+        elif time.time() > deadline:
+            raise TimeoutError
+
+    def read_frame(self, timeout):
+        """Return (type, sequence, payload, crc_ok) or None on timeout."""
+        deadline = time.time() + timeout
+        try:
+            while True:
+                start = self.buffer.find(FRAME_SYNC)
+                if start < 0:
+                    del self.buffer[:max(0, len(self.buffer) - 1)]
+                    self._fill(deadline)
+                    continue
+                del self.buffer[:start]
+
+                while len(self.buffer) < FRAME_HEADER.size:
+                    self._fill(deadline)
+                _, ftype, _, seq, length = FRAME_HEADER.unpack_from(self.buffer)
+                if ftype not in (FRAME_BEGIN, FRAME_PAGE, FRAME_END, FRAME_MISSING, FRAME_TELEMETRY):
+                    del self.buffer[:1]  # False sync inside other output
+                    continue
+
+                total = FRAME_HEADER.size + length + 4
+                while len(self.buffer) < total:
+                    self._fill(deadline)
+                frame = bytes(self.buffer[:total])
+                crc, = struct.unpack_from('<I', frame, total - 4)
+                crc_ok = zlib.crc32(frame[:total - 4]) == crc
+                if not crc_ok and ftype != FRAME_PAGE:
+                    del self.buffer[:1]
+                    continue
+                del self.buffer[:total]
+                return ftype, seq, frame[FRAME_HEADER.size:total - 4], crc_ok
+        except TimeoutError:
+            return None
+
+
+# -- Decoding --
+
+def zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def read_varint(data, pos):
+    result = 0
+    shift = 0
+    while shift < 35:
+        if pos >= len(data):
+            raise ValueError('truncated varint')
+        byte = data[pos]
+        pos += 1
+        result |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return result & 0xFFFFFFFF, pos
+        shift += 7
+    raise ValueError('varint too long')
+
+
+def gain_step(flags):
+    return flags & FLAG_RANGE_MASK if flags & FLAG_RANGED else RANGE_BASELINE
+
+
+def mode(flags):
+    return 'ratio' if flags & FLAG_RATIO else 'ir'
+
+
+def decode_block(version, payload, state, rows):
+    """Decode one block payload; state is [ts, raw_ir, agtron, led, isect, dev, step, mode]."""
+    if version == VERSION_FIXED:
+        for ts, raw_ir, agtron, led, isect, dev, flags in LOG_ENTRY.iter_unpack(payload):
+            if flags & FLAG_WARMUP:
+                rows.append(('warmup', ts, raw_ir, agtron))
+                continue
+            state[:] = [ts, raw_ir, agtron, led, isect, dev, gain_step(flags), mode(flags)]
+            rows.append(tuple(state))
+        return
+
+    pos = 0
+    while pos < len(payload):
+        tag = payload[pos]
+        pos += 1
+        if tag == TAG_SETTINGS:
+            led, isect = payload[pos], payload[pos + 1]
+            dev, pos = read_varint(payload, pos + 2)
+            flags, pos = read_varint(payload, pos)
+            state[:] = [0, 0, 0, led, isect, dev & 0xFFFF, gain_step(flags), mode(flags)]
+            continue
+        if tag == TAG_WARMUP:
+            ts, pos = read_varint(payload, pos)
+            duration, pos = read_varint(payload, pos)
+            rows.append(('warmup', ts, duration, payload[pos]))
+            pos += 1
+            continue
+        if tag == TAG_SESSION:
+            _, pos = read_varint(payload, pos)  # Boot boundary; LOG DUMP text carries none either
+            continue
+        if tag > TAG_SAMPLE_ESCAPE:
+            raise ValueError(f'unknown record tag 0x{tag:02x}')
+
+        delta = tag
+        if tag == TAG_SAMPLE_ESCAPE:
+            delta, pos = read_varint(payload, pos)
+        agtron = (state[2] + zigzag_decode(delta)) & 0xFFFF
+        state[2] = agtron - 0x10000 if agtron >= 0x8000 else agtron
+        value, pos = read_varint(payload, pos)
+        state[0] = (state[0] + value) & 0xFFFFFFFF
+        value, pos = read_varint(payload, pos)
+        state[1] = (state[1] + zigzag_decode(value)) & 0xFFFFFFFF
+        rows.append(tuple(state))
+
+
+def decode_page(page, expected_seq):
+    """Return the entries of one raw page, stopping at the first bad block."""
+    magic, seq, _, version, _, _, _, crc = PAGE_HEADER.unpack_from(page)
+    if magic != PAGE_MAGIC or zlib.crc32(page[:PAGE_HEADER.size - 4]) != crc:
+        print(f"  page {expected_seq}: bad header, skipped")
+        return []
+    if seq != expected_seq:
+        print(f"  page {expected_seq}: carries sequence {seq}, skipped")
+        return []
+
+    rows = []
+    state = [0, 0, 0, 0, 0, 0, RANGE_BASELINE, 'ir']
+    offset = PAGE_HEADER.size
+    while offset + BLOCK_HEADER.size <= len(page):
+        length, block_crc = BLOCK_HEADER.unpack_from(page, offset)
+        if length == BLOCK_ERASED:
+            break
+        payload = page[offset + BLOCK_HEADER.size:offset + BLOCK_HEADER.size + length]
+        if len(payload) != length or (zlib.crc32(payload) & 0xFFFF) != block_crc:
+            print(f"  page {seq}: torn block at offset {offset}")
+            break
+        try:
+            decode_block(version, payload, state, rows)
+        except (ValueError, IndexError) as err:
+            print(f"  page {seq}: {err}")
+            break
+        offset += BLOCK_HEADER.size + length
+    return rows
+
+
+def format_row(row, extended=False):
+    # Events are comment lines, as in the text LOG DUMP
+    if row[0] == 'warmup':
+        _, ts, duration, reason = row
+        return f"# warmup timestamp_ms={ts} duration_ms={duration} reason={'stable' if reason == 0 else 'timeout'}"
+    ts, raw_ir, agtron, led, isect, dev, step, entry_mode = row
+    line = f"{ts},{raw_ir},{agtron},{led},{isect},{dev / 1000.0:.3f}"
+    if extended:
+        line += f",{step},{entry_mode}"
+    return line
+
+
+# -- Capture --
+
+def capture_binary(ser, extended=False):
+    reader = FrameReader(ser)
 
-    print("Sending LOG DUMP command...")
-    ser.write(b'LOG DUMP\n')
+    print("Sending LOG DUMP BIN command...")
+    ser.write(b'LOG DUMP BIN\n')
+
+    frame = None
+    while frame is None or frame[0] != FRAME_BEGIN:
+        frame = reader.read_frame(10)
+        if frame is None:
+            print("No response (firmware without LOG DUMP BIN? try --text)")
+            return None
+    first_seq, page_count, _, stored, wrapped = BEGIN_INFO.unpack(frame[2])
+    print(f"Device reports {stored} entries in {page_count} pages (wrapped: {'YES' if wrapped else 'NO'})")
+
+    pages = {}
+    print("Receiving pages...")
+    while True:
+        frame = reader.read_frame(10)
+        if frame is None or frame[0] == FRAME_END:
+            break
+        ftype, seq, payload, crc_ok = frame
+        if ftype == FRAME_PAGE and crc_ok:
+            pages[seq] = payload
+            if len(pages) % 32 == 0:
+                print(f"  {len(pages)}/{page_count} pages...")
+
+    for seq in range(first_seq, first_seq + page_count):
+        retries = 0
+        while seq not in pages and retries < MAX_RETRIES:
+            retries += 1
+            print(f"  re-requesting page {seq} (attempt {retries})")
+            ser.write(f'LOG DUMP BIN {seq}\n'.encode())
+            frame = reader.read_frame(5)
+            if frame is None or frame[1] != seq:
+                continue
+            if frame[0] == FRAME_MISSING:
+                print(f"  page {seq} has been overwritten on the device")
+                break
+            if frame[0] == FRAME_PAGE and frame[3]:
+                pages[seq] = frame[2]
+        if seq not in pages:
+            print(f"  page {seq} lost")
+
+    rows = []
+    for seq in range(first_seq, first_seq + page_count):
+        if seq in pages:
+            rows.extend(decode_page(pages[seq], seq))
+    return [EXTENDED_HEADER if extended else CSV_HEADER] + [format_row(row, extended) for row in rows]
+
+
+def capture_text(ser, command='LOG DUMP'):
+    print(f"Sending {command} command...")
+    ser.write(command.encode() + b'\n')
 
     lines = []
     in_csv = False
@@ -38,17 +298,47 @@ def capture_log(port='/dev/ttyUSB0', output='roast_log.csv', baud=115200):
             lines.append(line)
             if len(lines) % 1000 == 0:
                 print(f"  {len(lines)} entries...")
+    return lines
+
 
+def capture_log(port='/dev/ttyUSB0', output='roast_log.csv', baud=115200, text=False, command=None,
+                extended=False):
+    print(f"Connecting to {port}...")
+    ser = serial.Serial(port, baud, timeout=0.2)
+    time.sleep(2)  # Wait for device
+
+    # Clear any pending data
+    ser.reset_input_buffer()
+
+    start = time.time()
+    if command:
+        lines = capture_text(ser, command)
+    else:
+        lines = capture_text(ser) if text else capture_binary(ser, extended)
     ser.close()
 
     if lines:
         with open(output, 'w') as f:
             f.write('\n'.join(lines) + '\n')
-        print(f"Saved {len(lines)-1} entries to {output}")
+        print(f"Saved {len(lines)-1} entries to {output} in {time.time() - start:.1f}s")
     else:
         print("No data received")
 
+
 if __name__ == '__main__':
-    port = sys.argv[1] if len(sys.argv) > 1 else '/dev/ttyUSB0'
-    output = sys.argv[2] if len(sys.argv) > 2 else 'roast_log.csv'
-    capture_log(port, output)
+    parser = argparse.ArgumentParser(description='Dump the roast meter debug log to CSV')
+    parser.add_argument('port', nargs='?', default='/dev/ttyUSB0')
+    parser.add_argument('output', nargs='?', default='roast_log.csv')
+    parser.add_argument('--baud', type=int, default=115200)
+    selection = parser.add_mutually_exclusive_group()
+    selection.add_argument('--text', action='store_true', help='use the slow text LOG DUMP')
+    selection.add_argument('--last', action='store_true', help='only the last boot session')
+    selection.add_argument('--session', type=int, help='only boot session N (see LOG SESSIONS)')
+    selection.add_argument('--extended', action='store_true', help='add the gain_step and mode columns (binary dump)')
+    args = parser.parse_args()
+    command = None
+    if args.last:
+        command = 'LOG DUMP LAST'
+    elif args.session is not None:
+        command = f'LOG DUMP SESSION {args.session}'
+    capture_log(args.port, args.output, args.baud, args.text, command, args.extended)
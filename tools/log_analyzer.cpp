@@ -0,0 +1,370 @@
+// Roast Meter Log Analyzer
+//
+// Offline statistics over raw debug log images, as read off the flash of
+// many units: the logdata partition (page ring, see include/log_format.h)
+// or a legacy LittleFS /log.bin (LogHeader + LogEntry ring). Images are
+// memory-mapped and decoded with the firmware's own log_codec, files are
+// spread over one thread per core, and every boot session gets one CSV
+// row: IR level and drift, Agtron distribution and settings changes.
+//
+// Build (from the repository root):
+//   g++ -std=gnu++11 -O2 -pthread -Iinclude tools/log_analyzer.cpp src/log_codec.cpp src/crc32.cpp -o log_analyzer
+//
+// Usage: log_analyzer [-j threads] image...
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crc32.h"
+#include "log_codec.h"
+#include "log_format.h"
+
+// -- Analyzer constants --
+
+#define AGTRON_BINS 351           // 0..350, the valid Agtron range
+#define NO_BOOT_SESSION LOG_SESSION_UNKNOWN
+
+// -- End Analyzer constants --
+
+struct SessionStats {
+    uint32_t ordinal;             // 1.. within the image
+    uint32_t bootSession;         // From the page headers and session records, NO_BOOT_SESSION if unknown
+    uint32_t entries;
+    uint32_t measurements;
+    uint32_t warmups;
+    uint64_t warmupMs;
+    uint32_t firstTimestamp;
+    uint32_t lastTimestamp;
+
+    // IR level and its least-squares drift over time
+    uint32_t irMin;
+    uint32_t irMax;
+    double irSum;
+    double timeSum;               // Seconds since firstTimestamp
+    double timeSquareSum;
+    double timeIrSum;
+
+    // Agtron distribution
+    uint32_t agtronBins[AGTRON_BINS];
+    uint32_t agtronOutOfRange;
+    double agtronSum;
+
+    // Settings (ledBrightness, intersectPt, deviationX1000) of the latest
+    // measurement; warm-up events carry no settings of their own
+    LogEntry settings;
+    uint32_t settingsChanges;
+};
+
+struct ImageResult {
+    std::string path;
+    const char *format;           // "pages", "legacy" or an error
+    uint64_t bytes;
+    std::vector<SessionStats> sessions;
+};
+
+// -- Session accumulation --
+
+struct Accumulator {
+    std::vector<SessionStats> *sessions;
+    SessionStats *current;
+    const LogDecoder *decoder;    // Of the page being decoded, NULL for legacy images
+};
+
+static void startSession(Accumulator *acc, const LogEntry &entry, uint32_t bootSession) {
+    SessionStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.ordinal = (uint32_t)acc->sessions->size() + 1;
+    stats.bootSession = bootSession;
+    stats.firstTimestamp = entry.timestamp;
+    stats.lastTimestamp = entry.timestamp;
+    stats.irMin = 0xFFFFFFFF;
+    acc->sessions->push_back(stats);
+    acc->current = &acc->sessions->back();
+}
+
+static bool sameSettings(const LogEntry &a, const LogEntry &b) {
+    return a.ledBrightness == b.ledBrightness && a.intersectPt == b.intersectPt &&
+           a.deviationX1000 == b.deviationX1000;
+}
+
+static void addEntry(const LogEntry &entry, void *context) {
+    Accumulator *acc = (Accumulator*)context;
+    SessionStats *stats = acc->current;
+    uint32_t bootSession = acc->decoder ? acc->decoder->session : NO_BOOT_SESSION;
+
+    // A new boot: another logged session, or millis() starting over
+    if (stats == NULL || stats->bootSession != bootSession ||
+        entry.timestamp < stats->lastTimestamp) {
+        startSession(acc, entry, bootSession);
+        stats = acc->current;
+    }
+
+    stats->entries++;
+    stats->lastTimestamp = entry.timestamp;
+
+    if (entry.flags & LOG_FLAG_WARMUP) {
+        stats->warmups++;
+        stats->warmupMs += entry.rawIR;
+        return;
+    }
+
+    if (stats->measurements++ == 0) {
+        stats->settings = entry;
+    } else if (!sameSettings(entry, stats->settings)) {
+        stats->settingsChanges++;
+        stats->settings = entry;
+    }
+
+    double t = (entry.timestamp - stats->firstTimestamp) / 1000.0;
+    stats->irMin = std::min(stats->irMin, entry.rawIR);
+    stats->irMax = std::max(stats->irMax, entry.rawIR);
+    stats->irSum += entry.rawIR;
+    stats->timeSum += t;
+    stats->timeSquareSum += t * t;
+    stats->timeIrSum += t * entry.rawIR;
+
+    if (entry.agtron >= 0 && entry.agtron < AGTRON_BINS) {
+        stats->agtronBins[entry.agtron]++;
+    } else {
+        stats->agtronOutOfRange++;
+    }
+    stats->agtronSum += entry.agtron;
+}
+
+// -- End Session accumulation --
+
+// -- Image decoding --
+
+struct PageRef {
+    uint32_t sequence;
+    uint32_t offset;
+    LogPageHeader header;
+};
+
+static bool analyzePages(const uint8_t *image, size_t size, ImageResult *result) {
+    if (size < 2 * LOG_PAGE_SIZE || size % LOG_PAGE_SIZE != 0) return false;
+
+    // Same live arc as setupDebugLog(): from the latest reset page on
+    std::vector<PageRef> pages;
+    bool haveReset = false;
+    uint32_t resetSequence = 0;
+    for (size_t offset = 0; offset < size; offset += LOG_PAGE_SIZE) {
+        PageRef ref;
+        memcpy(&ref.header, image + offset, sizeof(ref.header));
+        if (ref.header.magic != LOG_PAGE_MAGIC ||
+            (ref.header.version != LOG_VERSION_FIXED && ref.header.version != LOG_VERSION_DELTA) ||
+            ref.header.crc != crc32(&ref.header, offsetof(LogPageHeader, crc))) {
+            continue;
+        }
+        ref.sequence = ref.header.sequence;
+        ref.offset = (uint32_t)offset;
+        pages.push_back(ref);
+
+        if ((ref.header.flags & LOG_PAGE_FLAG_RESET) && (!haveReset || ref.sequence > resetSequence)) {
+            resetSequence = ref.sequence;
+            haveReset = true;
+        }
+    }
+    if (pages.empty()) return false;
+
+    std::sort(pages.begin(), pages.end(),
+              [](const PageRef &a, const PageRef &b) { return a.sequence < b.sequence; });
+
+    Accumulator acc;
+    acc.sessions = &result->sessions;
+    acc.current = NULL;
+    acc.decoder = NULL;
+
+    for (size_t i = 0; i < pages.size(); i++) {
+        const PageRef &ref = pages[i];
+        if (haveReset && ref.sequence < resetSequence) continue;
+
+        // A page never continues a delta chain; same-session pages do continue the session
+        LogDecoder decoder;
+        logDecoderReset(&decoder, ref.header.session);
+        acc.decoder = &decoder;
+
+        const uint8_t *page = image + ref.offset;
+        uint32_t offset = sizeof(LogPageHeader);
+        while (offset + sizeof(LogBlockHeader) <= LOG_PAGE_SIZE) {
+            LogBlockHeader block;
+            memcpy(&block, page + offset, sizeof(block));
+            if (block.length == LOG_BLOCK_ERASED) break;
+
+            const uint8_t *payload = page + offset + sizeof(block);
+            if (block.length == 0 || block.length > LOG_PAGE_SIZE - offset - sizeof(block) ||
+                (uint16_t)crc32(payload, block.length) != block.crc ||
+                !logDecodeBlock(&decoder, ref.header.version, payload, block.length, addEntry, &acc)) {
+                break;  // Torn block: the rest of the page is unusable
+            }
+            offset += sizeof(block) + block.length;
+        }
+    }
+
+    result->format = "pages";
+    return true;
+}
+
+static bool analyzeLegacy(const uint8_t *image, size_t size, ImageResult *result) {
+    LogHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, image, sizeof(header));
+    if (header.magic != LOG_MAGIC || header.writePosition >= LOG_MAX_ENTRIES) return false;
+
+    // Undo the ring wrap: oldest entry sits at writePosition once wrapped
+    uint32_t slots = (uint32_t)std::min<size_t>(LOG_MAX_ENTRIES, (size - sizeof(header)) / sizeof(LogEntry));
+    uint32_t count = header.wrapped ? slots : std::min(header.writePosition, slots);
+    uint32_t start = header.wrapped ? header.writePosition : 0;
+
+    Accumulator acc;
+    acc.sessions = &result->sessions;
+    acc.current = NULL;
+    acc.decoder = NULL;
+
+    const uint8_t *entries = image + sizeof(header);
+    for (uint32_t i = 0; i < count; i++) {
+        LogEntry entry;
+        memcpy(&entry, entries + (size_t)((start + i) % slots) * sizeof(LogEntry), sizeof(entry));
+        addEntry(entry, &acc);
+    }
+
+    result->format = "legacy";
+    return true;
+}
+
+static void analyzeImage(ImageResult *result) {
+    result->format = "unreadable";
+    int fd = open(result->path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return;
+    }
+    size_t size = (size_t)info.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+
+    madvise(map, size, MADV_SEQUENTIAL);
+    result->bytes = size;
+    const uint8_t *image = (const uint8_t*)map;
+    if (!analyzeLegacy(image, size, result) && !analyzePages(image, size, result)) {
+        result->format = "unknown format";
+    }
+    munmap(map, size);
+}
+
+// -- End Image decoding --
+
+// -- Report --
+
+static int agtronPercentile(const SessionStats &stats, uint32_t percent) {
+    uint32_t inRange = stats.measurements - stats.agtronOutOfRange;
+    if (inRange == 0) return -1;
+
+    uint64_t target = ((uint64_t)inRange * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int agtron = 0; agtron < AGTRON_BINS; agtron++) {
+        seen += stats.agtronBins[agtron];
+        if (seen >= target && seen > 0) return agtron;
+    }
+    return AGTRON_BINS - 1;
+}
+
+static void printSession(const ImageResult &image, const SessionStats &stats) {
+    double n = stats.measurements;
+    double irMean = n > 0 ? stats.irSum / n : 0;
+    double variance = n > 1 ? stats.timeSquareSum - stats.timeSum * stats.timeSum / n : 0;
+    double drift = variance > 0 ? (stats.timeIrSum - stats.timeSum * stats.irSum / n) / variance * 60.0 : 0;
+
+    printf("%s,%u,", image.path.c_str(), stats.ordinal);
+    if (stats.bootSession == NO_BOOT_SESSION) {
+        printf(",");
+    } else {
+        printf("%u,", stats.bootSession);
+    }
+    printf("%u,%u,%u,%.1f,%.1f,%u,%u,%.1f,%.1f,%.2f,%d,%d,%d,%u,%u,%u,%u,%u.%03u\n",
+           stats.entries, stats.measurements, stats.warmups,
+           stats.warmups ? (double)stats.warmupMs / stats.warmups / 1000.0 : 0.0,
+           (stats.lastTimestamp - stats.firstTimestamp) / 1000.0,
+           n > 0 ? stats.irMin : 0, stats.irMax, irMean, drift,
+           n > 0 ? stats.agtronSum / n : 0.0,
+           agtronPercentile(stats, 10), agtronPercentile(stats, 50), agtronPercentile(stats, 90),
+           stats.agtronOutOfRange, stats.settingsChanges,
+           stats.settings.ledBrightness, stats.settings.intersectPt,
+           stats.settings.deviationX1000 / 1000, stats.settings.deviationX1000 % 1000);
+}
+
+// -- End Report --
+
+int main(int argc, char **argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<ImageResult> images;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+            continue;
+        }
+        ImageResult image;
+        image.path = argv[i];
+        image.bytes = 0;
+        images.push_back(image);
+    }
+    if (images.empty()) {
+        fprintf(stderr, "usage: %s [-j threads] image...\n", argv[0]);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::min<size_t>(threads, images.size()); t++) {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < images.size(); i = next++) {
+                analyzeImage(&images[i]);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("file,session,boot,entries,measurements,warmups,warmup_s,duration_s,"
+           "ir_min,ir_max,ir_mean,ir_drift_per_min,agtron_mean,agtron_p10,agtron_p50,agtron_p90,"
+           "agtron_out_of_range,settings_changes,led_brightness,intersection_point,deviation\n");
+
+    uint64_t bytes = 0;
+    uint64_t entries = 0;
+    size_t failed = 0;
+    for (size_t i = 0; i < images.size(); i++) {
+        const ImageResult &image = images[i];
+        bytes += image.bytes;
+        if (strcmp(image.format, "pages") != 0 && strcmp(image.format, "legacy") != 0) {
+            fprintf(stderr, "%s: %s\n", image.path.c_str(), image.format);
+            failed++;
+            continue;
+        }
+        for (size_t s = 0; s < image.sessions.size(); s++) {
+            printSession(image, image.sessions[s]);
+            entries += image.sessions[s].entries;
+        }
+    }
+
+    fprintf(stderr, "%zu images (%zu unreadable), %.1f MB, %llu entries in %.2f s on %zu threads\n",
+            images.size(), failed, bytes / 1048576.0, (unsigned long long)entries, seconds, workers.size());
+    return failed == images.size() ? 1 : 0;
+}
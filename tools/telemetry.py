@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Roast Meter Live Telemetry
+Switches the device to TELEMETRY BIN and decodes the sample stream: every
+FIFO sample with its level (IR scaled to the calibration configuration, or
+the Red / IR ratio level in ratio mode), the Agtron value of that sample
+alone, the batch flags and its gain step. Samples go to stdout or a CSV file, and with --plot to a live
+matplotlib chart. Ctrl+C switches the device back to text telemetry.
+
+Usage: python telemetry.py [--baud N] [--output samples.csv] [--plot] [port]
+"""
+
+import argparse
+import struct
+import sys
+import time
+from collections import deque
+
+import serial
+
+from capture_log import FRAME_TELEMETRY, FrameReader
+
+SAMPLE = struct.Struct('<IIhB')  # TelemetrySample (include/telemetry.h)
+FLAG_VALID = 0x01
+FLAG_PRESENT = 0x02
+FLAG_LOCKED = 0x04
+FLAG_RATIO = 0x08
+RANGE_SHIFT = 4
+
+CSV_HEADER = 'timestamp_ms,level,agtron,valid,present,locked,gain_step,mode'
+PLOT_SAMPLES = 600
+
+
+def decode_samples(payload):
+    """Return (timestamp, ir, agtron, flags) tuples of one telemetry frame."""
+    usable = len(payload) - len(payload) % SAMPLE.size
+    return list(SAMPLE.iter_unpack(payload[:usable]))
+
+
+def format_sample(sample):
+    ts, ir, agtron, flags = sample
+    return (f"{ts},{ir},{agtron},{int(bool(flags & FLAG_VALID))},"
+            f"{int(bool(flags & FLAG_PRESENT))},{int(bool(flags & FLAG_LOCKED))},"
+            f"{(flags >> RANGE_SHIFT) & 0x07},{'ratio' if flags & FLAG_RATIO else 'ir'}")
+
+
+class LivePlot:
+    """Level and per-sample Agtron of the last PLOT_SAMPLES samples."""
+
+    def __init__(self):
+        import matplotlib.pyplot as plt
+        self.plt = plt
+        self.times = deque(maxlen=PLOT_SAMPLES)
+        self.irs = deque(maxlen=PLOT_SAMPLES)
+        self.agtrons = deque(maxlen=PLOT_SAMPLES)
+        plt.ion()
+        self.figure, (self.ir_axis, self.agtron_axis) = plt.subplots(2, 1, sharex=True)
+        self.ir_line, = self.ir_axis.plot([], [])
+        self.agtron_line, = self.agtron_axis.plot([], [])
+        self.ir_axis.set_ylabel('level')
+        self.agtron_axis.set_ylabel('agtron')
+        self.agtron_axis.set_xlabel('time (s)')
+
+    def add(self, sample):
+        ts, ir, agtron, flags = sample
+        self.times.append(ts / 1000.0)
+        self.irs.append(ir)
+        self.agtrons.append(agtron if flags & FLAG_PRESENT else float('nan'))
+
+    def refresh(self):
+        self.ir_line.set_data(self.times, self.irs)
+        self.agtron_line.set_data(self.times, self.agtrons)
+        for axis in (self.ir_axis, self.agtron_axis):
+            axis.relim()
+            axis.autoscale_view()
+        self.plt.pause(0.001)
+
+
+def stream(port, baud, output, plot):
+    print(f"Connecting to {port}...", file=sys.stderr)
+    ser = serial.Serial(port, baud, timeout=0.2)
+    time.sleep(2)  # Wait for device
+    ser.reset_input_buffer()
+    ser.write(b'TELEMETRY BIN\n')
+
+    reader = FrameReader(ser)
+    out = open(output, 'w') if output else sys.stdout
+    chart = LivePlot() if plot else None
+    expected = None
+    samples = lost = 0
+
+    print(CSV_HEADER, file=out)
+    try:
+        while True:
+            frame = reader.read_frame(1)
+            if frame is None:
+                if chart:
+                    chart.refresh()
+                continue
+            ftype, seq, payload, crc_ok = frame
+            if ftype != FRAME_TELEMETRY or not crc_ok:
+                continue
+            if expected is not None and seq != expected:
+                lost += (seq - expected) & 0xFFFFFFFF
+            expected = (seq + 1) & 0xFFFFFFFF
+
+            for sample in decode_samples(payload):
+                print(format_sample(sample), file=out)
+                if chart:
+                    chart.add(sample)
+                samples += 1
+            if chart:
+                chart.refresh()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        ser.write(b'TELEMETRY TEXT\n')
+        ser.close()
+        if out is not sys.stdout:
+            out.close()
+        print(f"{samples} samples, {lost} frames lost", file=sys.stderr)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Stream roast meter samples live')
+    parser.add_argument('port', nargs='?', default='/dev/ttyUSB0')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--output', help='CSV file (default: stdout)')
+    parser.add_argument('--plot', action='store_true', help='live chart (needs matplotlib)')
+    args = parser.parse_args()
+    stream(args.port, args.baud, args.output, args.plot)
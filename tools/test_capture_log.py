@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""
+Host test for capture_log.py: runs the script as from the command line
+against a fake serial port that answers LOG DUMP BIN with one page, and
+checks the CSV it writes.
+
+Usage: python tools/test_capture_log.py
+"""
+
+import os
+import runpy
+import struct
+import sys
+import tempfile
+import types
+import unittest
+import zlib
+from unittest import mock
+
+SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'capture_log.py')
+
+# Layouts from include/dump_frame.h and include/log_format.h, kept apart
+# from the script so the test does not decode with the code under test
+FRAME_BEGIN, FRAME_PAGE, FRAME_END = 1, 2, 3
+PAGE_MAGIC = 0x50474F4C
+VERSION_DELTA = 2
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append(value & 0x7F | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def zigzag(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+def frame(ftype, seq, payload):
+    data = struct.pack('<2sBBIH', b'\xa5\x5a', ftype, 0, seq, len(payload)) + payload
+    return data + struct.pack('<I', zlib.crc32(data))
+
+
+def block(payload):
+    return struct.pack('<HH', len(payload), zlib.crc32(payload) & 0xFFFF) + payload
+
+
+def log_page(seq, blocks):
+    header = struct.pack('<IIIHHI8s', PAGE_MAGIC, seq, 0, VERSION_DELTA, 0, 1, b'\xff' * 8)
+    return header + struct.pack('<I', zlib.crc32(header)) + b''.join(block(b) for b in blocks)
+
+
+def dump_stream():
+    """What the device sends for LOG DUMP BIN: one page, two blocks."""
+    first = (bytes([0x82]) + varint(2) +                                       # Session 2
+             bytes([0x81]) + varint(900) + varint(12000) + bytes([0]) +       # Warm-up, stable
+             bytes([0x80, 95, 117]) + varint(165) + varint(0x0008 | 3 | 0x0010) +  # Step 3, ratio
+             bytes([0x7F]) + varint(zigzag(120)) + varint(1000) + varint(zigzag(121000)))
+    second = bytes([zigzag(-2)]) + varint(100) + varint(zigzag(-50))
+    page = log_page(7, [first, second])
+    return (b'LOG DUMP BIN\r\n' +
+            frame(FRAME_BEGIN, 0, struct.pack('<IHHIB', 7, 1, 4096, 2, 0)) +
+            frame(FRAME_PAGE, 7, page) +
+            frame(FRAME_END, 0, b''))
+
+
+class FakeSerial:
+    def __init__(self, port, baud, timeout=None):
+        self.data = bytearray(dump_stream())
+        self.written = b''
+
+    @property
+    def in_waiting(self):
+        return len(self.data)
+
+    def read(self, size=1):
+        chunk = bytes(self.data[:size])
+        del self.data[:size]
+        return chunk
+
+    def write(self, data):
+        self.written += data
+
+    def reset_input_buffer(self):
+        pass
+
+    def close(self):
+        pass
+
+
+class CaptureLogTest(unittest.TestCase):
+    def capture(self, *options):
+        """Run the script's entry point; returns the lines of its CSV."""
+        fake = types.ModuleType('serial')
+        fake.Serial = FakeSerial
+        with tempfile.TemporaryDirectory() as tmp:
+            output = os.path.join(tmp, 'log.csv')
+            argv = ['capture_log.py', *options, '/dev/fake', output]
+            with mock.patch.dict(sys.modules, {'serial': fake}), \
+                    mock.patch.object(sys, 'argv', argv), \
+                    mock.patch('time.sleep'), \
+                    mock.patch('builtins.print'):
+                runpy.run_path(SCRIPT, run_name='__main__')
+            with open(output) as f:
+                return f.read().splitlines()
+
+    def test_binary_dump_has_the_log_dump_columns(self):
+        self.assertEqual(self.capture(), [
+            'timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation',
+            '# warmup timestamp_ms=900 duration_ms=12000 reason=stable',
+            '1000,121000,120,95,117,0.165',
+            '1100,120950,118,95,117,0.165',
+        ])
+
+    def test_extended_adds_gain_step_and_mode(self):
+        self.assertEqual(self.capture('--extended'), [
+            'timestamp_ms,raw_ir,agtron,led_brightness,intersection_point,deviation,gain_step,mode',
+            '# warmup timestamp_ms=900 duration_ms=12000 reason=stable',
+            '1000,121000,120,95,117,0.165,3,ratio',
+            '1100,120950,118,95,117,0.165,3,ratio',
+        ])
+
+
+if __name__ == '__main__':
+    unittest.main()